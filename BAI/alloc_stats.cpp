@@ -0,0 +1,154 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "BAI/alloc_stats.h"
+#include "common.h"
+
+namespace MMAI::BAI::AllocStats {
+    namespace {
+        constexpr int NSTAGES = EI(Stage::_count);
+
+        constexpr std::array<const char*, NSTAGES> STAGE_NAMES = {
+            "battlefield",
+            "state",
+            "supdata",
+            "inputs",
+            "sampling"
+        };
+
+        struct Totals {
+            std::atomic<uint64_t> calls {0};
+            std::atomic<uint64_t> allocs {0};
+            std::atomic<uint64_t> frees {0};
+            std::atomic<uint64_t> bytes {0};
+        };
+
+        // Constant-initialized: operator new may be called during
+        // static initialization of other translation units.
+        std::array<Totals, NSTAGES> totals;
+
+#ifdef ENABLE_MMAI_ALLOC_STATS
+        thread_local int current = -1;  // innermost Stage on this thread
+#endif
+    }
+
+    Counters Get(Stage stage) {
+        auto &t = totals.at(EI(stage));
+        return {t.calls.load(), t.allocs.load(), t.frees.load(), t.bytes.load()};
+    }
+
+    void Reset() {
+        for (auto &t : totals) {
+            t.calls = 0;
+            t.allocs = 0;
+            t.frees = 0;
+            t.bytes = 0;
+        }
+    }
+
+    std::string Report() {
+        if (!ENABLED)
+            return "MMAI alloc stats: disabled (build with ENABLE_MMAI_ALLOC_STATS)";
+
+        auto res = std::string("MMAI alloc stats (per call):");
+        for (int i = 0; i < NSTAGES; ++i) {
+            auto c = Get(static_cast<Stage>(i));
+            auto n = std::max<uint64_t>(c.calls, 1);
+            res += boost::str(boost::format("\n  %-12s calls=%-6d allocs=%-8.1f frees=%-8.1f bytes=%.0f")
+                % STAGE_NAMES.at(i) % c.calls % (double(c.allocs) / n) % (double(c.frees) / n) % (double(c.bytes) / n));
+        }
+        return res;
+    }
+
+#ifdef ENABLE_MMAI_ALLOC_STATS
+    Scope::Scope(Stage stage_) : stage(EI(stage_)), prev(current) {
+        current = stage;
+    }
+
+    Scope::~Scope() {
+        totals[stage].calls.fetch_add(1, std::memory_order_relaxed);
+        current = prev;
+    }
+#endif
+}
+
+#ifdef ENABLE_MMAI_ALLOC_STATS
+
+namespace {
+    using MMAI::BAI::AllocStats::current;
+    using MMAI::BAI::AllocStats::totals;
+
+    void* CountedAlloc(std::size_t n, std::size_t align = 0) {
+        if (current >= 0) {
+            totals[current].allocs.fetch_add(1, std::memory_order_relaxed);
+            totals[current].bytes.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        if (n == 0)
+            n = 1;
+
+        if (align == 0)
+            return std::malloc(n);
+
+        // aligned_alloc requires the size to be a multiple of the alignment
+        return std::aligned_alloc(align, (n + align - 1) & ~(align - 1));
+    }
+
+    void CountedFree(void* p) noexcept {
+        if (p && current >= 0)
+            totals[current].frees.fetch_add(1, std::memory_order_relaxed);
+
+        std::free(p);
+    }
+
+    void* CountedAllocOrThrow(std::size_t n, std::size_t align = 0) {
+        auto *p = CountedAlloc(n, align);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+}
+
+void* operator new(std::size_t n) { return CountedAllocOrThrow(n); }
+void* operator new[](std::size_t n) { return CountedAllocOrThrow(n); }
+void* operator new(std::size_t n, std::align_val_t al) { return CountedAllocOrThrow(n, static_cast<std::size_t>(al)); }
+void* operator new[](std::size_t n, std::align_val_t al) { return CountedAllocOrThrow(n, static_cast<std::size_t>(al)); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept { return CountedAlloc(n); }
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept { return CountedAlloc(n); }
+void* operator new(std::size_t n, std::align_val_t al, const std::nothrow_t&) noexcept { return CountedAlloc(n, static_cast<std::size_t>(al)); }
+void* operator new[](std::size_t n, std::align_val_t al, const std::nothrow_t&) noexcept { return CountedAlloc(n, static_cast<std::size_t>(al)); }
+
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { CountedFree(p); }
+
+#endif // ENABLE_MMAI_ALLOC_STATS
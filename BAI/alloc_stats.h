@@ -0,0 +1,84 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Heap allocation counters per decision stage (instrumented builds only).
+ *
+ * With ENABLE_MMAI_ALLOC_STATS, the global operator new/delete are
+ * replaced by counting versions (see alloc_stats.cpp). An allocation is
+ * attributed to the innermost Scope active on the allocating thread.
+ * Allocations outside of any scope are not counted -- this includes
+ * work done on WorkerPool threads.
+ *
+ * Without ENABLE_MMAI_ALLOC_STATS, Scope is a no-op and all counters
+ * remain zero.
+ */
+namespace MMAI::BAI::AllocStats {
+#ifdef ENABLE_MMAI_ALLOC_STATS
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    enum class Stage : int {
+        BATTLEFIELD,    // Battlefield::Create
+        STATE,          // State::onActiveStack (excl. nested stages)
+        SUPDATA,        // SupplementaryData construction
+        INPUTS,         // TorchModel::prepareInputsV13
+        SAMPLING,       // action sampling from the model outputs
+        _count
+    };
+
+    struct Counters {
+        uint64_t calls = 0;     // completed scopes
+        uint64_t allocs = 0;
+        uint64_t frees = 0;
+        uint64_t bytes = 0;     // allocated bytes (frees are not sized)
+    };
+
+    // Process-wide totals since start (or since the last Reset)
+    Counters Get(Stage stage);
+    void Reset();
+
+    // Human-readable per-stage summary (one line per stage)
+    std::string Report();
+
+#ifdef ENABLE_MMAI_ALLOC_STATS
+    class Scope {
+    public:
+        explicit Scope(Stage stage_);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const int stage;
+        const int prev;
+    };
+#else
+    class Scope {
+    public:
+        explicit Scope(Stage) {}
+    };
+#endif
+}
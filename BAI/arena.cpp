@@ -0,0 +1,91 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "StdInc.h"
+
+#include "BAI/arena.h"
+
+namespace MMAI::BAI {
+    Arena::Arena(size_t blockSize_) : blockSize(blockSize_) {}
+
+    void * Arena::allocate(size_t bytes, size_t align) {
+        while (true) {
+            if (current < blocks.size()) {
+                auto &block = blocks[current];
+                auto base = reinterpret_cast<uintptr_t>(block.data.get());
+                auto start = (base + offset + align - 1) & ~(uintptr_t(align) - 1);
+
+                if (start + bytes <= base + block.size) {
+                    offset = start + bytes - base;
+                    ++live;
+                    return reinterpret_cast<void*>(start);
+                }
+
+                if (current + 1 < blocks.size()) {
+                    ++current;
+                    offset = 0;
+                    continue;
+                }
+            }
+
+            auto size = std::max(blockSize, bytes + align);
+            blocks.push_back({std::make_unique<std::byte[]>(size), size});
+            current = blocks.size() - 1;
+            offset = 0;
+        }
+    }
+
+    bool Arena::reset() {
+        if (liveAllocations() > 0)
+            return false;
+
+        // Coalesce into a single block, so the next turn
+        // (which is typically of the same size) needs just one.
+        if (blocks.size() > 1) {
+            auto total = bytesReserved();
+            blocks.clear();
+            blocks.push_back({std::make_unique<std::byte[]>(total), total});
+        }
+
+        current = 0;
+        offset = 0;
+        return true;
+    }
+
+    size_t Arena::bytesUsed() const {
+        size_t res = offset;
+        for (size_t i = 0; i < current && i < blocks.size(); ++i)
+            res += blocks[i].size;
+        return res;
+    }
+
+    size_t Arena::bytesReserved() const {
+        size_t res = 0;
+        for (auto &block : blocks)
+            res += block.size;
+        return res;
+    }
+
+    Arena & ArenaPool::next() {
+        for (auto &arena : arenas)
+            if (arena->reset())
+                return *arena;
+
+        arenas.push_back(std::make_unique<Arena>());
+        logAi->debug("ArenaPool: created arena #%d", EI(arenas.size()));
+        return *arenas.back();
+    }
+}
@@ -0,0 +1,150 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace MMAI::BAI {
+    class Arena;
+
+    template<typename T>
+    struct ArenaDeleter {
+        Arena * arena = nullptr;
+
+        void operator()(T * p) const noexcept;
+    };
+
+    template<typename T>
+    using ArenaUniquePtr = std::unique_ptr<T, ArenaDeleter<T>>;
+
+    /*
+     * A monotonic (bump-pointer) arena.
+     *
+     * Used for the per-turn Battlefield object graph (hexes, stacks, links):
+     * individual deallocations are no-ops and the memory is reclaimed all
+     * at once via reset().
+     *
+     * The arena counts its live allocations and refuses to reset while any
+     * are left, so an object outliving its turn (e.g. a Stack referenced by
+     * an AttackLog) never dangles -- see ArenaPool.
+     */
+    class Arena {
+    public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+        explicit Arena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void * allocate(size_t bytes, size_t align);
+        void deallocate(void * p, size_t bytes) noexcept { --live; }
+
+        // Returns false (and does nothing) if there are live allocations.
+        bool reset();
+
+        int liveAllocations() const { return live.load(std::memory_order_relaxed); }
+        size_t bytesUsed() const;
+        size_t bytesReserved() const;
+
+        template<typename T, typename... Args>
+        std::shared_ptr<T> make_shared(Args&&... args);
+
+        template<typename T, typename... Args>
+        ArenaUniquePtr<T> make_unique(Args&&... args);
+
+    private:
+        struct Block {
+            std::unique_ptr<std::byte[]> data;
+            size_t size;
+        };
+
+        const size_t blockSize;
+        std::vector<Block> blocks;
+        size_t current = 0;  // index in blocks
+        size_t offset = 0;   // offset in blocks[current]
+        std::atomic<int> live {0};
+    };
+
+    // std-compatible allocator (for allocate_shared and containers)
+    template<typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(Arena * arena_) noexcept : arena(arena_) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena(other.arena) {}
+
+        T * allocate(size_t n) {
+            return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T * p, size_t n) noexcept {
+            arena->deallocate(p, n * sizeof(T));
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U> &other) const noexcept { return arena == other.arena; }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U> &other) const noexcept { return arena != other.arena; }
+
+        Arena * arena;
+    };
+
+    template<typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    template<typename T>
+    void ArenaDeleter<T>::operator()(T * p) const noexcept {
+        p->~T();
+        arena->deallocate(p, sizeof(T));
+    }
+
+    template<typename T, typename... Args>
+    std::shared_ptr<T> Arena::make_shared(Args&&... args) {
+        return std::allocate_shared<T>(ArenaAllocator<T>(this), std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename... Args>
+    ArenaUniquePtr<T> Arena::make_unique(Args&&... args) {
+        auto * p = allocate(sizeof(T), alignof(T));
+        try {
+            return ArenaUniquePtr<T>(new (p) T(std::forward<Args>(args)...), ArenaDeleter<T>{this});
+        } catch (...) {
+            deallocate(p, sizeof(T));
+            throw;
+        }
+    }
+
+    /*
+     * A set of arenas, one per object graph that may be alive at a time.
+     *
+     * next() returns a reset arena without live allocations, creating a
+     * new one only if all existing arenas are still in use.
+     */
+    class ArenaPool {
+    public:
+        Arena & next();
+        size_t size() const { return arenas.size(); }
+    private:
+        std::vector<std::unique_ptr<Arena>> arenas;
+    };
+}
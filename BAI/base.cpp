@@ -31,7 +31,8 @@ namespace MMAI::BAI {
         Schema::IModel* model,
         const std::shared_ptr<Environment> env,
         const std::shared_ptr<CBattleCallback> cb,
-        const bool enableSpellsUsage
+        const bool enableSpellsUsage,
+        const int spellCutoffMs
     ) {
         std::shared_ptr<Base> res;
         auto version = model->getVersion();
@@ -45,7 +46,7 @@ namespace MMAI::BAI {
             throw std::runtime_error("Unsupported schema version: " + std::to_string(version));
         }
 
-        res->init(enableSpellsUsage);
+        res->init(enableSpellsUsage, spellCutoffMs);
         return res;
     }
 
@@ -88,8 +89,9 @@ namespace MMAI::BAI {
      * Their implementation here is a no-op.
      */
 
-    void Base::init(bool enableSpellsUsage_) {
+    void Base::init(bool enableSpellsUsage_, int spellCutoffMs_) {
         enableSpellsUsage = enableSpellsUsage_;
+        spellCutoffMs = spellCutoffMs_;
         debug("*** init ***");
     }
 
@@ -32,7 +32,8 @@ namespace MMAI::BAI {
             Schema::IModel* model,
             const std::shared_ptr<Environment> env,
             const std::shared_ptr<CBattleCallback> cb,
-            const bool enableSpellsUsage
+            const bool enableSpellsUsage,
+            const int spellCutoffMs = 0
         );
 
         Base() = delete;
@@ -58,7 +59,7 @@ namespace MMAI::BAI {
          * Their base implementation is for logging purposes only.
          */
 
-        virtual void init(bool enableSpellsUsage);  // called shortly after object construction
+        virtual void init(bool enableSpellsUsage, int spellCutoffMs);  // called shortly after object construction
         virtual void actionFinished(const BattleID &bid, const BattleAction &action) override;
         virtual void actionStarted(const BattleID &bid, const BattleAction &action) override;
         virtual void battleAttack(const BattleID &bid, const BattleAttack *ba) override;
@@ -100,6 +101,11 @@ namespace MMAI::BAI {
 
         bool enableSpellsUsage = false;
 
+        // Per-battle kill switch for BattleAI spell evaluation (0 = off).
+        // An evaluation is never interrupted: once a single one takes longer
+        // than this, spells are not evaluated for the rest of the battle.
+        int spellCutoffMs = 0;
+
         /*
          * Templates defined in the header
          * Needed to prevent linker errors for calls from derived classes
@@ -0,0 +1,244 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include <random>
+
+#include "BAI/episode_writer.h"
+#include "common.h"
+#include "schema/v13/types.h"
+
+namespace MMAI::BAI {
+    static std::unique_ptr<EpisodeWriter> sharedWriter;
+    static std::once_flag sharedWriterFlag;
+
+    namespace {
+        template <typename T>
+        void Append(std::vector<char> &buf, const T &value) {
+            const auto *p = reinterpret_cast<const char*>(&value);
+            buf.insert(buf.end(), p, p + sizeof(T));
+        }
+
+        const Schema::V13::ISupplementaryData* SupData(const Schema::IState* s) {
+            auto any = s->getSupplementaryData();
+            if (!any.has_value() || any.type() != typeid(const Schema::V13::ISupplementaryData*))
+                return nullptr;
+            return std::any_cast<const Schema::V13::ISupplementaryData*>(any);
+        }
+
+        // (own - enemy) army value, relative to the total value at start
+        double Balance(const Schema::IState* s) {
+            const auto *sup = SupData(s);
+            if (!sup)
+                return 0;
+
+            const auto *gstats = sup->getGlobalStats();
+            const auto *lstats = sup->getLeftPlayerStats();
+            const auto *rstats = sup->getRightPlayerStats();
+            if (!gstats || !lstats || !rstats)
+                return 0;
+
+            auto start = gstats->getAttr(Schema::V13::GlobalAttribute::BFIELD_VALUE_START_ABS);
+            if (start <= 0)
+                return 0;
+
+            auto left = lstats->getAttr(Schema::V13::PlayerAttribute::ARMY_VALUE_NOW_ABS);
+            auto right = rstats->getAttr(Schema::V13::PlayerAttribute::ARMY_VALUE_NOW_ABS);
+            auto diff = (sup->getSide() == Schema::Side::LEFT) ? left - right : right - left;
+            return static_cast<double>(diff) / start;
+        }
+
+        double Outcome(const Schema::IState* s) {
+            const auto *sup = SupData(s);
+            if (!sup || !sup->getIsBattleEnded())
+                return 0;
+            return sup->getIsVictorious() ? 1 : -1;
+        }
+
+        std::string RandomTag() {
+            auto rng = std::mt19937(std::random_device{}());
+            return boost::str(boost::format("%08x") % rng());
+        }
+    }
+
+    //
+    // Episode
+    //
+
+    EpisodeWriter::Episode::Episode(EpisodeWriter &writer_)
+    : writer(writer_)
+    , id(writer_.nextEpisode++)
+    {}
+
+    EpisodeWriter::Episode::~Episode() {
+        if (hasPending)
+            emit(0, TRUNCATED);
+    }
+
+    void EpisodeWriter::Episode::onDecision(const Schema::IState* s, Schema::Action action) {
+        auto b = Balance(s);
+        if (hasPending)
+            emit(b - balance, 0);
+
+        pending.clear();
+        Snapshot::Serialize(s, action, pending);
+        hasPending = true;
+        balance = b;
+    }
+
+    void EpisodeWriter::Episode::onEnd(const Schema::IState* s) {
+        if (hasPending)
+            emit(Balance(s) - balance + Outcome(s), DONE);
+    }
+
+    void EpisodeWriter::Episode::emit(float reward, uint32_t flags) {
+        writer.append(id, step++, reward, flags, pending);
+        hasPending = false;
+    }
+
+    //
+    // EpisodeWriter
+    //
+
+    // static
+    void EpisodeWriter::Configure(const std::string &dir, size_t shardBytes) {
+        std::call_once(sharedWriterFlag, [&dir, shardBytes] {
+            if (dir.empty())
+                return;
+
+            try {
+                sharedWriter = std::make_unique<EpisodeWriter>(dir, shardBytes);
+                logAi->info("MMAI: writing episodes to %s (shard size: %d MB)", dir, shardBytes >> 20);
+            } catch (const std::exception &e) {
+                logAi->error("MMAI: episode writing disabled: %s", e.what());
+            }
+        });
+    }
+
+    // static
+    EpisodeWriter* EpisodeWriter::Shared() {
+        return sharedWriter.get();
+    }
+
+    EpisodeWriter::EpisodeWriter(const std::string &dir_, size_t shardBytes_, size_t bufferBytes_)
+    : dir(dir_)
+    , tag(RandomTag())
+    , shardBytes(shardBytes_)
+    , bufferBytes(bufferBytes_)
+    , spare(std::make_shared<Buffer>())
+    {
+        boost::filesystem::create_directories(dir);
+        active.data.reserve(bufferBytes + (bufferBytes >> 2));
+        spare->data.reserve(bufferBytes + (bufferBytes >> 2));
+    }
+
+    EpisodeWriter::~EpisodeWriter() {
+        // Write tasks don't throw (see submit), so neither does flush()
+        flush();
+    }
+
+    void EpisodeWriter::append(uint64_t episode, uint32_t step, float reward, uint32_t flags, const std::vector<char> &record) {
+        if (failed)
+            return;
+
+        auto header = EntryHeader{sizeof(EntryHeader) + record.size(), episode, step, reward, flags, 0};
+
+        auto lock = std::unique_lock(mutex);
+        active.index.push_back({active.data.size(), episode, step, flags});
+        Append(active.data, header);
+        active.data.insert(active.data.end(), record.begin(), record.end());
+
+        if (active.data.size() >= bufferBytes)
+            submit(lock);
+    }
+
+    void EpisodeWriter::flush() {
+        {
+            auto lock = std::unique_lock(mutex);
+            submit(lock);
+        }
+        worker.sync();
+    }
+
+    void EpisodeWriter::submit(std::unique_lock<std::mutex> &lock) {
+        if (active.index.empty())
+            return;
+
+        // Only two buffers: wait for the previous one to be written
+        spareReturned.wait(lock, [this] { return spare != nullptr; });
+
+        auto full = std::move(spare);
+        std::swap(active, *full);
+        active.data.clear();
+        active.index.clear();
+
+        worker.post([this, full] {
+            if (!failed) {
+                try {
+                    write(*full);
+                } catch (const std::exception &e) {
+                    logAi->error("MMAI: episode writing disabled: %s", e.what());
+                    failed = true;
+                }
+            }
+
+            {
+                auto lock2 = std::lock_guard(mutex);
+                spare = full;
+            }
+            spareReturned.notify_all();
+        });
+    }
+
+    void EpisodeWriter::write(const Buffer &buf) {
+        for (size_t i = 0; i < buf.index.size(); ++i) {
+            if (shard < 0 || shardSize >= shardBytes)
+                rotate();
+
+            auto entry = buf.index.at(i);
+            auto end = (i + 1 < buf.index.size()) ? buf.index.at(i + 1).offset : buf.data.size();
+            auto size = end - entry.offset;
+
+            dataFile.write(buf.data.data() + entry.offset, size);
+            entry.offset = shardSize;
+            indexFile.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            shardSize += size;
+        }
+
+        dataFile.flush();
+        indexFile.flush();
+        if (!dataFile || !indexFile)
+            throw std::runtime_error("Failed to write episode data");
+    }
+
+    void EpisodeWriter::rotate() {
+        ++shard;
+        auto base = boost::str(boost::format("%s/episodes-%s-%05d") % dir % tag % shard);
+
+        dataFile.close();
+        indexFile.close();
+        dataFile.open(base + ".bin", std::ios::binary | std::ios::trunc);
+        indexFile.open(base + ".idx", std::ios::binary | std::ios::trunc);
+        if (!dataFile || !indexFile)
+            THROW_FORMAT("Failed to open episode shard: %s", base);
+
+        auto header = Snapshot::FileHeader{EPISODE_MAGIC, Snapshot::FORMAT_VERSION, Snapshot::LINK_TYPES};
+        dataFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        shardSize = sizeof(header);
+    }
+}
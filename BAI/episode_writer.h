@@ -0,0 +1,174 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "BAI/serial_worker.h"
+#include "BAI/snapshot.h"
+#include "schema/base.h"
+
+/*
+ * Training data (episodes) written by MMAI itself, so that data collection
+ * does not need to pull and serialize everything through the connector.
+ *
+ * Data is written to shards in a directory, rotated by size:
+ *
+ *   <dir>/episodes-<tag>-00000.bin
+ *   <dir>/episodes-<tag>-00000.idx
+ *   <dir>/episodes-<tag>-00001.bin
+ *   ...
+ *
+ * where <tag> is random per process, so multiple processes may share
+ * a directory.
+ *
+ * Shard layout (native byte order, 8-byte aligned records):
+ *
+ *   Snapshot::FileHeader (with EPISODE_MAGIC)
+ *   EntryHeader + Snapshot record (state, mask, links, action)
+ *   EntryHeader + Snapshot record
+ *   ...
+ *
+ * The index holds one IndexEntry per record, so episodes can be located
+ * without scanning the shard.
+ *
+ * Reward is the change in the army value balance since the previous
+ * decision, with +1/-1 added for a win/loss at the end of the episode:
+ *
+ *   balance = (own_army_value - enemy_army_value) / battlefield_value_at_start
+ *
+ * Records are appended to an in-memory buffer which is handed to
+ * a background thread when full (double buffering), so the game thread
+ * waits for disk I/O only if the previous buffer is still being written.
+ *
+ * Errors are logged and disable the writer (they never reach the BAI).
+ */
+namespace MMAI::BAI {
+    class EpisodeWriter {
+    public:
+        static constexpr std::array<char, 8> EPISODE_MAGIC = {'M', 'M', 'A', 'I', 'E', 'P', 'I', 'S'};
+        static constexpr size_t DEFAULT_SHARD_BYTES = 256 << 20;
+        static constexpr size_t DEFAULT_BUFFER_BYTES = 4 << 20;
+
+        enum Flags : uint32_t {
+            DONE = 1,       // last step of a finished battle
+            TRUNCATED = 2,  // last step of an unfinished battle (no reward)
+        };
+
+        struct EntryHeader {
+            uint64_t size;      // total entry size (incl. this header)
+            uint64_t episode;
+            uint32_t step;
+            float reward;
+            uint32_t flags;
+            uint32_t _pad;
+        };
+
+        struct IndexEntry {
+            uint64_t offset;    // EntryHeader offset in the shard
+            uint64_t episode;
+            uint32_t step;
+            uint32_t flags;
+        };
+
+        static_assert(sizeof(EntryHeader) % 8 == 0);
+        static_assert(std::is_trivially_copyable_v<IndexEntry>);
+
+        // The steps of one battle from the perspective of one BAI.
+        // A step is written once its reward is known, i.e. on the next
+        // decision or at the end of the battle.
+        class Episode {
+        public:
+            explicit Episode(EpisodeWriter &writer_);
+            ~Episode();  // writes a pending step as TRUNCATED
+
+            Episode(const Episode&) = delete;
+            Episode& operator=(const Episode&) = delete;
+
+            // The model chose `action` in state `s`
+            void onDecision(const Schema::IState* s, Schema::Action action);
+
+            // `s` is the terminal state
+            void onEnd(const Schema::IState* s);
+
+        private:
+            void emit(float reward, uint32_t flags);
+
+            EpisodeWriter &writer;
+            const uint64_t id;
+            uint32_t step = 0;
+            std::vector<char> pending;  // the previous step's record
+            bool hasPending = false;
+            double balance = 0;         // at the previous step
+        };
+
+        // Enables the process-wide writer (empty dir => disabled).
+        // Logs an error and leaves it disabled if `dir` can't be used.
+        // Not thread-safe; call before any battle starts.
+        static void Configure(const std::string &dir, size_t shardBytes);
+
+        // The process-wide writer, or nullptr if disabled
+        static EpisodeWriter* Shared();
+
+        EpisodeWriter(const std::string &dir, size_t shardBytes, size_t bufferBytes = DEFAULT_BUFFER_BYTES);
+        ~EpisodeWriter();  // writes all buffered entries
+
+        EpisodeWriter(const EpisodeWriter&) = delete;
+        EpisodeWriter& operator=(const EpisodeWriter&) = delete;
+
+        // Waits only if both buffers are full
+        void append(uint64_t episode, uint32_t step, float reward, uint32_t flags, const std::vector<char> &record);
+
+        // Blocks until all entries so far are written
+        void flush();
+
+    private:
+        struct Buffer {
+            std::vector<char> data;
+            std::vector<IndexEntry> index;  // offsets are relative to `data`
+        };
+
+        void submit(std::unique_lock<std::mutex> &lock);
+        void write(const Buffer &buf);  // called on the worker thread
+        void rotate();  // called on the worker thread
+
+        const std::string dir;
+        const std::string tag;
+        const size_t shardBytes;
+        const size_t bufferBytes;
+        std::atomic<uint64_t> nextEpisode {0};
+
+        std::mutex mutex;
+        std::condition_variable spareReturned;
+        Buffer active;
+        std::shared_ptr<Buffer> spare;  // nullptr while its contents are being written
+        std::atomic<bool> failed = false;
+
+        // Accessed only by the worker
+        std::ofstream dataFile;
+        std::ofstream indexFile;
+        int shard = -1;
+        uint64_t shardSize = 0;
+
+        SerialWorker worker;  // last (destroyed first)
+    };
+}
@@ -0,0 +1,150 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include "battle/BattleHex.h"
+#include "common.h"
+
+#include <array>
+#include <cstdint>
+
+/*
+ * Compile-time geometry tables for the 165 available battlefield hexes.
+ *
+ * Hexes are referred to either by "id" (0..164, row-major over the 15x11
+ * available area, as used by the observation) or by their raw BattleHex
+ * number (0..186, which includes the two "side" columns).
+ *
+ * All neighbour lookups mirror BattleHex::cloneInDirection(dir, false):
+ * the raw number is computed as x + y*BFIELD_WIDTH without validation,
+ * so out-of-field neighbours yield BattleHex values which are not
+ * isAvailable() (exactly as before).
+ */
+namespace MMAI::BAI::HexGeometry {
+    constexpr int BFIELD_WIDTH = 17;
+    constexpr int BFIELD_HEIGHT = 11;
+    constexpr int BFIELD_SIZE = BFIELD_WIDTH * BFIELD_HEIGHT;
+
+    static_assert(BFIELD_WIDTH == GameConstants::BFIELD_WIDTH);
+    static_assert(BFIELD_HEIGHT == GameConstants::BFIELD_HEIGHT);
+    static_assert(BF_XMAX == BFIELD_WIDTH - 2);
+    static_assert(BF_YMAX == BFIELD_HEIGHT);
+    static_assert(BF_SIZE == BF_XMAX * BF_YMAX);
+
+    constexpr int N_NEARBY = 12;
+    constexpr int ADJ_WORDS = (BF_SIZE + 63) / 64;
+
+    struct Tables {
+        std::array<int16_t, BF_SIZE> bhexes {};                 // id => raw BattleHex
+        std::array<int16_t, BFIELD_SIZE> ids {};                // raw BattleHex => id (-1 if unavailable)
+        std::array<std::array<int8_t, 2>, BF_SIZE> xy {};       // id => (x, y)
+        std::array<std::array<int16_t, N_NEARBY>, BF_SIZE> nearby {};  // id => raw BattleHex (see Hex::NearbyBattleHexes)
+        std::array<std::array<uint64_t, ADJ_WORDS>, BF_SIZE> adjacent {}; // id x id => bit
+    };
+
+    // Same as BattleHex::moveInDirection (with hasToBeValid=false)
+    constexpr int Move(int bh, BattleHex::EDir dir) {
+        int x = bh % BFIELD_WIDTH;
+        int y = bh / BFIELD_WIDTH;
+
+        switch (dir) {
+        break; case BattleHex::EDir::TOP_LEFT:     return ((y%2) ? x-1 : x) + (y-1)*BFIELD_WIDTH;
+        break; case BattleHex::EDir::TOP_RIGHT:    return ((y%2) ? x : x+1) + (y-1)*BFIELD_WIDTH;
+        break; case BattleHex::EDir::RIGHT:        return x+1 + y*BFIELD_WIDTH;
+        break; case BattleHex::EDir::BOTTOM_RIGHT: return ((y%2) ? x : x+1) + (y+1)*BFIELD_WIDTH;
+        break; case BattleHex::EDir::BOTTOM_LEFT:  return ((y%2) ? x-1 : x) + (y+1)*BFIELD_WIDTH;
+        break; case BattleHex::EDir::LEFT:         return x-1 + y*BFIELD_WIDTH;
+        break; default: return bh;
+        }
+    }
+
+    constexpr bool IsAvailable(int bh) {
+        if (bh < 0 || bh >= BFIELD_SIZE)
+            return false;
+        int x = bh % BFIELD_WIDTH;
+        return x > 0 && x < BFIELD_WIDTH - 1;
+    }
+
+    constexpr Tables Build() {
+        using D = BattleHex::EDir;
+        auto res = Tables{};
+
+        for (int bh = 0; bh < BFIELD_SIZE; ++bh)
+            res.ids[bh] = -1;
+
+        for (int id = 0; id < BF_SIZE; ++id) {
+            int x = id % BF_XMAX;
+            int y = id / BF_XMAX;
+            int bh = x + 1 + y*BFIELD_WIDTH;
+
+            res.bhexes[id] = bh;
+            res.ids[bh] = id;
+            res.xy[id] = {static_cast<int8_t>(x), static_cast<int8_t>(y)};
+        }
+
+        for (int id = 0; id < BF_SIZE; ++id) {
+            int bh = res.bhexes[id];
+            int bhR = Move(bh, D::RIGHT);
+            int bhL = Move(bh, D::LEFT);
+
+            // Order must match the AMOVE_* HexActions (see Hex::NearbyBattleHexes)
+            int nearby[N_NEARBY] = {
+                Move(bh, D::TOP_RIGHT),
+                bhR,
+                Move(bh, D::BOTTOM_RIGHT),
+                Move(bh, D::BOTTOM_LEFT),
+                bhL,
+                Move(bh, D::TOP_LEFT),
+                Move(bhR, D::TOP_RIGHT),
+                Move(bhR, D::RIGHT),
+                Move(bhR, D::BOTTOM_RIGHT),
+                Move(bhL, D::BOTTOM_LEFT),
+                Move(bhL, D::LEFT),
+                Move(bhL, D::TOP_LEFT),
+            };
+
+            for (int i = 0; i < N_NEARBY; ++i)
+                res.nearby[id][i] = nearby[i];
+
+            // The first 6 are the basic (adjacent) directions
+            for (int i = 0; i < 6; ++i) {
+                if (!IsAvailable(nearby[i]))
+                    continue;
+                int nid = res.ids[nearby[i]];
+                res.adjacent[id][nid / 64] |= uint64_t(1) << (nid % 64);
+            }
+        }
+
+        return res;
+    }
+
+    inline constexpr Tables TABLES = Build();
+
+    static_assert(TABLES.bhexes[0] == 1);
+    static_assert(TABLES.bhexes[BF_SIZE-1] == BFIELD_SIZE - 2);
+    static_assert(TABLES.ids[0] == -1 && TABLES.ids[BFIELD_WIDTH-1] == -1);
+
+    // Returns -1 for unavailable hexes
+    constexpr int Id(int bh) {
+        return (bh < 0 || bh >= BFIELD_SIZE) ? -1 : TABLES.ids[bh];
+    }
+
+    constexpr bool Adjacent(int id1, int id2) {
+        return (TABLES.adjacent[id1][id2 / 64] >> (id2 % 64)) & 1;
+    }
+}
@@ -0,0 +1,31 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "StdInc.h"
+
+#include "MappedFile.h"
+
+namespace MMAI::BAI {
+    namespace bip = boost::interprocess;
+
+    MappedFile::MappedFile(const std::string &path)
+    : mapping(path.c_str(), bip::read_only)
+    , region(mapping, bip::read_only)
+    {
+        // Weights are read sequentially during model load
+        region.advise(bip::mapped_region::advice_sequential);
+    }
+}
@@ -0,0 +1,47 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace MMAI::BAI {
+    /*
+     * A read-only memory mapping of a (model) file.
+     *
+     * Pages are backed by the OS page cache and are therefore shared
+     * between all processes mapping the same file (e.g. many headless
+     * VCMI instances using the same model).
+     *
+     * Throws boost::interprocess::interprocess_exception on failure.
+     */
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path);
+
+        // Non-copyable (the mapping is unmapped on destruction)
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const void * data() const { return region.get_address(); }
+        size_t size() const { return region.get_size(); }
+
+    private:
+        boost::interprocess::file_mapping mapping;
+        boost::interprocess::mapped_region region;
+    };
+}
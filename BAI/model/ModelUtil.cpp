@@ -0,0 +1,322 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include "BAI/alloc_stats.h"
+#include "BAI/model/ModelUtil.h"
+#include "BAI/perf_stats.h"
+#include "vstd/CLoggerBase.h"
+
+namespace MMAI::BAI::ModelUtil {
+namespace {
+    template<class... Args>
+    [[noreturn]] inline void throwf(const std::string& fmt, Args&&... args) {
+        boost::format f("ModelUtil: " + fmt);
+        (void)std::initializer_list<int>{ ( (f % std::forward<Args>(args)), 0 )... };
+        throw std::runtime_error(f.str());
+    }
+
+    int32_t Allowed(const Schema::V13::PackedActionMask& mask, int32_t action) {
+        return action >= 0 && action < Schema::V13::PackedActionMask::N_ACTIONS && mask.test(action);
+    }
+}
+
+    // Samples directly from the (contiguous, CPU) output buffers.
+    // K is at most 165, so all scratch space lives on the stack.
+    SampleResult sample_masked_logits(
+        const float* logits,        // length K
+        const int32_t* mask,        // length K, 0/1
+        int K,
+        bool throw_if_empty,
+        float temperature,
+        std::mt19937& rng
+    ) {
+        constexpr int KMAX = 165;
+        if (K <= 0 || K > KMAX) throwf("bad logits size: %d", K);
+        if (temperature < 0.0) throwf("negative temperature");
+
+        int n_valid = 0;
+        for (int i = 0; i < K; ++i)
+            n_valid += (mask[i] != 0);
+
+        if (n_valid == 0) {
+            if (throw_if_empty)
+                throwf("No valid options available for act0");
+            return {0, 0.0, true}; // fallback index
+        }
+
+        if (temperature > 1e8) {
+            // Uniform over valid
+            auto dist = std::uniform_int_distribution<int>(0, n_valid - 1);
+            int nth = dist(rng);
+            for (int i = 0; i < K; ++i) {
+                if (mask[i] && nth-- == 0)
+                    return {i, 1.0 / n_valid, false};
+            }
+            throwf("uniform sampling failed");
+        }
+
+        // Argmax among valid (also needed as the softmax stabilizer)
+        int imax = -1;
+        for (int i = 0; i < K; ++i) {
+            if (mask[i] && (imax < 0 || logits[i] > logits[imax]))
+                imax = i;
+        }
+
+        if (temperature < 1e-8)
+            return {imax, 1.0, false};
+
+        // Standard softmax(logits / T), subtracting the max for stability
+        auto probs = std::array<double, KMAX>{};
+        const double m = logits[imax] / static_cast<double>(temperature);
+        double sum = 0.0;
+        for (int i = 0; i < K; ++i) {
+            if (mask[i]) {
+                probs[i] = std::exp(logits[i] / static_cast<double>(temperature) - m);
+                sum += probs[i];
+            }
+        }
+
+        if (!std::isfinite(sum) || sum <= 0.0)
+            throwf("non-finite probabilities");
+
+        auto dist = std::uniform_real_distribution<double>(0.0, sum);
+        double u = dist(rng);
+        int last = imax;
+        for (int i = 0; i < K; ++i) {
+            if (!mask[i]) continue;
+            last = i;
+            if (u < probs[i])
+                return {i, probs[i] / sum, false};
+            u -= probs[i];
+        }
+
+        // rounding error: fall back to the last valid index
+        return {last, probs[last] / sum, false};
+    }
+
+    TripletSample sample_triplet(
+        const float* a0_log,
+        const float* h1_log,
+        const float* h2_log,
+        const int32_t* m_a0,
+        const int32_t* m_h1,
+        const int32_t* m_h2,
+        float temperature,
+        std::mt19937& rng
+    ) {
+        auto allocScope = AllocStats::Scope(AllocStats::Stage::SAMPLING);
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::SAMPLING);
+
+        // Sample act0
+        auto act0 = sample_masked_logits(a0_log, m_a0, 4, true, temperature, rng);
+
+        // Sample hex1 (mask row for act0)
+        auto hex1 = sample_masked_logits(h1_log, m_h1 + act0.index*165, 165, false, temperature, rng);
+
+        // Sample hex2 (mask row for act0, hex1)
+        auto hex2 = sample_masked_logits(h2_log, m_h2 + (act0.index*165 + hex1.index)*165, 165, false, temperature, rng);
+
+        // joint
+        double confidence = act0.prob * (hex1.fallback ? 1.0 : hex1.prob) * (hex2.fallback ? 1.0 : hex2.prob);
+
+        return {act0.index, hex1.index, hex2.index, confidence};
+    }
+
+    TripletSample sample_triplet(
+        const float* a0_log,
+        const float* h1_log,
+        const float* h2_log,
+        const Schema::V13::PackedActionMask& mask,
+        const int32_t* action_table,
+        float temperature,
+        std::mt19937& rng
+    ) {
+        auto allocScope = AllocStats::Scope(AllocStats::Stage::SAMPLING);
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::SAMPLING);
+
+        auto m_a0 = std::array<int32_t, 4>{};
+        auto m_h1 = std::array<int32_t, 165>{};
+        auto m_h2 = std::array<int32_t, 165>{};
+
+        // act0 is allowed if any (hex1, hex2) is
+        for (int a = 0; a < 4; ++a) {
+            const auto *table = action_table + a*165*165;
+            for (int i = 0; i < 165*165 && !m_a0[a]; ++i)
+                m_a0[a] = Allowed(mask, table[i]);
+        }
+
+        auto act0 = sample_masked_logits(a0_log, m_a0.data(), 4, true, temperature, rng);
+
+        // hex1 is allowed if any hex2 is (for the sampled act0)
+        const auto *rows = action_table + act0.index*165*165;
+        for (int h1 = 0; h1 < 165; ++h1) {
+            for (int h2 = 0; h2 < 165 && !m_h1[h1]; ++h2)
+                m_h1[h1] = Allowed(mask, rows[h1*165 + h2]);
+        }
+
+        auto hex1 = sample_masked_logits(h1_log, m_h1.data(), 165, false, temperature, rng);
+
+        const auto *row = rows + hex1.index*165;
+        for (int h2 = 0; h2 < 165; ++h2)
+            m_h2[h2] = Allowed(mask, row[h2]);
+
+        auto hex2 = sample_masked_logits(h2_log, m_h2.data(), 165, false, temperature, rng);
+
+        double confidence = act0.prob * (hex1.fallback ? 1.0 : hex1.prob) * (hex2.fallback ? 1.0 : hex2.prob);
+
+        return {act0.index, hex1.index, hex2.index, confidence};
+    }
+
+    std::array<std::vector<int32_t>, 165> buildNBR_unpadded(const std::vector<int64_t>& dst) {
+        // Pass 1: validate and count degrees per node
+        std::array<int, 165> deg{};
+        for (size_t e = 0; e < dst.size(); ++e) {
+            int v = static_cast<int>(dst[e]);
+            if (v < 0 || v >= 165)
+                throwf("dst contains node id out of range: ", v);
+            ++deg[v];
+        }
+
+        std::array<std::vector<int32_t>, 165> nbr{};
+        for (int v = 0; v < 165; ++v) nbr[v].reserve(deg[v]);
+        for (size_t e = 0; e < dst.size(); ++e) {
+            int v = static_cast<int>(dst[e]);
+            nbr[v].push_back(static_cast<int32_t>(e));
+        }
+
+        return nbr;
+    }
+
+    // all_sizes: S x LT_COUNT x 2, where [s][l] = {emax, kmax}
+    BuildOutputs build_flattened(
+        const std::array<IndexContainer, LT_COUNT>& containers,
+        const std::vector<std::vector<std::vector<int32_t>>>& all_sizes,
+        int bucket
+    ) {
+        BuildOutputs out{};
+
+        // Required per-linktype capacities from data
+        std::array<size_t, LT_COUNT> e_req{};
+        std::array<size_t, LT_COUNT> k_req{};
+        for (int l = 0; l < LT_COUNT; ++l) {
+            e_req[l] = containers[l].ea.size();
+            size_t km = 0;
+            for (int v = 0; v < 165; ++v)
+                km = std::max(km, containers[l].nbrs[v].size());
+            k_req[l] = km;
+        }
+
+        // 1) Find smallest valid size index
+        int chosen = -1;
+        std::array<int32_t, LT_COUNT> emax{}, kmax{};
+        for (int s = 0; s < static_cast<int>(all_sizes.size()); ++s) {
+            const auto& sz = all_sizes[s];
+            if (sz.size() != LT_COUNT) continue;  // skip malformed
+            bool ok = true;
+            for (int l = 0; l < LT_COUNT && ok; ++l) {
+                if (sz[l].size() != 2) { ok = false; break; }
+                int32_t emax_l = sz[l][0];
+                int32_t kmax_l = sz[l][1];
+                if (emax_l < static_cast<int32_t>(e_req[l]) ||
+                    kmax_l < static_cast<int32_t>(k_req[l])) {
+                    ok = false;
+                }
+            }
+            ok = ok && (bucket == -1 || s == bucket);
+            if (ok) {
+                chosen = s;
+                for (int l = 0; l < LT_COUNT; ++l) {
+                    emax[l] = sz[l][0];
+                    kmax[l] = sz[l][1];
+                }
+                break;
+            }
+        }
+
+        // TODO: emit a warning and truncate edges instead (not straightforward)
+        if (chosen < 0) {
+            throw std::runtime_error("No size option in all_sizes satisfies the data requirements.");
+        }
+
+        logAi->debug("Size: %d", chosen);
+        for (int i=0; i<LT_COUNT; ++i)
+            logAi->debug("  %d: [%ld, %ld] -> [%lld, %lld]", i, e_req[i], k_req[i], all_sizes[chosen][i][0], all_sizes[chosen][i][1]);
+
+
+        out.size_index = chosen;
+        out.emax = emax;
+        out.kmax = kmax;
+
+        // Precompute sums
+        const size_t sum_emax = std::accumulate(emax.begin(), emax.end(), 0);
+        const size_t sum_kmax = std::accumulate(kmax.begin(), kmax.end(), 0);
+
+        // 2) Build ei_flat and ea_flat (concat each layer's ei/ea, zero-padded to emax[l])
+        out.ei_flat.at(0).clear();
+        out.ei_flat.at(1).clear();
+        out.ea_flat.clear();
+
+        out.ei_flat.at(0).reserve(sum_emax);
+        out.ei_flat.at(1).reserve(sum_emax);
+        out.ea_flat.reserve(sum_emax);
+        for (int l = 0; l < LT_COUNT; ++l) {
+            const auto& ei = containers[l].ei;
+            const auto& ea = containers[l].ea;
+
+            out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), ei.at(0).begin(), ei.at(0).end());
+            out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), ei.at(1).begin(), ei.at(1).end());
+            out.ea_flat.insert(out.ea_flat.end(), ea.begin(), ea.end());
+
+            size_t need = static_cast<size_t>(emax[l]) - ei.at(0).size();
+            if (need > 0) out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), need, 0);
+
+            need = static_cast<size_t>(emax[l]) - ei.at(1).size();
+            if (need > 0) out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), need, 0);
+
+            need = static_cast<size_t>(emax[l]) - ea.size();
+            if (need > 0) out.ea_flat.insert(out.ea_flat.end(), need, 0.0f);
+        }
+        // Sanity
+        if (out.ei_flat.at(0).size() != sum_emax)
+            throwf("ei_flat.at(0) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(0).size());
+        if (out.ei_flat.at(1).size() != sum_emax)
+            throwf("ei_flat.at(1) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(1).size());
+        if (out.ea_flat.size() != sum_emax)
+            throwf("ea_flat size mismatch: want: %d, have: %zu", sum_emax, out.ea_flat.size());
+
+        // 3) Build nbrs_flat per node: concat layer l, pad to kmax[l] with -1
+        for (int v = 0; v < 165; ++v) {
+            auto& dst = out.nbrs_flat[v];
+            dst.clear();
+            dst.reserve(sum_kmax);
+            for (int l = 0; l < LT_COUNT; ++l) {
+                const auto& src = containers[l].nbrs[v];
+                dst.insert(dst.end(), src.begin(), src.end());
+                const size_t need = static_cast<size_t>(kmax[l]) - src.size();
+                if (need > 0) dst.insert(dst.end(), need, static_cast<int32_t>(-1));
+            }
+            // Optional sanity:
+            if (dst.size() != sum_kmax) {
+                throw std::runtime_error("nbrs_flat row size mismatch.");
+            }
+        }
+
+        return out;
+    }
+}
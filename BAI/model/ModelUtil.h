@@ -0,0 +1,107 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "schema/v13/types.h"
+
+// Backend-independent helpers used by the TorchModel implementations
+// for building the graph inputs and sampling from the model outputs.
+namespace MMAI::BAI::ModelUtil {
+    constexpr int LT_COUNT = static_cast<int>(Schema::V13::LinkType::_count);
+
+    struct SampleResult {
+        int index;
+        double prob;      // softmax probability of the chosen index
+        bool fallback;    // true if choice came from the policy fallback
+    };
+
+    // Samples directly from the (contiguous, CPU) output buffers.
+    SampleResult sample_masked_logits(
+        const float* logits,        // length K
+        const int32_t* mask,        // length K, 0/1
+        int K,
+        bool throw_if_empty,
+        float temperature,
+        std::mt19937& rng
+    );
+
+    struct TripletSample {
+        int act0;  // over 4 actions
+        int hex1;  // over 165 hexes
+        int hex2;  // over 165 hexes
+        double confidence;  // joint prob
+    };
+
+    // Samples (act0, hex1, hex2) given the model's logits and masks.
+    // All buffers are contiguous, batch dim is 1.
+    TripletSample sample_triplet(
+        const float* act0_logits,   // [4]
+        const float* hex1_logits,   // [165]
+        const float* hex2_logits,   // [165]
+        const int32_t* mask_act0,   // [4]
+        const int32_t* mask_hex1,   // [4, 165]
+        const int32_t* mask_hex2,   // [4, 165, 165]
+        float temperature,
+        std::mt19937& rng
+    );
+
+    // Same as above, with the masks derived from the state's action mask:
+    // (act0, hex1, hex2) is allowed if the model's action table maps it to
+    // an allowed action. Only the mask rows for the sampled act0 and hex1
+    // are derived, so models need not output any masks.
+    TripletSample sample_triplet(
+        const float* act0_logits,   // [4]
+        const float* hex1_logits,   // [165]
+        const float* hex2_logits,   // [165]
+        const Schema::V13::PackedActionMask& mask,
+        const int32_t* action_table,  // [4, 165, 165], <0 means no action
+        float temperature,
+        std::mt19937& rng
+    );
+
+    // Edge indexes grouped by dst node
+    std::array<std::vector<int32_t>, 165> buildNBR_unpadded(const std::vector<int64_t>& dst);
+
+    struct IndexContainer {
+        std::array<std::vector<int32_t>, 2> ei;
+        std::vector<float> ea;
+        std::array<std::vector<int32_t>, 165> nbrs;
+    };
+
+    struct BuildOutputs {
+        int size_index = -1;                                // chosen index in all_sizes
+        std::array<int32_t, LT_COUNT> emax{};               // chosen emax per link type
+        std::array<int32_t, LT_COUNT> kmax{};               // chosen kmax per link type
+
+        std::array<std::vector<int32_t>, 2> ei_flat;        // each length sum(emax)
+        std::vector<float> ea_flat;                         // length sum(emax)
+        std::array<std::vector<int32_t>, 165> nbrs_flat;    // each length sum(kmax)
+    };
+
+    // all_sizes: S x LT_COUNT x 2, where [s][l] = {emax, kmax}
+    BuildOutputs build_flattened(
+        const std::array<IndexContainer, LT_COUNT>& containers,
+        const std::vector<std::vector<std::vector<int32_t>>>& all_sizes,
+        int bucket
+    );
+}
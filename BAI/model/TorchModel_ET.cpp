@@ -16,12 +16,14 @@
 #include <executorch/runtime/platform/runtime.h>
 
 #include "StdInc.h"
+#include "BAI/alloc_stats.h"
+#include "BAI/perf_stats.h"
 #include "BAI/model/TorchModel_ET.h"
 #include "TorchModel.h"
 
-namespace MMAI::BAI {
+#include <executorch/extension/threadpool/threadpool.h>
 
-using TensorPtr = et_ext::TensorPtr;
+namespace MMAI::BAI {
 
 constexpr int LT_COUNT = EI(MMAI::Schema::V13::LinkType::_count);
 
@@ -39,7 +41,7 @@ namespace {
         explicit ScopedTimer(const char* n) : name(n), t0(std::chrono::steady_clock::now()) {}
         ~ScopedTimer() {
             auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
-            logAi->warn("%s: %lld ms", name, dt);
+            logAi->debug("%s: %lld ms", name, dt);
         }
     };
 
@@ -308,13 +310,39 @@ namespace {
 // EOF: DEBUG FUNCTIONS
 */
 
-TorchModel::TorchModel(std::string &path)
-: path(path) {
-    auto loaderRes = et_ext::FileDataLoader::from(path.c_str());
-    if (!loaderRes.ok())
-        throwf("loader error code: %d", static_cast<int>(loaderRes.error()));
+TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed, int threads)
+: path(path)
+, temperature(temperature)
+{
+    logAi->info("MMAI params: seed=%1%, temperature=%2%, threads=%3%, model=%4%", seed, temperature, threads, path);
+
+    // NOTE: the threadpool is process-wide (shared by all loaded models)
+    if (threads > 0) {
+        auto *threadpool = et_ext::threadpool::get_threadpool();
+        if (!threadpool)
+            logAi->warn("MMAI: executorch threadpool unavailable, ignoring threads=%d", threads);
+        else if (threadpool->get_thread_count() != static_cast<size_t>(threads) && !threadpool->_unsafe_reset_threadpool(threads))
+            logAi->warn("MMAI: failed to resize executorch threadpool to %d threads", threads);
+    }
 
-    loader = std::make_unique<et_ext::FileDataLoader>(std::move(loaderRes.get()));
+#ifndef _WIN32
+    // Map the program read-only instead of reading it into private memory:
+    // constant (non-delegated) weights are then used directly from the
+    // page cache and shared between all VCMI processes using this model.
+    auto mmapRes = et_ext::MmapDataLoader::from(path.c_str(), et_ext::MmapDataLoader::MlockConfig::NoMlock);
+    if (mmapRes.ok())
+        loader = std::make_unique<et_ext::MmapDataLoader>(std::move(mmapRes.get()));
+    else
+        logAi->warn("Could not mmap %s (error code: %d), loading it regularly", path, static_cast<int>(mmapRes.error()));
+#endif
+
+    if (!loader) {
+        auto loaderRes = et_ext::FileDataLoader::from(path.c_str());
+        if (!loaderRes.ok())
+            throwf("loader error code: %d", static_cast<int>(loaderRes.error()));
+
+        loader = std::make_unique<et_ext::FileDataLoader>(std::move(loaderRes.get()));
+    }
 
     memory_allocator = std::make_unique<et_ext::MallocMemoryAllocator>();
     temp_allocator = std::make_unique<et_ext::MallocMemoryAllocator>();
@@ -395,13 +423,33 @@ TorchModel::TorchModel(std::string &path)
             }
         }
     }
+
+    // Load and memory-plan all per-bucket methods now, so that the first
+    // turn landing in a new bucket does not pay for it mid-battle.
+    for (int i = 0; i < all_sizes.size(); ++i) {
+        auto idx = std::to_string(i);
+        predict_methods.push_back(&loadMethod("predict" + idx));
+
+        // get_value is optional (only needed for getValue())
+        auto value_method = "get_value" + idx;
+        value_methods.push_back(hasMethod(value_method) ? &loadMethod(value_method) : nullptr);
+    }
 }
 
 // using AlignedBuf = std::vector<uint8_t, et_run::AlignedCharAllocator<64>>;
 
-void TorchModel::maybeLoadMethod(const std::string& method_name) {
+bool TorchModel::hasMethod(const std::string& method_name) {
+    return program->method_meta(method_name.c_str()).ok();
+}
+
+TorchModel::MethodHolder& TorchModel::maybeLoadMethod(const std::string& method_name) {
+    auto it = methods.find(method_name);
+    return (it == methods.end()) ? loadMethod(method_name) : it->second;
+}
+
+TorchModel::MethodHolder& TorchModel::loadMethod(const std::string& method_name) {
     if (methods.count(method_name))
-        return;
+        throwf("loadMethod: %s: already loaded", method_name);
 
     MethodHolder mh;
 
@@ -411,14 +459,12 @@ void TorchModel::maybeLoadMethod(const std::string& method_name) {
 
     const auto method_metadata = methodMetaRes.get();
     const auto planned_buffers_count = method_metadata.num_memory_planned_buffers();
-    // std::cout << "MEMDEBUG: " << method_name << ": planned_buffers_count=" << planned_buffers_count << "\n";
     mh.planned_buffers.reserve(planned_buffers_count);
     mh.planned_spans.reserve(planned_buffers_count);
 
     for (auto index = 0; index < planned_buffers_count; ++index) {
         const auto buffer_size = method_metadata.memory_planned_buffer_size(index).get();
         const auto safe_size = buffer_size; // * 5;
-        // std::cout << "MEMDEBUG: (" << index << ") buffer_size: " << buffer_size << " (safe: " << safe_size << ")\n";
         mh.planned_buffers.emplace_back(safe_size);
         mh.planned_spans.emplace_back(mh.planned_buffers.back().data(), safe_size);
     }
@@ -435,7 +481,9 @@ void TorchModel::maybeLoadMethod(const std::string& method_name) {
 
     mh.method = std::make_unique<et_run::Method>(std::move(*methodRes));
     mh.inputs.resize(mh.method->inputs_size());
-    methods.emplace(method_name, std::move(mh));
+    mh.outputs.resize(mh.method->outputs_size());
+    logAi->debug("Loaded method %s (%d planned buffers)", method_name, EI(planned_buffers_count));
+    return methods.emplace(method_name, std::move(mh)).first->second;
 }
 
 Tensor TorchModel::call(
@@ -444,20 +492,45 @@ Tensor TorchModel::call(
     int resNumel,
     ScalarType st
 ) {
-    auto timer = ScopedTimer("call");
-    maybeLoadMethod(method_name);
-    auto& method = methods.at(method_name).method;
-    auto& inputs = methods.at(method_name).inputs;
+    auto &mh = maybeLoadMethod(method_name);
 
-    if (input.size() != inputs.size())
-        throwf("call: %s: input size: %zu does not match method input size: %zu", method_name, input.size(), inputs.size());
+    if (input.size() != mh.inputs.size())
+        throwf("call: %s: input size: %zu does not match method input size: %zu", method_name, input.size(), mh.inputs.size());
 
-    for (auto i = 0; i < input.size(); ++i) {
-        inputs[i] = input[i];
-    }
+    for (auto i = 0; i < input.size(); ++i)
+        mh.inputs[i] = input[i];
+
+    return execute(mh, method_name, resNumel, st);
+}
 
-    std::cout << "INOPUTS SIZE: " << inputs.size() << ", INPUTS0 isTensor: " << inputs.at(0).isTensor() << ", numel: " << inputs[0].toTensor().numel() << ", dtype: " << EI(inputs[0].toTensor().dtype()) << "\n";
-    auto setRes = method->set_inputs(executorch::aten::ArrayRef<EValue>(inputs.data(), inputs.size()));
+Tensor TorchModel::call(
+    MethodHolder& mh,
+    const std::string& method_name,
+    const std::vector<TensorPtr>& input,
+    int resNumel,
+    ScalarType st
+) {
+    if (input.size() != mh.inputs.size())
+        throwf("call: %s: input size: %zu does not match method input size: %zu", method_name, input.size(), mh.inputs.size());
+
+    // NOTE: EValues refer to the tensors owned by `input`
+    for (auto i = 0; i < input.size(); ++i)
+        mh.inputs[i] = EValue(*input[i]);
+
+    return execute(mh, method_name, resNumel, st);
+}
+
+Tensor TorchModel::execute(
+    MethodHolder& mh,
+    const std::string& method_name,
+    int resNumel,
+    ScalarType st
+) {
+    auto timer = ScopedTimer("call");
+    auto perfScope = PerfStats::Scope(PerfStats::Stage::INFERENCE);
+    auto& method = mh.method;
+
+    auto setRes = method->set_inputs(executorch::aten::ArrayRef<EValue>(mh.inputs.data(), mh.inputs.size()));
     if (setRes != et_run::Error::Ok)
         throwf("set_inputs: %s: error code: %d", method_name, static_cast<int>(setRes));
 
@@ -465,18 +538,12 @@ Tensor TorchModel::call(
     if (execRes != et_run::Error::Ok)
         throwf("execute: %s: error code: %d", method_name, static_cast<int>(execRes));
 
-    const auto outputs_size = method->outputs_size();
-    auto outputs = std::vector<EValue>(outputs_size);
-
-    // Copy data to outputs
-    auto getoutRes = method->get_outputs(outputs.data(), outputs_size);
+    // Outputs are copied into the holder's persistent storage
+    auto getoutRes = method->get_outputs(mh.outputs.data(), mh.outputs.size());
     if (getoutRes != et_run::Error::Ok)
-        throwf("execute: %s: error code: %d", method_name, static_cast<int>(execRes));
-
-    // if (outputs.size() != 1)
-    //     throwf("call: %s: outputs.size(): want: 1, have: %zu", method_name, outputs.size());
+        throwf("get_outputs: %s: error code: %d", method_name, static_cast<int>(getoutRes));
 
-    auto out = outputs.at(0);
+    const auto &out = mh.outputs.at(0);
 
     if (!out.isTensor())
         throwf("call: %s: not a tensor", method_name);
@@ -525,6 +592,9 @@ std::pair<std::vector<TensorPtr>, int> TorchModel::prepareInputsV13(
     const MMAI::Schema::V13::ISupplementaryData* sup,
     int bucket
 ) {
+    auto allocScope = AllocStats::Scope(AllocStats::Stage::INPUTS);
+    auto perfScope = PerfStats::Scope(PerfStats::Stage::INPUTS);
+
     // XXX: if needed, support for other versions may be added via conditionals
     if (version != 13)
         throwf("unsupported version: want: 13, have: %d", version);
@@ -602,19 +672,16 @@ std::pair<std::vector<TensorPtr>, int> TorchModel::prepareInputsV13(
     for (auto &nbr : build.nbrs_flat)
         nbrs.insert(nbrs.end(), nbr.begin(), nbr.end());
 
-    auto t_state = et_ext::from_blob(estate.data(), {int(estate.size())}, ScalarType::Float);
-    auto t_ei_flat = et_ext::from_blob(einds.data(), {2, sum_e}, ScalarType::Int);
-    auto t_ea_flat = et_ext::from_blob(build.ea_flat.data(), {sum_e, 1}, ScalarType::Float);
-    auto t_nbrs_flat = et_ext::from_blob(nbrs.data(), {165, sum_k}, ScalarType::Int);
-
+    // The tensors take ownership of the vectors (no extra copy)
+    auto nstate = static_cast<int>(estate.size());
     auto tensors = std::vector<TensorPtr> {
-        et_ext::clone_tensor_ptr(t_state),
-        et_ext::clone_tensor_ptr(t_ei_flat),
-        et_ext::clone_tensor_ptr(t_ea_flat),
-        et_ext::clone_tensor_ptr(t_nbrs_flat)
+        et_ext::make_tensor_ptr({nstate}, std::move(estate)),
+        et_ext::make_tensor_ptr({2, sum_e}, std::move(einds)),
+        et_ext::make_tensor_ptr({sum_e, 1}, std::move(build.ea_flat)),
+        et_ext::make_tensor_ptr({165, sum_k}, std::move(nbrs))
     };
 
-    return {tensors, build.size_index};
+    return {std::move(tensors), build.size_index};
 }
 
 int TorchModel::getAction(const MMAI::Schema::IState * s) {
@@ -639,15 +706,6 @@ int TorchModel::getAction(const MMAI::Schema::IState * s) {
 
     auto [inputs, size_idx] = prepareInputsV13(s, sup);
 
-    auto values = std::vector<EValue>{};
-
-    // int i=0;
-    for (auto &t : inputs) {
-        values.push_back(t);
-        // printf("Input %d\n", i++);
-        // print_tensor_like_torch(t);
-    }
-
     // printf("--------------- 0:\n");
     // print_tensor_like_torch(inputs.at(0), 10, 6); // show up to 4 per dim, 6 decimals
     // printf("--------------- 1:\n");
@@ -657,7 +715,8 @@ int TorchModel::getAction(const MMAI::Schema::IState * s) {
     // printf("--------------- 3:\n");
     // print_tensor_like_torch(inputs.at(3), 10, 6); // show up to 4 per dim, 6 decimals
 
-    auto output = call("predict" + std::to_string(size_idx), values, 1, ScalarType(-1)); // -1=don't check dtype
+    auto method_name = "predict" + std::to_string(size_idx);
+    auto output = call(*predict_methods.at(size_idx), method_name, inputs, 1, ScalarType(-1)); // -1=don't check dtype
 
     int action;
 
@@ -806,11 +865,13 @@ double TorchModel::getValue(const MMAI::Schema::IState * s) {
         return 0.0;
 
     auto [inputs, size_idx] = prepareInputsV13(s, sup);
-    auto values = std::vector<EValue>{};
-    for (auto &t : inputs)
-        values.push_back(t);
+    auto method_name = "get_value" + std::to_string(size_idx);
+    auto *mh = value_methods.at(size_idx);
+
+    if (!mh)
+        throwf("getValue: method not found: %s", method_name);
 
-    auto output = call("predict" + std::to_string(size_idx), values, 1, ScalarType::Float);
+    auto output = call(*mh, method_name, inputs, 1, ScalarType::Float);
     auto value = output.const_data_ptr<float>()[0];
 
     return value;
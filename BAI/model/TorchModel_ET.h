@@ -22,6 +22,7 @@
 #include <vector>
 
 #include <executorch/extension/data_loader/file_data_loader.h>
+#include <executorch/extension/data_loader/mmap_data_loader.h>
 #include <executorch/extension/memory_allocator/malloc_memory_allocator.h>
 #include <executorch/extension/tensor/tensor.h>
 #include <executorch/runtime/core/evalue.h>
@@ -37,10 +38,11 @@ namespace et_run = executorch::runtime;
 using EValue = executorch::runtime::EValue;
 using Tensor = executorch::runtime::etensor::Tensor;
 using ScalarType = executorch::runtime::etensor::ScalarType;
+using TensorPtr = et_ext::TensorPtr;
 
 class TorchModel : public MMAI::Schema::IModel {
 public:
-    explicit TorchModel(std::string &path);
+    explicit TorchModel(std::string &path, float temperature, uint64_t seed, int threads);
 
     Schema::ModelType getType() override;
     std::string getName() override;
@@ -50,13 +52,14 @@ public:
     double getValue(const MMAI::Schema::IState * s) override;
 private:
     std::string path;
+    float temperature;  // unused: the predict<N> methods are greedy
     std::string name;
     int version;
     Schema::Side side;
 
     // https://github.com/pytorch/executorch/blob/v0.7.0/docs/source/running-a-model-cpp-tutorial.md
 
-    std::unique_ptr<et_ext::FileDataLoader> loader;
+    std::unique_ptr<et_run::DataLoader> loader;
     std::unique_ptr<et_ext::MallocMemoryAllocator> memory_allocator;
     std::unique_ptr<et_ext::MallocMemoryAllocator> temp_allocator;
     std::shared_ptr<executorch::runtime::Program> program;
@@ -68,11 +71,20 @@ private:
         std::unique_ptr<et_run::MemoryManager> memory_manager;
         std::unique_ptr<et_run::Method> method;
         std::vector<EValue> inputs;
+        std::vector<EValue> outputs;
     };
 
     std::unordered_map<std::string, MethodHolder> methods;
 
-    void maybeLoadMethod(const std::string& method_name);
+    // Per-bucket methods, loaded and memory-planned at construction
+    // (index = bucket). Pointers into `methods` (element references in an
+    // unordered_map remain valid across inserts).
+    std::vector<MethodHolder*> predict_methods;
+    std::vector<MethodHolder*> value_methods;  // nullptr if not exported
+
+    MethodHolder& loadMethod(const std::string& method_name);
+    MethodHolder& maybeLoadMethod(const std::string& method_name);
+    bool hasMethod(const std::string& method_name);
 
     // 3D tensor as a vector
     std::vector<std::vector<std::vector<int>>> all_sizes;
@@ -92,6 +104,11 @@ private:
         ScalarType st = ScalarType(-1)  // magic for "don't check"
     );
 
+    // Executes with whatever is currently in mh.inputs
+    Tensor execute(MethodHolder& mh, const std::string& method_name, int numel, ScalarType st);
+
+    Tensor call(MethodHolder& mh, const std::string& method_name, const std::vector<TensorPtr>& input, int numel, ScalarType st);
+
     Tensor call(const std::string &method_name, const EValue& ev, int numel, ScalarType st) {
         return call(method_name, std::vector<EValue>{ev}, numel, st);
     }
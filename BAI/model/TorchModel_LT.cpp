@@ -21,20 +21,34 @@
 // #include <ATen/ops/from_blob.h>
 // #include <ATen/ops/tensor.h>
 #include <ATen/ATen.h>
-#include <ATen/core/Generator.h>
+#include <ATen/Parallel.h>
+#include <c10/core/InferenceMode.h>
 #include <c10/core/ScalarType.h>
+#include <chrono>
 #include <mutex>
+#include <random>
 #include <tuple>
 #include <limits>
 #include <utility>
 
 #include "TorchModel_LT.h"
+#include "BAI/alloc_stats.h"
+#include "BAI/perf_stats.h"
+#include "BAI/model/ModelUtil.h"
+#include "BAI/v13/packed_state.h"
 #include "schema/schema.h"
 #include "vstd/CLoggerBase.h"
 
 namespace MMAI::BAI {
 
-constexpr int LT_COUNT = EI(MMAI::Schema::V13::LinkType::_count);
+using ModelUtil::LT_COUNT;
+using ModelUtil::IndexContainer;
+using ModelUtil::BuildOutputs;
+using ModelUtil::TripletSample;
+using ModelUtil::buildNBR_unpadded;
+using ModelUtil::build_flattened;
+
+namespace Packing = V13::Packing;
 
 namespace {
     template<class... Args>
@@ -54,269 +68,27 @@ namespace {
         }
     };
 
-    struct SampleResult {
-        int index;
-        double prob;      // softmax probability of the chosen index
-        bool fallback;    // true if choice came from the policy fallback
-    };
-
-    inline SampleResult sample_masked_logits(
-        const at::Tensor& logits_1d,     // shape [K], float
-        const at::Tensor& mask_1d,       // shape [K], bool
-        bool throw_if_empty,
-        float temperature = 1.0,
-        const c10::optional<at::Generator>& gen = c10::nullopt
-    ) {
-        if (logits_1d.size(0) != mask_1d.size(0)) throwf("size mismatch");
-        if (temperature < 0.0) throwf("negative temperature");
-
-        // Count valid options
-        auto n_valid = mask_1d.sum().item<int>();
-        if (n_valid == 0) {
-            if (throw_if_empty)
-                throwf("No valid options available for act0");
-            return {0, 0.0, true}; // fallback index
-        }
-
-        // Promote to float32 for stability if needed
-        auto logits = logits_1d.toType(at::kFloat);
-        auto mask = mask_1d.toType(at::kBool);
-
-        auto neginf = at::full_like(logits, -INFINITY);
-        auto masked_logits = at::where(mask, logits, neginf);
-
-        int64_t idx_chosen;
-        double p_chosen;
-
-        if (temperature > 1e8) {
-            // Uniform over valid
-            auto uniform = at::zeros_like(logits);
-            uniform.masked_fill_(mask, 1.0 / static_cast<double>(n_valid));
-            auto sampled = at::multinomial(uniform, 1, false, gen);
-            idx_chosen = sampled.item<int64_t>();
-            p_chosen = uniform.index({idx_chosen}).item<double>();
-        } else if (temperature < 1e-8) {
-            // Argmax among valid
-            const auto& vals = masked_logits; // already has -inf on invalids
-            auto max_idx = std::get<1>(vals.max(-1, false)).item<int64_t>();
-            idx_chosen = max_idx;
-            p_chosen = 1.0;
-        } else {
-            // Standard softmax(logits / T)
-            auto scaled = masked_logits / temperature;
-            // stability: subtract max over valid slice
-            auto m = std::get<0>(scaled.max(-1, false));
-            auto stabilized = scaled - m;
-            auto probs = at::softmax(stabilized, -1);
-            if(!at::isfinite(probs).all().item<bool>())
-                throwf("non-finite probabilities");
-            auto sampled = at::multinomial(probs, 1, false, gen);
-            idx_chosen = sampled.item<int64_t>();
-            p_chosen = probs.index({idx_chosen}).item<double>();
-        }
-
-        return {static_cast<int>(idx_chosen), p_chosen, false};
-    }
-
-    struct TripletSample {
-        int act0;  // over 4 actions
-        int hex1;  // over 165 hexes
-        int hex2;  // over 165 hexes
-        double confidence;  // joint prob
-    };
-
     inline TripletSample sample_triplet(
-        const at::Tensor& act0_logits,   // [1, 4]
-        const at::Tensor& hex1_logits,   // [1, 165]
-        const at::Tensor& hex2_logits,   // [1, 165]
-        const at::Tensor& mask_act0,     // [1, 4] bool
-        const at::Tensor& mask_hex1,     // [1, 4, 165] bool
-        const at::Tensor& mask_hex2,
+        const at::Tensor& act0_logits,   // [1, 4] float
+        const at::Tensor& hex1_logits,   // [1, 165] float
+        const at::Tensor& hex2_logits,   // [1, 165] float
+        const at::Tensor& mask_act0,     // [1, 4] int
+        const at::Tensor& mask_hex1,     // [1, 4, 165] int
+        const at::Tensor& mask_hex2,     // [1, 4, 165, 165] int
         float temperature,
-        const c10::optional<at::Generator>& gen = c10::nullopt
-    ) {   // [1, 4, 165, 165] bool
-
-        // Squeeze batch dimension
-        auto a0_log = act0_logits.squeeze(0);
-        auto h1_log = hex1_logits.squeeze(0);
-        auto h2_log = hex2_logits.squeeze(0);
-
-        auto m_a0 = mask_act0.squeeze(0).toType(at::kBool);
-        auto m_h1 = mask_hex1.squeeze(0).toType(at::kBool); // [4,165]
-        auto m_h2 = mask_hex2.squeeze(0).toType(at::kBool); // [4,165,165]
-
-        // Sample act0
-        auto act0 = sample_masked_logits(a0_log, m_a0, true, temperature, gen);
-
-        // Slice masks for hex1 and hex2 based on act0 and hex1
-        // Sample hex1
-        auto m_h1_for_act0 = m_h1.index({act0.index, at::indexing::Slice()}); // [165]
-        auto hex1 = sample_masked_logits(h1_log, m_h1_for_act0, false, temperature, gen);
-
-        // Sample hex2
-        auto m_h2_for_pair = m_h2.index({act0.index, hex1.index, at::indexing::Slice()}); // [165]
-        auto hex2 = sample_masked_logits(h2_log, m_h2_for_pair, false, temperature, gen);
-
-        // joint
-        // printf("fback: %d     / %d     / %d\n", 0, hex1.fallback, hex2.fallback);
-        // printf("probs: %.3f / %.3f / %.3f\n", act0.prob, hex1.prob, hex2.prob);
-        double confidence = act0.prob * (hex1.fallback ? 1.0 : hex1.prob) * (hex2.fallback ? 1.0 : hex2.prob);
-
-        return {act0.index, hex1.index, hex2.index, confidence};
-    }
-
-
-    std::array<std::vector<int32_t>, 165> buildNBR_unpadded(const std::vector<int64_t>& dst) {
-        // Pass 1: validate and count degrees per node
-        std::array<int, 165> deg{};
-        for (size_t e = 0; e < dst.size(); ++e) {
-            int v = static_cast<int>(dst[e]);
-            if (v < 0 || v >= 165)
-                throwf("dst contains node id out of range: ", v);
-            ++deg[v];
-        }
-
-        std::array<std::vector<int32_t>, 165> nbr{};
-        for (int v = 0; v < 165; ++v) nbr[v].reserve(deg[v]);
-        for (size_t e = 0; e < dst.size(); ++e) {
-            int v = static_cast<int>(dst[e]);
-            nbr[v].push_back(static_cast<int32_t>(e));
-        }
-
-        return nbr;
-    }
-
-    struct IndexContainer {
-        std::array<std::vector<int32_t>, 2> ei;
-        std::vector<float> ea;
-        std::array<std::vector<int32_t>, 165> nbrs;
-    };
-
-    struct BuildOutputs {
-        int size_index = -1;                                // chosen index in all_sizes
-        std::array<int32_t, LT_COUNT> emax{};               // chosen emax per link type
-        std::array<int32_t, LT_COUNT> kmax{};               // chosen kmax per link type
-
-        std::array<std::vector<int32_t>, 2> ei_flat;        // each length sum(emax)
-        std::vector<float> ea_flat;                         // length sum(emax)
-        std::array<std::vector<int32_t>, 165> nbrs_flat;    // each length sum(kmax)
-    };
-
-    // all_sizes: S x LT_COUNT x 2, where [s][l] = {emax, kmax}
-    BuildOutputs build_flattened(
-        const std::array<IndexContainer, LT_COUNT>& containers,
-        const std::vector<std::vector<std::vector<int32_t>>>& all_sizes,
-        int bucket
+        std::mt19937& rng
     ) {
-        BuildOutputs out{};
-
-        // Required per-linktype capacities from data
-        std::array<size_t, LT_COUNT> e_req{};
-        std::array<size_t, LT_COUNT> k_req{};
-        for (int l = 0; l < LT_COUNT; ++l) {
-            e_req[l] = containers[l].ea.size();
-            size_t km = 0;
-            for (int v = 0; v < 165; ++v)
-                km = std::max(km, containers[l].nbrs[v].size());
-            k_req[l] = km;
-        }
-
-        // 1) Find smallest valid size index
-        int chosen = -1;
-        std::array<int32_t, LT_COUNT> emax{}, kmax{};
-        for (int s = 0; s < static_cast<int>(all_sizes.size()); ++s) {
-            const auto& sz = all_sizes[s];
-            if (sz.size() != LT_COUNT) continue;  // skip malformed
-            bool ok = true;
-            for (int l = 0; l < LT_COUNT && ok; ++l) {
-                if (sz[l].size() != 2) { ok = false; break; }
-                int32_t emax_l = sz[l][0];
-                int32_t kmax_l = sz[l][1];
-                if (emax_l < static_cast<int32_t>(e_req[l]) ||
-                    kmax_l < static_cast<int32_t>(k_req[l])) {
-                    ok = false;
-                }
-            }
-            ok = ok && (bucket == -1 || s == bucket);
-            if (ok) {
-                chosen = s;
-                for (int l = 0; l < LT_COUNT; ++l) {
-                    emax[l] = sz[l][0];
-                    kmax[l] = sz[l][1];
-                }
-                break;
-            }
-        }
-
-        // TODO: emit a warning and truncate edges instead (not straightforward)
-        if (chosen < 0) {
-            throw std::runtime_error("No size option in all_sizes satisfies the data requirements.");
-        }
-
-        logAi->debug("Size: %d", chosen);
-        for (int i=0; i<LT_COUNT; ++i)
-            logAi->debug("  %d: [%ld, %ld] -> [%lld, %lld]", i, e_req[i], k_req[i], all_sizes[chosen][i][0], all_sizes[chosen][i][1]);
-
-
-        out.size_index = chosen;
-        out.emax = emax;
-        out.kmax = kmax;
-
-        // Precompute sums
-        const size_t sum_emax = std::accumulate(emax.begin(), emax.end(), 0);
-        const size_t sum_kmax = std::accumulate(kmax.begin(), kmax.end(), 0);
-
-        // 2) Build ei_flat and ea_flat (concat each layer's ei/ea, zero-padded to emax[l])
-        out.ei_flat.at(0).clear();
-        out.ei_flat.at(1).clear();
-        out.ea_flat.clear();
-
-        out.ei_flat.at(0).reserve(sum_emax);
-        out.ei_flat.at(1).reserve(sum_emax);
-        out.ea_flat.reserve(sum_emax);
-        for (int l = 0; l < LT_COUNT; ++l) {
-            const auto& ei = containers[l].ei;
-            const auto& ea = containers[l].ea;
-
-            out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), ei.at(0).begin(), ei.at(0).end());
-            out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), ei.at(1).begin(), ei.at(1).end());
-            out.ea_flat.insert(out.ea_flat.end(), ea.begin(), ea.end());
-
-            size_t need = static_cast<size_t>(emax[l]) - ei.at(0).size();
-            if (need > 0) out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), need, 0);
-
-            need = static_cast<size_t>(emax[l]) - ei.at(1).size();
-            if (need > 0) out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), need, 0);
-
-            need = static_cast<size_t>(emax[l]) - ea.size();
-            if (need > 0) out.ea_flat.insert(out.ea_flat.end(), need, 0.0f);
-        }
-        // Sanity
-        if (out.ei_flat.at(0).size() != sum_emax)
-            throwf("ei_flat.at(0) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(0).size());
-        if (out.ei_flat.at(1).size() != sum_emax)
-            throwf("ei_flat.at(1) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(1).size());
-        if (out.ea_flat.size() != sum_emax)
-            throwf("ea_flat size mismatch: want: %d, have: %zu", sum_emax, out.ea_flat.size());
-
-        // 3) Build nbrs_flat per node: concat layer l, pad to kmax[l] with -1
-        for (int v = 0; v < 165; ++v) {
-            auto& dst = out.nbrs_flat[v];
-            dst.clear();
-            dst.reserve(sum_kmax);
-            for (int l = 0; l < LT_COUNT; ++l) {
-                const auto& src = containers[l].nbrs[v];
-                dst.insert(dst.end(), src.begin(), src.end());
-                const size_t need = static_cast<size_t>(kmax[l]) - src.size();
-                if (need > 0) dst.insert(dst.end(), need, static_cast<int32_t>(-1));
-            }
-            // Optional sanity:
-            if (dst.size() != sum_kmax) {
-                throw std::runtime_error("nbrs_flat row size mismatch.");
-            }
-        }
-
-        return out;
+        // All tensors are contiguous (see toTensor), batch dim is 1
+        return ModelUtil::sample_triplet(
+            act0_logits.data_ptr<float>(),
+            hex1_logits.data_ptr<float>(),
+            hex2_logits.data_ptr<float>(),
+            mask_act0.data_ptr<int32_t>(),
+            mask_hex1.data_ptr<int32_t>(),
+            mask_hex2.data_ptr<int32_t>(),
+            temperature,
+            rng
+        );
     }
 }
 
@@ -352,11 +124,14 @@ at::Tensor TorchModel::prepareDummyInput() {
     return at::tensor({0}, at::kInt);
 }
 
-std::pair<std::vector<at::Tensor>, int> TorchModel::prepareInputsV13(
+std::pair<std::vector<c10::IValue>, int> TorchModel::prepareInputsV13(
     const MMAI::Schema::IState * s,
     const MMAI::Schema::V13::ISupplementaryData* sup,
     int bucket
 ) {
+    auto allocScope = AllocStats::Scope(AllocStats::Stage::INPUTS);
+    auto perfScope = PerfStats::Scope(PerfStats::Stage::INPUTS);
+
     // XXX: if needed, support for other versions may be added via conditionals
     if (version != 13)
         throwf("unsupported version: want: 13, have: %d", version);
@@ -406,14 +181,10 @@ std::pair<std::vector<at::Tensor>, int> TorchModel::prepareInputsV13(
     auto build = build_flattened(containers, all_buckets, bucket);
 
     const auto *state = s->getBattlefieldState();
-    auto estate = std::vector<float>(state->size());
-    std::copy(state->begin(), state->end(), estate.begin());
 
-    int sum_e = build.ei_flat.at(0).size();
-    int sum_k = build.nbrs_flat.at(0).size();
+    int64_t sum_e = build.ei_flat.at(0).size();
+    int64_t sum_k = build.nbrs_flat.at(0).size();
 
-    if (build.ei_flat.at(0).size() != sum_e)
-        throwf("unexpected build.ei_flat.at(0).size(): want: %d, have: %d", sum_e, build.ei_flat.at(0).size());
     if (build.ei_flat.at(1).size() != sum_e)
         throwf("unexpected build.ei_flat.at(1).size(): want: %d, have: %d", sum_e, build.ei_flat.at(1).size());
     if (build.ea_flat.size() != sum_e)
@@ -424,30 +195,55 @@ std::pair<std::vector<at::Tensor>, int> TorchModel::prepareInputsV13(
         }
     }
 
-    auto einds = std::vector<int32_t> {};
-    einds.reserve(2*sum_e);
+    auto values = std::vector<c10::IValue> {};
+    values.reserve(6);
+
+    // Write straight into the tensors' own storage: no intermediate
+    // vectors, no from_blob + clone.
+    if (packed_state) {
+        if (state->size() != Schema::V13::BATTLEFIELD_STATE_SIZE)
+            throwf("unexpected state->size(): want: %d, have: %d", Schema::V13::BATTLEFIELD_STATE_SIZE, state->size());
+
+        auto t_floats = at::empty({Packing::NFLOATS}, at::kFloat);
+        auto t_ternary = at::empty({Packing::NTERNARY}, at::kChar);
+        auto t_bits = at::empty({Packing::NBYTES}, at::kByte);
+        auto ok = Packing::Pack(
+            state->data(),
+            t_floats.data_ptr<float>(),
+            t_ternary.data_ptr<int8_t>(),
+            t_bits.data_ptr<uint8_t>()
+        );
+
+        if (!ok)
+            throwf("state can't be packed losslessly");
+
+        values.emplace_back(std::move(t_floats));
+        values.emplace_back(std::move(t_ternary));
+        values.emplace_back(std::move(t_bits));
+    } else {
+        auto t_state = at::empty({static_cast<int64_t>(state->size())}, at::kFloat);
+        std::copy(state->begin(), state->end(), t_state.data_ptr<float>());
+        values.emplace_back(std::move(t_state));
+    }
+
+    auto t_ei_flat = at::empty({2, sum_e}, at::kInt);
+    auto *ei_ptr = t_ei_flat.data_ptr<int32_t>();
     for (auto &eind : build.ei_flat)
-        einds.insert(einds.end(), eind.begin(), eind.end());
+        ei_ptr = std::copy(eind.begin(), eind.end(), ei_ptr);
+
+    auto t_ea_flat = at::empty({sum_e, 1}, at::kFloat);
+    std::copy(build.ea_flat.begin(), build.ea_flat.end(), t_ea_flat.data_ptr<float>());
 
-    auto nbrs = std::vector<int32_t> {};
-    nbrs.reserve(165*sum_k);
+    auto t_nbrs_flat = at::empty({165, sum_k}, at::kInt);
+    auto *nbrs_ptr = t_nbrs_flat.data_ptr<int32_t>();
     for (auto &nbr : build.nbrs_flat)
-        nbrs.insert(nbrs.end(), nbr.begin(), nbr.end());
-
-    // auto t_state = et_ext::from_blob(estate.data(), {int(estate.size())}, ScalarType::Float);
-    auto t_state = at::from_blob(estate.data(), {int(estate.size())}, at::kFloat);
-    auto t_ei_flat = at::from_blob(einds.data(), {2, sum_e}, at::kInt);
-    auto t_ea_flat = at::from_blob(build.ea_flat.data(), {sum_e, 1}, at::kFloat);
-    auto t_nbrs_flat = at::from_blob(nbrs.data(), {165, sum_k}, at::kInt);
-
-    auto tensors = std::vector<at::Tensor> {
-        t_state.clone(),
-        t_ei_flat.clone(),
-        t_ea_flat.clone(),
-        t_nbrs_flat.clone()
-    };
+        nbrs_ptr = std::copy(nbr.begin(), nbr.end(), nbrs_ptr);
 
-    return {tensors, build.size_index};
+    values.emplace_back(std::move(t_ei_flat));
+    values.emplace_back(std::move(t_ea_flat));
+    values.emplace_back(std::move(t_nbrs_flat));
+
+    return {std::move(values), build.size_index};
 }
 
 at::Tensor TorchModel::toTensor(
@@ -484,12 +280,13 @@ at::Tensor TorchModel::call(
     auto tag = "call: " + method_name;
     auto timer = ScopedTimer(tag);
     std::unique_lock lock(m);
+    c10::InferenceMode guard;
     logAi->debug("%s...", tag);
     auto raw = model->get_method(method_name)(input);
     return toTensor(tag, raw, ndim, numel, st);
 }
 
-TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed)
+TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed, int threads)
 : path(path)
 , temperature(temperature)
 , model(std::make_unique<tj::mobile::Module>(tj::_load_for_mobile(path)))
@@ -497,12 +294,17 @@ TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed)
     version = getScalar<int>("get_version");
     side = Schema::Side(getScalar<int>("get_side"));
 
-    logAi->info("MMAI params: seed=%1%, temperature=%2%, model=%3%", seed, temperature, path);
+    logAi->info("MMAI params: seed=%1%, temperature=%2%, threads=%3%, model=%4%", seed, temperature, threads, path);
 
-    if (seed > 0) {
-        rng = at::make_generator<at::CPUGeneratorImpl>();
-        rng->set_current_seed(seed);
+    if (seed == 0) {
+        seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        logAi->info("Seed is 0, using %1%", seed);
     }
+    rng = std::mt19937(seed);
+
+    // NOTE: this is a process-wide setting (shared by all loaded models)
+    if (threads > 0)
+        at::set_num_threads(threads);
 
     if (version != 13)
         throwf("unsupported model version: want: 13, have: %d", version);
@@ -571,6 +373,44 @@ TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed)
                 }
             }
         }
+
+        flat_action_table = std::move(flat_table);
+    }
+
+    //
+    // packed state (optional)
+    //
+
+    // Models with an unpack layer export get_packed_sizes() and take the
+    // [floats, ternary, bits] planes in place of the float state
+    if (model->find_method("get_packed_sizes")) {
+        auto t_sizes = call("get_packed_sizes", 3, 1, at::kInt);
+        const auto *sizes = t_sizes.data_ptr<int32_t>();
+
+        if (sizes[0] != Packing::NFLOATS || sizes[1] != Packing::NTERNARY || sizes[2] != Packing::NBITS) {
+            throwf("packed state sizes mismatch: want: [%d, %d, %d], have: [%d, %d, %d]",
+                Packing::NFLOATS, Packing::NTERNARY, Packing::NBITS, sizes[0], sizes[1], sizes[2]);
+        }
+
+        packed_state = true;
+        logAi->info("MMAI: model takes packed state");
+    }
+
+    //
+    // per-bucket methods
+    //
+
+    // Resolve the method handles once: get_method() does a linear
+    // string lookup over all exported methods on each call.
+    for (size_t i = 0; i < all_buckets.size(); ++i) {
+        auto idx = std::to_string(i);
+        auto predict = model->find_method("predict_with_logits" + idx);
+        if (!predict)
+            throwf("method not found: predict_with_logits%s", idx);
+        predict_methods.push_back(*predict);
+
+        // get_value is optional (only needed for getValue())
+        value_methods.push_back(model->find_method("get_value" + idx));
     }
 }
 
@@ -607,15 +447,14 @@ int TorchModel::getAction(const MMAI::Schema::IState * s) {
     if (sup->getIsBattleEnded())
         return MMAI::Schema::ACTION_RESET;
 
+    c10::InferenceMode guard;
     auto [inputs, size_idx] = prepareInputsV13(s, sup);
-    auto values = std::vector<c10::IValue>{};
-
-    for (auto &t : inputs) {
-        values.push_back(t);
-    }
-
     auto method_name = "predict_with_logits" + std::to_string(size_idx);
-    auto raw = model->get_method(method_name)(values);
+    auto raw = c10::IValue{};
+    {
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::INFERENCE);
+        raw = predict_methods.at(size_idx)(std::move(inputs));
+    }
 
     if (!raw.isTuple())
         throwf("call: %s: not a tensor", method_name);
@@ -623,34 +462,62 @@ int TorchModel::getAction(const MMAI::Schema::IState * s) {
     auto tuple = raw.toTuple();
     const auto& elems = tuple->elements();
 
-    if (elems.size() != 10)
-        throwf("call: %s: expected 10 outputs in the tuple", method_name);
+    // Models may omit the masks (7 outputs instead of 10), in which case
+    // they are derived from the state's action mask
+    if (elems.size() != 10 && elems.size() != 7)
+        throwf("call: %s: expected 10 or 7 outputs in the tuple", method_name);
+
+    auto with_masks = elems.size() == 10;
+    auto o = with_masks ? 3 : 0;  // offset of the outputs after the masks
 
     auto t_action = toTensor("predict_with_logits: t_action", elems[0], 1, 1, at::kInt);
 
     // deterministic action (useful for debugging)
     int action = t_action.item<int>();
 
-    auto t_act0_logits = toTensor("predict_with_logits: t_act0_logits",  elems[1], 2, 4,         at::kFloat); // [1, 4]
-    auto t_hex1_logits = toTensor("predict_with_logits: t_hex1_logits",  elems[2], 2, 165,       at::kFloat); // [1, 165]
-    auto t_hex2_logits = toTensor("predict_with_logits: t_hex2_logits",  elems[3], 2, 165,       at::kFloat); // [1, 165]
-    auto t_mask_act0   = toTensor("predict_with_logits: mask_act0",      elems[4], 2, 4,         at::kInt);   // [1, 4]
-    auto t_mask_hex1   = toTensor("predict_with_logits: mask_hex1",      elems[5], 3, 4*165,     at::kInt);   // [1, 4, 165]
-    auto t_mask_hex2   = toTensor("predict_with_logits: mask_hex2",      elems[6], 4, 4*165*165, at::kInt);   // [1, 4, 165, 165]
-    auto t_act0        = toTensor("predict_with_logits: t_act0",         elems[7], 1, 1,         at::kInt);   // [1]
-    auto t_hex1        = toTensor("predict_with_logits: t_hex1",         elems[8], 1, 1,         at::kInt);   // [1]
-    auto t_hex2        = toTensor("predict_with_logits: t_hex2",         elems[9], 1, 1,         at::kInt);   // [1]
-
-    auto sample = sample_triplet(
-        t_act0_logits,  // [1, 4]
-        t_hex1_logits,  // [1, 165]
-        t_hex2_logits,  // [1, 165]
-        t_mask_act0,    // [1, 4]
-        t_mask_hex1,    // [1, 4, 165]
-        t_mask_hex2,    // [1, 4, 165, 165]
-        temperature,
-        rng
-    );
+    auto t_act0_logits = toTensor("predict_with_logits: t_act0_logits",  elems[1],   2, 4,   at::kFloat); // [1, 4]
+    auto t_hex1_logits = toTensor("predict_with_logits: t_hex1_logits",  elems[2],   2, 165, at::kFloat); // [1, 165]
+    auto t_hex2_logits = toTensor("predict_with_logits: t_hex2_logits",  elems[3],   2, 165, at::kFloat); // [1, 165]
+    auto t_act0        = toTensor("predict_with_logits: t_act0",         elems[4+o], 1, 1,   at::kInt);   // [1]
+    auto t_hex1        = toTensor("predict_with_logits: t_hex1",         elems[5+o], 1, 1,   at::kInt);   // [1]
+    auto t_hex2        = toTensor("predict_with_logits: t_hex2",         elems[6+o], 1, 1,   at::kInt);   // [1]
+
+    auto sample = TripletSample{};
+
+    if (with_masks) {
+        auto t_mask_act0 = toTensor("predict_with_logits: mask_act0", elems[4], 2, 4,         at::kInt);   // [1, 4]
+        auto t_mask_hex1 = toTensor("predict_with_logits: mask_hex1", elems[5], 3, 4*165,     at::kInt);   // [1, 4, 165]
+        auto t_mask_hex2 = toTensor("predict_with_logits: mask_hex2", elems[6], 4, 4*165*165, at::kInt);   // [1, 4, 165, 165]
+
+        sample = sample_triplet(
+            t_act0_logits,  // [1, 4]
+            t_hex1_logits,  // [1, 165]
+            t_hex2_logits,  // [1, 165]
+            t_mask_act0,    // [1, 4]
+            t_mask_hex1,    // [1, 4, 165]
+            t_mask_hex2,    // [1, 4, 165, 165]
+            temperature,
+            rng
+        );
+    } else {
+        // Only states built by MMAI provide a packed mask
+        const auto *packedmask = sup->getPackedActionMask();
+        auto tmpmask = Schema::V13::PackedActionMask{};
+        if (!packedmask) {
+            tmpmask.assign(*s->getActionMask());
+            packedmask = &tmpmask;
+        }
+
+        sample = ModelUtil::sample_triplet(
+            t_act0_logits.data_ptr<float>(),
+            t_hex1_logits.data_ptr<float>(),
+            t_hex2_logits.data_ptr<float>(),
+            *packedmask,
+            flat_action_table.data(),
+            temperature,
+            rng
+        );
+    }
 
     auto s_action = action_table.at(sample.act0).at(sample.hex1).at(sample.hex2);
 
@@ -677,14 +544,15 @@ double TorchModel::getValue(const MMAI::Schema::IState * s) {
     if (sup->getIsBattleEnded())
         return 0.0;
 
+    c10::InferenceMode guard;
     auto [inputs, size_idx] = prepareInputsV13(s, sup);
-    auto values = std::vector<c10::IValue>{};
-    for (auto &t : inputs) {
-        values.push_back(t);
-    }
+    auto &method = value_methods.at(size_idx);
+
+    if (!method)
+        throwf("getValue: method not found: get_value%d", size_idx);
 
-    auto method = "get_value" + std::to_string(size_idx);
-    auto value = getScalar<float>(method);
+    auto tag = "get_value" + std::to_string(size_idx);
+    auto value = toTensor(tag, (*method)(std::move(inputs)), 1, 1, at::kFloat).item<float>();
     logAi->debug("AI value prediction: %f", value);
 
     return value;
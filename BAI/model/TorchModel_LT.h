@@ -17,6 +17,7 @@
 #pragma once
 
 #include <mutex>
+#include <random>
 
 #include <torch/csrc/jit/mobile/import.h>
 #include <torch/csrc/jit/mobile/module.h>
@@ -30,7 +31,7 @@ namespace tj = torch::jit;
 
 class TorchModel : public MMAI::Schema::IModel {
 public:
-    explicit TorchModel(std::string &path, float temperature, uint64_t seed);
+    explicit TorchModel(std::string &path, float temperature, uint64_t seed, int threads);
 
     Schema::ModelType getType() override;
     std::string getName() override;
@@ -41,20 +42,24 @@ public:
 private:
     std::string path;
     float temperature;
-    c10::optional<at::Generator> rng;
+    std::mt19937 rng;
     std::string name;
     int version;
     Schema::Side side;
     std::mutex m;
     std::vector<std::vector<std::vector<int32_t>>> all_buckets;
     std::vector<std::vector<std::vector<int32_t>>> action_table;
+    std::vector<int32_t> flat_action_table;  // [4, 165, 165]
+
+    // The model takes the packed state planes (see BAI/v13/packed_state.h)
+    bool packed_state = false;
 
     // libtorch does allow 0-arg model methods, but (some) executorch backends
     // do not allow it => 0-arg input methods (such as get_version()) are
     // exported methods with a single dummy argument.
     at::Tensor prepareDummyInput();
 
-    std::pair<std::vector<at::Tensor>, int> prepareInputsV13(
+    std::pair<std::vector<c10::IValue>, int> prepareInputsV13(
         const MMAI::Schema::IState * state,
         const MMAI::Schema::V13::ISupplementaryData* sup,
         int bucket = -1
@@ -83,8 +88,11 @@ private:
         return getScalar<T>(method_name, std::vector<c10::IValue>{prepareDummyInput()});
     };
 
-    c10::InferenceMode guard;
     std::unique_ptr<tj::mobile::Module> model;
+
+    // Resolved once at load time (index = bucket)
+    std::vector<tj::mobile::Method> predict_methods;
+    std::vector<c10::optional<tj::mobile::Method>> value_methods;
 };
 
 } // namespace MMAI::BAI
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <memory>
@@ -16,11 +17,15 @@
 
 #include <onnxruntime_c_api.h>
 #include <onnxruntime_cxx_api.h>
+#include <onnxruntime_session_options_config_keys.h>
 
 #include "StdInc.h"
 #include "vstd/CLoggerBase.h"
 #include "json/JsonNode.h"
 #include "TorchModel_onnx.h"
+#include "BAI/alloc_stats.h"
+#include "BAI/perf_stats.h"
+#include "BAI/model/ModelUtil.h"
 
 #ifdef _WIN32
     #ifndef NOMINMAX
@@ -36,7 +41,11 @@
 
 namespace MMAI::BAI {
 
-constexpr int LT_COUNT = EI(MMAI::Schema::V13::LinkType::_count);
+using ModelUtil::LT_COUNT;
+using ModelUtil::IndexContainer;
+using ModelUtil::BuildOutputs;
+using ModelUtil::buildNBR_unpadded;
+using ModelUtil::build_flattened;
 
 namespace {
     template<class... Args>
@@ -82,12 +91,6 @@ namespace {
         }
     };
 
-    struct IndexContainer {
-        std::array<std::vector<int32_t>, 2> ei;
-        std::vector<float> ea;
-        std::array<std::vector<int32_t>, 165> nbrs;
-    };
-
     struct SampleResult {
         int index;
         double prob;
@@ -239,6 +242,8 @@ namespace {
         double temperature,
         std::mt19937& rng
     ) {
+        auto allocScope = AllocStats::Scope(AllocStats::Stage::SAMPLING);
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::SAMPLING);
         const std::vector<int64_t> s_a0 = shape_of(act0_logits);
         const std::vector<int64_t> s_h1 = shape_of(hex1_logits);
         const std::vector<int64_t> s_h2 = shape_of(hex2_logits);
@@ -297,163 +302,19 @@ namespace {
         return {act0.index, hex1.index, hex2.index, confidence};
     }
 
-
-
-    std::array<std::vector<int32_t>, 165> buildNBR_unpadded(const std::vector<int64_t>& dst) {
-        // Pass 1: validate and count degrees per node
-        std::array<int, 165> deg{};
-        for (size_t e = 0; e < dst.size(); ++e) {
-            int v = static_cast<int>(dst[e]);
-            if (v < 0 || v >= 165)
-                throwf("dst contains node id out of range: ", v);
-            ++deg[v];
-        }
-
-        std::array<std::vector<int32_t>, 165> nbr{};
-        for (int v = 0; v < 165; ++v) nbr[v].reserve(deg[v]);
-        for (size_t e = 0; e < dst.size(); ++e) {
-            int v = static_cast<int>(dst[e]);
-            nbr[v].push_back(static_cast<int32_t>(e));
-        }
-
-        return nbr;
-    }
-
-    struct BuildOutputs {
-        int size_index = -1;                                // chosen index in all_sizes
-        std::array<int32_t, LT_COUNT> emax{};               // chosen emax per link type
-        std::array<int32_t, LT_COUNT> kmax{};               // chosen kmax per link type
-
-        std::array<std::vector<int32_t>, 2> ei_flat;        // each length sum(emax)
-        std::vector<float> ea_flat;                         // length sum(emax)
-        std::array<std::vector<int32_t>, 165> nbrs_flat;    // each length sum(kmax)
-    };
-
-    // all_sizes: S x LT_COUNT x 2, where [s][l] = {emax, kmax}
-    BuildOutputs build_flattened(
-        const std::array<IndexContainer, LT_COUNT>& containers,
-        const std::vector<std::vector<std::vector<int32_t>>>& all_sizes,
-        int bucket
-    ) {
-        BuildOutputs out{};
-
-        // Required per-linktype capacities from data
-        std::array<size_t, LT_COUNT> e_req{};
-        std::array<size_t, LT_COUNT> k_req{};
-        for (int l = 0; l < LT_COUNT; ++l) {
-            e_req[l] = containers[l].ea.size();
-            size_t km = 0;
-            for (int v = 0; v < 165; ++v)
-                km = std::max(km, containers[l].nbrs[v].size());
-            k_req[l] = km;
-        }
-
-        // 1) Find smallest valid size index
-        int chosen = -1;
-        std::array<int32_t, LT_COUNT> emax{}, kmax{};
-        for (int s = 0; s < static_cast<int>(all_sizes.size()); ++s) {
-            const auto& sz = all_sizes[s];
-            if (sz.size() != LT_COUNT) continue;  // skip malformed
-            bool ok = true;
-            for (int l = 0; l < LT_COUNT && ok; ++l) {
-                if (sz[l].size() != 2) { ok = false; break; }
-                int32_t emax_l = sz[l][0];
-                int32_t kmax_l = sz[l][1];
-                if (emax_l < static_cast<int32_t>(e_req[l]) ||
-                    kmax_l < static_cast<int32_t>(k_req[l])) {
-                    ok = false;
-                }
-            }
-            ok = ok && (bucket == -1 || s == bucket);
-            if (ok) {
-                chosen = s;
-                for (int l = 0; l < LT_COUNT; ++l) {
-                    emax[l] = sz[l][0];
-                    kmax[l] = sz[l][1];
-                }
-                break;
-            }
-        }
-
-        // TODO: emit a warning and truncate edges instead (not straightforward)
-        if (chosen < 0) {
-            throw std::runtime_error("No size option in all_sizes satisfies the data requirements.");
-        }
-
-        logAi->debug("Size: %d", chosen);
-        for (int i=0; i<LT_COUNT; ++i)
-            logAi->debug("  %d: [%ld, %ld] -> [%lld, %lld]", i, e_req[i], k_req[i], all_sizes[chosen][i][0], all_sizes[chosen][i][1]);
-
-
-        out.size_index = chosen;
-        out.emax = emax;
-        out.kmax = kmax;
-
-        // Precompute sums
-        const size_t sum_emax = std::accumulate(emax.begin(), emax.end(), 0);
-        const size_t sum_kmax = std::accumulate(kmax.begin(), kmax.end(), 0);
-
-        // 2) Build ei_flat and ea_flat (concat each layer's ei/ea, zero-padded to emax[l])
-        out.ei_flat.at(0).clear();
-        out.ei_flat.at(1).clear();
-        out.ea_flat.clear();
-
-        out.ei_flat.at(0).reserve(sum_emax);
-        out.ei_flat.at(1).reserve(sum_emax);
-        out.ea_flat.reserve(sum_emax);
-        for (int l = 0; l < LT_COUNT; ++l) {
-            const auto& ei = containers[l].ei;
-            const auto& ea = containers[l].ea;
-
-            out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), ei.at(0).begin(), ei.at(0).end());
-            out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), ei.at(1).begin(), ei.at(1).end());
-            out.ea_flat.insert(out.ea_flat.end(), ea.begin(), ea.end());
-
-            size_t need = static_cast<size_t>(emax[l]) - ei.at(0).size();
-            if (need > 0) out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), need, 0);
-
-            need = static_cast<size_t>(emax[l]) - ei.at(1).size();
-            if (need > 0) out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), need, 0);
-
-            need = static_cast<size_t>(emax[l]) - ea.size();
-            if (need > 0) out.ea_flat.insert(out.ea_flat.end(), need, 0.0f);
-        }
-        // Sanity
-        if (out.ei_flat.at(0).size() != sum_emax)
-            throwf("ei_flat.at(0) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(0).size());
-        if (out.ei_flat.at(1).size() != sum_emax)
-            throwf("ei_flat.at(1) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(1).size());
-        if (out.ea_flat.size() != sum_emax)
-            throwf("ea_flat size mismatch: want: %d, have: %zu", sum_emax, out.ea_flat.size());
-
-        // 3) Build nbrs_flat per node: concat layer l, pad to kmax[l] with -1
-        for (int v = 0; v < 165; ++v) {
-            auto& dst = out.nbrs_flat[v];
-            dst.clear();
-            dst.reserve(sum_kmax);
-            for (int l = 0; l < LT_COUNT; ++l) {
-                const auto& src = containers[l].nbrs[v];
-                dst.insert(dst.end(), src.begin(), src.end());
-                const size_t need = static_cast<size_t>(kmax[l]) - src.size();
-                if (need > 0) dst.insert(dst.end(), need, static_cast<int32_t>(-1));
-            }
-            // Optional sanity:
-            if (dst.size() != sum_kmax) {
-                throw std::runtime_error("nbrs_flat row size mismatch.");
-            }
-        }
-
-        return out;
+    // ORT-format models are flatbuffers with the "ORTM" file identifier
+    bool IsOrtFormat(const void* data, size_t size) {
+        return size >= 8 && std::memcmp(static_cast<const char*>(data) + 4, "ORTM", 4) == 0;
     }
 } // namespace {}
 
 
-TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed)
+TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed, int threads)
 : path(path)
 , temperature(temperature)
 , meminfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
 {
-    logAi->info("MMAI params: seed=%1%, temperature=%2%, model=%3%", seed, temperature, path);
+    logAi->info("MMAI params: seed=%1%, temperature=%2%, threads=%3%, model=%4%", seed, temperature, threads, path);
 
     if (seed == 0) {
         seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
@@ -462,10 +323,31 @@ TorchModel::TorchModel(std::string &path, float temperature, uint64_t seed)
     rng = std::mt19937(seed);
 
     auto opts = Ort::SessionOptions();
-    opts.SetIntraOpNumThreads(4);
+    opts.SetIntraOpNumThreads(threads > 0 ? threads : 4);
     opts.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_BASIC);
 
-    model = std::make_unique<Ort::Session>(ort_env(), ToOrtPath(path).c_str(), opts);
+    // Only ORT-format models (.ort) can be used in place: onnxruntime
+    // parses protobuf (.onnx) models and copies the initializers into its
+    // own arenas, so mapping those would not share any pages. ORT-format
+    // models are mapped read-only and the session reads the weights
+    // straight from the mapping, i.e. from the page cache shared between
+    // all VCMI processes using this model.
+    try {
+        mapped = std::make_unique<MappedFile>(path);
+        if (!IsOrtFormat(mapped->data(), mapped->size()))
+            mapped.reset();
+    } catch (const std::exception &e) {
+        logAi->warn("Could not mmap %s (%s), loading it regularly", path, e.what());
+    }
+
+    if (mapped) {
+        opts.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesDirectly, "1");
+        opts.AddConfigEntry(kOrtSessionOptionsConfigUseORTModelBytesForInitializers, "1");
+        model = std::make_unique<Ort::Session>(ort_env(), mapped->data(), mapped->size(), opts);
+    } else {
+        model = std::make_unique<Ort::Session>(ort_env(), ToOrtPath(path).c_str(), opts);
+    }
+
     auto md = model->GetModelMetadata();
 
     {
@@ -635,14 +517,18 @@ int TorchModel::getAction(const MMAI::Schema::IState * s) {
     auto [inputs, size_idx] = prepareInputsV13(s, sup);
 
     // Run
-    auto outputs = model->Run(
-        Ort::RunOptions(),
-        input_names.data(),
-        inputs.data(),
-        inputs.size(),
-        output_names.data(),
-        output_names.size()
-    );
+    auto outputs = std::vector<Ort::Value>{};
+    {
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::INFERENCE);
+        outputs = model->Run(
+            Ort::RunOptions(),
+            input_names.data(),
+            inputs.data(),
+            inputs.size(),
+            output_names.data(),
+            output_names.size()
+        );
+    }
 
     if (outputs.size() != 10)
         throwf("getAction: bad output size: want: 10, have: %d", outputs.size());
@@ -684,6 +570,9 @@ std::pair<std::vector<Ort::Value>, int> TorchModel::prepareInputsV13(
     const MMAI::Schema::V13::ISupplementaryData* sup,
     int bucket
 ) {
+    auto allocScope = AllocStats::Scope(AllocStats::Stage::INPUTS);
+    auto perfScope = PerfStats::Scope(PerfStats::Stage::INPUTS);
+
     // XXX: if needed, support for other versions may be added via conditionals
     if (version != 13)
         throwf("unsupported version: want: 13, have: %d", version);
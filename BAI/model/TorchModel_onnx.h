@@ -18,6 +18,7 @@
 
 #include <onnxruntime_cxx_api.h>   // from the onnx project
 
+#include "BAI/model/MappedFile.h"
 #include "schema/v13/types.h"
 #include "schema/base.h"
 
@@ -30,7 +31,7 @@ inline Ort::Env& ort_env() {
 
 class TorchModel : public MMAI::Schema::IModel {
 public:
-    explicit TorchModel(std::string &path, float temperature, uint64_t seed);
+    explicit TorchModel(std::string &path, float temperature, uint64_t seed, int threads);
 
     Schema::ModelType getType() override;
     std::string getName() override;
@@ -52,6 +53,7 @@ private:
     std::vector<Ort::AllocatedStringPtr> input_name_ptrs;
     std::vector<Ort::AllocatedStringPtr> output_name_ptrs;
 
+    std::unique_ptr<MappedFile> mapped = nullptr;  // ORT-format models only, must outlive `model`
     std::unique_ptr<Ort::Session> model = nullptr;
     Ort::AllocatorWithDefaultOptions allocator;
     Ort::MemoryInfo meminfo;
@@ -0,0 +1,242 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include <atomic>
+#include <cstring>
+
+#ifdef ENABLE_MMAI_PERF_STATS
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "BAI/perf_stats.h"
+#include "common.h"
+
+namespace MMAI::BAI::PerfStats {
+    namespace {
+        constexpr int NSTAGES = EI(Stage::_count);
+
+        constexpr std::array<const char*, NSTAGES> STAGE_NAMES = {
+            "battlefield",
+            "links",
+            "encoding",
+            "inputs",
+            "inference",
+            "sampling"
+        };
+
+        struct Totals {
+            std::atomic<uint64_t> calls {0};
+            std::atomic<uint64_t> nanos {0};
+            std::array<std::atomic<uint64_t>, N_COUNTERS> values {};
+            std::atomic<uint64_t> multiplexed {0};
+            std::atomic<uint64_t> uncounted {0};
+        };
+
+        std::array<Totals, NSTAGES> totals;
+        std::array<std::atomic<bool>, N_COUNTERS> available {};
+        std::atomic<int> openErrno {0};  // first perf_event_open failure
+
+#ifdef ENABLE_MMAI_PERF_STATS
+        constexpr std::array<uint64_t, N_COUNTERS> EVENTS = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,     // last-level cache on most CPUs
+            PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        // The counters of one thread, opened as a single group so they
+        // are scheduled (and read) together.
+        class CounterGroup {
+        public:
+            CounterGroup() {
+                positions.fill(-1);
+                for (int i = 0; i < N_COUNTERS; ++i) {
+                    auto attr = perf_event_attr{};
+                    attr.size = sizeof(attr);
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = EVENTS.at(i);
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                    auto fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+                    if (fd < 0) {
+                        auto expected = 0;
+                        openErrno.compare_exchange_strong(expected, errno);
+                        continue;
+                    }
+
+                    if (leader < 0)
+                        leader = fd;
+                    else
+                        members.at(nmembers) = fd;
+
+                    positions.at(i) = nmembers++;
+                    available.at(i) = true;
+                }
+            }
+
+            ~CounterGroup() {
+                for (int i = 1; i < nmembers; ++i)
+                    close(members.at(i));
+                if (leader >= 0)
+                    close(leader);
+            }
+
+            CounterGroup(const CounterGroup&) = delete;
+            CounterGroup& operator=(const CounterGroup&) = delete;
+
+            // Unavailable counters are left unchanged
+            void read(Reading &out) const {
+                if (leader < 0)
+                    return;
+
+                // Layout: {nr, time_enabled, time_running, values[nr]}
+                auto buf = std::array<uint64_t, N_COUNTERS + 3>{};
+                if (::read(leader, buf.data(), sizeof(buf)) < static_cast<ssize_t>((nmembers + 3) * sizeof(uint64_t)))
+                    return;
+
+                out.enabled = buf.at(1);
+                out.running = buf.at(2);
+                for (int i = 0; i < N_COUNTERS; ++i)
+                    if (positions.at(i) >= 0)
+                        out.values.at(i) = buf.at(positions.at(i) + 3);
+            }
+
+        private:
+            int leader = -1;
+            int nmembers = 0;
+            std::array<int, N_COUNTERS> members = {};     // fds ([0] is unused: the leader)
+            std::array<int, N_COUNTERS> positions = {};   // [Counter] => index in the group, -1 if unavailable
+        };
+
+        // Opened on first use on each thread
+        const CounterGroup& ThreadGroup() {
+            thread_local auto group = CounterGroup();
+            return group;
+        }
+#endif
+    }
+
+    Counters Get(Stage stage) {
+        auto &t = totals.at(EI(stage));
+        auto res = Counters{t.calls.load(), t.nanos.load()};
+        for (int i = 0; i < N_COUNTERS; ++i)
+            res.values.at(i) = t.values.at(i).load();
+        res.multiplexed = t.multiplexed.load();
+        res.uncounted = t.uncounted.load();
+        return res;
+    }
+
+    void Reset() {
+        for (auto &t : totals) {
+            t.calls = 0;
+            t.nanos = 0;
+            for (auto &v : t.values)
+                v = 0;
+            t.multiplexed = 0;
+            t.uncounted = 0;
+        }
+    }
+
+    bool Available(Counter counter) {
+        return available.at(EI(counter));
+    }
+
+    std::string Report() {
+        if (!ENABLED)
+            return "MMAI perf stats: disabled (build with ENABLE_MMAI_PERF_STATS)";
+
+        auto res = std::string("MMAI perf stats (per call):");
+
+        if (auto err = openErrno.load())
+            res += boost::str(boost::format("\n  (some counters are unavailable: %s)") % std::strerror(err));
+
+        // Per counted call (calls with no values would skew the average)
+        auto fmt = [](const Counters &c, Counter counter) {
+            if (!Available(counter) || c.uncounted == c.calls)
+                return std::string("n/a");
+            return boost::str(boost::format("%.0f") % (double(c.values.at(EI(counter))) / std::max<uint64_t>(c.calls - c.uncounted, 1)));
+        };
+
+        for (int i = 0; i < NSTAGES; ++i) {
+            auto c = Get(static_cast<Stage>(i));
+            auto ipc = (Available(Counter::CYCLES) && Available(Counter::INSTRUCTIONS) && c.values.at(EI(Counter::CYCLES)) > 0)
+                ? boost::str(boost::format("%.2f") % (double(c.values.at(EI(Counter::INSTRUCTIONS))) / c.values.at(EI(Counter::CYCLES))))
+                : std::string("n/a");
+
+            res += boost::str(boost::format("\n  %-12s calls=%-6d time=%.1fus cycles=%s instructions=%s ipc=%s llc-misses=%s branch-misses=%s")
+                % STAGE_NAMES.at(i)
+                % c.calls
+                % (c.nanos / 1000.0 / std::max<uint64_t>(c.calls, 1))
+                % fmt(c, Counter::CYCLES)
+                % fmt(c, Counter::INSTRUCTIONS)
+                % ipc
+                % fmt(c, Counter::LLC_MISSES)
+                % fmt(c, Counter::BRANCH_MISSES));
+
+            if (c.multiplexed || c.uncounted)
+                res += boost::str(boost::format(" (multiplexed=%d uncounted=%d)") % c.multiplexed % c.uncounted);
+        }
+
+        return res;
+    }
+
+#ifdef ENABLE_MMAI_PERF_STATS
+    Scope::Scope(Stage stage_) : stage(EI(stage_)) {
+        ThreadGroup().read(start);
+        t0 = std::chrono::steady_clock::now();
+    }
+
+    Scope::~Scope() {
+        auto dt = std::chrono::steady_clock::now() - t0;
+        auto end = start;
+        ThreadGroup().read(end);
+
+        auto &t = totals[stage];
+        t.calls.fetch_add(1, std::memory_order_relaxed);
+        t.nanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count(), std::memory_order_relaxed);
+
+        auto enabled = end.enabled - start.enabled;
+        auto running = end.running - start.running;
+
+        // No counters opened on this thread
+        if (enabled == 0)
+            return;
+
+        if (running == 0) {
+            t.uncounted.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto scale = 1.0;
+        if (running < enabled) {
+            scale = double(enabled) / running;
+            t.multiplexed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        for (int i = 0; i < N_COUNTERS; ++i) {
+            auto v = static_cast<uint64_t>(double(end.values[i] - start.values[i]) * scale);
+            t.values[i].fetch_add(v, std::memory_order_relaxed);
+        }
+    }
+#endif
+}
@@ -0,0 +1,116 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+ * Hardware performance counters per pipeline stage (Linux only, opt-in).
+ *
+ * With ENABLE_MMAI_PERF_STATS, each Scope reads the cycles, instructions,
+ * LLC misses and branch misses of the calling thread (via perf_event_open)
+ * on entry and exit and adds the difference to its stage's totals.
+ * Nested scopes are inclusive, e.g. BATTLEFIELD includes LINKS.
+ *
+ * Counters which can't be opened (e.g. in containers, or with a restrictive
+ * perf_event_paranoid) are reported as unavailable; call counts and wall
+ * time are collected regardless.
+ *
+ * When the PMU has to multiplex the counters with other events, a scope's
+ * values are scaled by the time the group was enabled vs actually running
+ * (as perf-stat does) and the call is reported as multiplexed. If the group
+ * did not run at all during a scope, no values are added for that call.
+ *
+ * Without ENABLE_MMAI_PERF_STATS, Scope is a no-op.
+ */
+namespace MMAI::BAI::PerfStats {
+#ifdef ENABLE_MMAI_PERF_STATS
+    constexpr bool ENABLED = true;
+#else
+    constexpr bool ENABLED = false;
+#endif
+
+    enum class Stage : int {
+        BATTLEFIELD,    // Battlefield::Create
+        LINKS,          // Battlefield::InitAllLinks
+        ENCODING,       // State::onActiveStack, after the battlefield is built
+        INPUTS,         // TorchModel::prepareInputsV13
+        INFERENCE,      // model forward pass
+        SAMPLING,       // action sampling from the model outputs
+        _count
+    };
+
+    enum class Counter : int {
+        CYCLES,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        _count
+    };
+
+    constexpr int N_COUNTERS = static_cast<int>(Counter::_count);
+
+    struct Counters {
+        uint64_t calls = 0;
+        uint64_t nanos = 0;                             // wall time
+        std::array<uint64_t, N_COUNTERS> values = {};   // [Counter]
+        uint64_t multiplexed = 0;                       // calls with scaled (estimated) values
+        uint64_t uncounted = 0;                         // calls with no values (group not running)
+    };
+
+    // Process-wide totals since start (or since the last Reset)
+    Counters Get(Stage stage);
+    void Reset();
+
+    // True if the counter could be opened on any thread so far
+    bool Available(Counter counter);
+
+    // Human-readable per-stage summary (one line per stage)
+    std::string Report();
+
+#ifdef ENABLE_MMAI_PERF_STATS
+    // A read of the calling thread's counter group
+    struct Reading {
+        uint64_t enabled = 0;   // ns the group was enabled
+        uint64_t running = 0;   // ns the group was actually counting
+        std::array<uint64_t, N_COUNTERS> values = {};
+    };
+
+    class Scope {
+    public:
+        explicit Scope(Stage stage_);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const int stage;
+        Reading start;
+        std::chrono::steady_clock::time_point t0;
+    };
+#else
+    class Scope {
+    public:
+        explicit Scope(Stage) {}
+    };
+#endif
+}
@@ -25,9 +25,12 @@
 #include "AI/BattleAI/BattleAI.h"
 #include "AI/StupidAI/StupidAI.h"
 #include "BAI/base.h"
+#include "BAI/episode_writer.h"
 #include "BAI/model/ScriptedModel.h"
 #include "BAI/model/TorchModel.h"
 #include "BAI/router.h"
+#include "BAI/snapshot.h"
+#include "BAI/worker_pool.h"
 
 #include "common.h"
 #include "gameState/CGameState.h"
@@ -51,6 +54,9 @@ namespace MMAI::BAI {
     static auto models = ModelStorage();
     static float temperature = 1.0;
     static uint64_t seed = 0;
+    static int threads = 0;  // 0 = backend default
+    static int spellCutoffMs = 0;  // 0 = never cut off
+    static bool asyncDecisions = false;
     static std::unique_ptr<ScriptedModel> fallbackModel;
     static std::mutex modelmutex;
 
@@ -91,6 +97,78 @@ namespace MMAI::BAI {
             warncfg("seed: not an integer");
         }
 
+        // optional
+        if (!cfg["threads"].isNull()) {
+            if (cfg["threads"].getType() != JsonNode::JsonType::DATA_INTEGER) {
+                warncfg("threads: not an integer");
+            } else if (cfg["threads"].Integer() < 0) {
+                warncfg("threads: value is negative");
+            } else {
+                threads = static_cast<int>(cfg["threads"].Integer());
+            }
+        }
+
+        // optional
+        if (!cfg["spellCutoffMs"].isNull()) {
+            if (cfg["spellCutoffMs"].getType() != JsonNode::JsonType::DATA_INTEGER) {
+                warncfg("spellCutoffMs: not an integer");
+            } else if (cfg["spellCutoffMs"].Integer() < 0) {
+                warncfg("spellCutoffMs: value is negative");
+            } else {
+                spellCutoffMs = static_cast<int>(cfg["spellCutoffMs"].Integer());
+            }
+        }
+
+        // optional
+        if (!cfg["asyncDecisions"].isNull()) {
+            if (cfg["asyncDecisions"].getType() != JsonNode::JsonType::DATA_BOOL) {
+                warncfg("asyncDecisions: not a bool");
+            } else {
+                asyncDecisions = cfg["asyncDecisions"].Bool();
+            }
+        }
+
+        // optional (path to a file for recording model inputs)
+        if (!cfg["snapshotFile"].isNull()) {
+            if (!cfg["snapshotFile"].isString()) {
+                warncfg("snapshotFile: not a string");
+            } else {
+                Snapshot::Recorder::Configure(cfg["snapshotFile"].String());
+            }
+        }
+
+        // optional (directory for writing training episodes)
+        if (!cfg["episodeDir"].isNull()) {
+            auto shardBytes = EpisodeWriter::DEFAULT_SHARD_BYTES;
+
+            if (!cfg["episodeShardMB"].isNull()) {
+                if (cfg["episodeShardMB"].getType() != JsonNode::JsonType::DATA_INTEGER) {
+                    warncfg("episodeShardMB: not an integer");
+                } else if (cfg["episodeShardMB"].Integer() <= 0) {
+                    warncfg("episodeShardMB: value is not positive");
+                } else {
+                    shardBytes = static_cast<size_t>(cfg["episodeShardMB"].Integer()) << 20;
+                }
+            }
+
+            if (!cfg["episodeDir"].isString()) {
+                warncfg("episodeDir: not a string");
+            } else {
+                EpisodeWriter::Configure(cfg["episodeDir"].String(), shardBytes);
+            }
+        }
+
+        // optional (0 or 1 = serial battlefield construction)
+        if (!cfg["battlefieldThreads"].isNull()) {
+            if (cfg["battlefieldThreads"].getType() != JsonNode::JsonType::DATA_INTEGER) {
+                warncfg("battlefieldThreads: not an integer");
+            } else if (cfg["battlefieldThreads"].Integer() < 0) {
+                warncfg("battlefieldThreads: value is negative");
+            } else {
+                WorkerPool::Configure(static_cast<int>(cfg["battlefieldThreads"].Integer()));
+            }
+        }
+
         if (cfg["models"].getType() != JsonNode::JsonType::DATA_STRUCT) {
             warncfg("seed: not a struct");
         } else {
@@ -145,7 +223,7 @@ namespace MMAI::BAI {
                 auto fullpathstr = fullpath.value().string();
 
                 logAi->info("Loading MMAI %s model from %s", key, fullpathstr);
-                it = models.emplace(key, std::make_unique<TorchModel>(fullpathstr, temperature, seed)).first;
+                it = models.emplace(key, std::make_unique<TorchModel>(fullpathstr, temperature, seed, threads)).first;
             } else {
                 logAi->debug("Using previously loaded %s", key);
             }
@@ -187,6 +265,7 @@ namespace MMAI::BAI {
 
     Router::~Router() {
         info("--- destructor ---");
+        worker.reset();  // completes pending calls
         cb->waitTillRealize = wasWaitingForRealize;
     }
 
@@ -198,6 +277,7 @@ namespace MMAI::BAI {
         wasWaitingForRealize = cb->waitTillRealize;
 
         cb->waitTillRealize = false;
+        worker.reset();
         bai.reset();
     }
 
@@ -208,70 +288,93 @@ namespace MMAI::BAI {
 
     /*
      * Delegated methods
+     * In async mode, only activeStack is executed on the worker. All other
+     * calls wait for it to complete and are executed on the calling thread
+     * (they read the battle, which is only consistent during the call).
      */
 
     void Router::actionFinished(const BattleID &bid, const BattleAction &action) {
+        drain();
         bai->actionFinished(bid, action);
     }
 
     void Router::actionStarted(const BattleID &bid, const BattleAction &action) {
+        drain();
         bai->actionStarted(bid, action);
     }
 
     void Router::activeStack(const BattleID &bid, const CStack * astack) {
-        bai->activeStack(bid, astack);
+        // The battle does not change until our action is made, which is the
+        // last thing BAI::activeStack does with it => safe to read off-thread
+        if (worker)
+            worker->post([bai = bai, bid, astack] { bai->activeStack(bid, astack); });
+        else
+            bai->activeStack(bid, astack);
     }
 
     void Router::battleAttack(const BattleID &bid, const BattleAttack *ba) {
+        drain();
         bai->battleAttack(bid, ba);
     }
 
     void Router::battleCatapultAttacked(const BattleID &bid, const CatapultAttack &ca) {
+        drain();
         bai->battleCatapultAttacked(bid, ca);
     }
 
     void Router::battleEnd(const BattleID &bid, const BattleResult *br, QueryID queryID) {
+        drain();
         bai->battleEnd(bid, br, queryID);
     }
 
     void Router::battleGateStateChanged(const BattleID &bid, const EGateState state) {
+        drain();
         bai->battleGateStateChanged(bid, state);
     };
 
     void Router::battleLogMessage(const BattleID &bid, const std::vector<MetaString> &lines) {
+        drain();
         bai->battleLogMessage(bid, lines);
     };
 
     void Router::battleNewRound(const BattleID &bid) {
+        drain();
         bai->battleNewRound(bid);
     }
 
     void Router::battleNewRoundFirst(const BattleID &bid) {
+        drain();
         bai->battleNewRoundFirst(bid);
     }
 
     void Router::battleObstaclesChanged(const BattleID &bid, const std::vector<ObstacleChanges> &obstacles) {
+        drain();
         bai->battleObstaclesChanged(bid, obstacles);
     };
 
     void Router::battleSpellCast(const BattleID &bid, const BattleSpellCast *sc) {
+        drain();
         bai->battleSpellCast(bid, sc);
     }
 
     void Router::battleStackMoved(const BattleID &bid, const CStack * stack, const BattleHexArray & dest, int distance, bool teleport) {
+        drain();
         bai->battleStackMoved(bid, stack, dest, distance, teleport);
     }
 
     void Router::battleStacksAttacked(const BattleID &bid, const std::vector<BattleStackAttacked> &bsa, bool ranged) {
+        drain();
         bai->battleStacksAttacked(bid, bsa, ranged);
     }
 
     void Router::battleStacksEffectsSet(const BattleID &bid, const SetStackEffect &sse) {
+        drain();
         bai->battleStacksEffectsSet(bid, sse);
     }
 
     void Router::battleStart(const BattleID &bid, const CCreatureSet *army1, const CCreatureSet *army2, int3 tile, const CGHeroInstance *hero1, const CGHeroInstance *hero2, BattleSide side, bool replayAllowed) {
         Schema::IModel * model;
+        worker.reset();  // completes calls for the previous battle, if any
         InitModelConfigFromSettings();
         auto modelkey = side == BattleSide::ATTACKER ? "attacker" : "defender";
         model = GetModel(modelkey);
@@ -299,7 +402,9 @@ namespace MMAI::BAI {
             break;
         case Schema::ModelType::TORCH:
             // XXX: must not call initBattleInterface here
-            bai = Base::Create(model, env, cb, autocombatPreferences.enableSpellsUsage);
+            bai = Base::Create(model, env, cb, autocombatPreferences.enableSpellsUsage, spellCutoffMs);
+            if (asyncDecisions)
+                worker = std::make_unique<SerialWorker>();
             break;
 
         default:
@@ -311,14 +416,17 @@ namespace MMAI::BAI {
     }
 
     void Router::battleTriggerEffect(const BattleID &bid, const BattleTriggerEffect &bte) {
+        drain();
         bai->battleTriggerEffect(bid, bte);
     }
 
     void Router::battleUnitsChanged(const BattleID &bid, const std::vector<UnitChanges> &units) {
+        drain();
         bai->battleUnitsChanged(bid, units);
     }
 
     void Router::yourTacticPhase(const BattleID &bid, int distance) {
+        drain();
         bai->yourTacticPhase(bid, distance);
     }
 
@@ -326,6 +434,11 @@ namespace MMAI::BAI {
      * private
      */
 
+    void Router::drain() {
+        if (worker)
+            worker->sync();
+    }
+
     void Router::error(const std::string &text) const { log(ELogLevel::ERROR, text); }
     void Router::warn(const std::string &text) const { log(ELogLevel::WARN, text); }
     void Router::info(const std::string &text) const { log(ELogLevel::INFO, text); }
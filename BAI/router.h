@@ -20,6 +20,7 @@
 #include "battle/CPlayerBattleCallback.h"
 
 #include "BAI/base.h"
+#include "BAI/serial_worker.h"
 
 namespace MMAI::BAI {
     class Router : public CBattleGameInterface {
@@ -69,6 +70,12 @@ namespace MMAI::BAI {
         std::string addrstr = "?";
         std::string colorname = "?";
 
+        // Set if "asyncDecisions" is enabled and `bai` is an MMAI BAI.
+        // activeStack is then executed on this worker and returns without
+        // waiting for the action.
+        std::unique_ptr<SerialWorker> worker;
+        void drain();  // waits for the worker (if any)
+
         void error(const std::string &text) const;
         void warn(const std::string &text) const;
         void info(const std::string &text) const;
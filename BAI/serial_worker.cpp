@@ -0,0 +1,93 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include "BAI/serial_worker.h"
+
+namespace MMAI::BAI {
+    SerialWorker::SerialWorker() : thread([this] { loop(); }) {}
+
+    SerialWorker::~SerialWorker() {
+        {
+            auto lock = std::lock_guard(mutex);
+            stopping = true;
+        }
+
+        cv.notify_all();
+        thread.join();
+    }
+
+    void SerialWorker::post(std::function<void()> task) {
+        {
+            auto lock = std::lock_guard(mutex);
+            rethrowPending();
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    void SerialWorker::sync() {
+        auto lock = std::unique_lock(mutex);
+        idlecv.wait(lock, [this] { return tasks.empty() && !busy; });
+        rethrowPending();
+    }
+
+    void SerialWorker::rethrowPending() {
+        if (pending) {
+            auto e = pending;
+            pending = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    void SerialWorker::loop() {
+        auto lock = std::unique_lock(mutex);
+
+        while (true) {
+            cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+            // Pending tasks are completed even if stopping
+            if (tasks.empty())
+                return;
+
+            auto task = std::move(tasks.front());
+            tasks.pop_front();
+            busy = true;
+            lock.unlock();
+
+            try {
+                task();
+            } catch (std::exception &e) {
+                logAi->error("MMAI: worker task failed: %s", e.what());
+                auto lock2 = std::lock_guard(mutex);
+                if (!pending)
+                    pending = std::current_exception();
+            } catch (...) {
+                logAi->error("MMAI: worker task failed");
+                auto lock2 = std::lock_guard(mutex);
+                if (!pending)
+                    pending = std::current_exception();
+            }
+
+            lock.lock();
+            busy = false;
+            if (tasks.empty())
+                idlecv.notify_all();
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace MMAI::BAI {
+    /*
+     * A single thread executing posted tasks in FIFO order.
+     *
+     * Used by Router to move MMAI's turn processing off VCMI's callback
+     * thread (see Router::activeStack).
+     *
+     * An exception thrown by a task is logged and rethrown from the next
+     * post() or sync() call (i.e. on the posting thread).
+     */
+    class SerialWorker {
+    public:
+        SerialWorker();
+        ~SerialWorker();  // completes all pending tasks
+
+        SerialWorker(const SerialWorker&) = delete;
+        SerialWorker& operator=(const SerialWorker&) = delete;
+
+        void post(std::function<void()> task);
+
+        // Blocks until all tasks posted so far have completed
+        void sync();
+
+    private:
+        void loop();
+        void rethrowPending();  // requires lock
+
+        std::deque<std::function<void()>> tasks;
+        std::exception_ptr pending;
+        std::mutex mutex;
+        std::condition_variable cv;      // signalled on post/stop
+        std::condition_variable idlecv;  // signalled when tasks run out
+        bool busy = false;
+        bool stopping = false;
+        std::thread thread;  // last (started after the other members)
+    };
+}
@@ -0,0 +1,319 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "StdInc.h"
+
+#include "BAI/snapshot.h"
+#include "BAI/v13/packed_state.h"
+#include "common.h"
+
+namespace MMAI::BAI::Snapshot {
+    static std::unique_ptr<Recorder> sharedRecorder;
+    static std::once_flag sharedRecorderFlag;
+
+    namespace {
+        constexpr size_t Align8(size_t n) {
+            return (n + 7) & ~size_t(7);
+        }
+
+        // Sections of a record, as offsets from the record start
+        struct Layout {
+            size_t state;
+            size_t mask;
+            std::array<size_t, LINK_TYPES> links;
+            size_t size;
+
+            explicit Layout(const RecordHeader &h) {
+                state = Align8(sizeof(RecordHeader));
+                mask = (h.flags & RECORD_PACKED_STATE)
+                    ? Align8(state + V13::Packing::PACKED_SIZE)
+                    : Align8(state + h.nstate * sizeof(float));
+                size_t offset = Align8(mask + h.nmask);
+                for (int l = 0; l < LINK_TYPES; ++l) {
+                    links.at(l) = offset;
+                    offset = Align8(offset + h.nlinks[l] * (2*sizeof(int64_t) + sizeof(float)));
+                }
+                size = offset;
+            }
+        };
+
+        template <typename T>
+        void Put(std::vector<char> &buf, size_t offset, const T* data, size_t n) {
+            if (n > 0)
+                std::memcpy(buf.data() + offset, data, n * sizeof(T));
+        }
+    }
+
+    std::vector<char> Serialize(const Schema::IState* s, Schema::Action action) {
+        auto buf = std::vector<char>{};
+        Serialize(s, action, buf);
+        return buf;
+    }
+
+    void Serialize(const Schema::IState* s, Schema::Action action, std::vector<char> &out) {
+        const auto *bfstate = s->getBattlefieldState();
+        const auto *actmask = s->getActionMask();
+
+        // Zeroed incl. padding, which is written as well
+        auto header = RecordHeader{};
+        std::memset(&header, 0, sizeof(header));
+        header.version = s->version();
+        header.action = action;
+        header.nstate = bfstate->size();
+        header.nmask = actmask->size();
+
+        // Links are only available via V13 supplementary data
+        auto links = Schema::V13::AllLinks{};
+        auto any = s->getSupplementaryData();
+        if (any.has_value() && any.type() == typeid(const Schema::V13::ISupplementaryData*)) {
+            const auto *sup = std::any_cast<const Schema::V13::ISupplementaryData*>(any);
+            header.side = EI(sup->getSide());
+            links = sup->getAllLinks();
+        }
+
+        // ILinks getters return copies => fetch each once
+        auto srcs = std::array<std::vector<int64_t>, LINK_TYPES>{};
+        auto dsts = std::array<std::vector<int64_t>, LINK_TYPES>{};
+        auto attrs = std::array<std::vector<float>, LINK_TYPES>{};
+        for (const auto &[type, l] : links) {
+            auto i = EI(type);
+            srcs.at(i) = l->getSrcIndex();
+            dsts.at(i) = l->getDstIndex();
+            attrs.at(i) = l->getAttributes();
+            if (dsts.at(i).size() != srcs.at(i).size() || attrs.at(i).size() != srcs.at(i).size())
+                THROW_FORMAT("Link size mismatch for link type %d", i);
+            header.nlinks[i] = srcs.at(i).size();
+        }
+
+        // Packing verifies its input, so only states produced by a
+        // (correctly configured) V13 encoder end up packed
+        auto base = out.size();
+        auto packable = header.version == 13 && header.nstate == static_cast<uint32_t>(Schema::V13::BATTLEFIELD_STATE_SIZE);
+        header.flags = packable ? RECORD_PACKED_STATE : 0;
+
+        auto layout = Layout(header);
+
+        // Padding between sections must be zeroed (resize does that)
+        out.resize(base + layout.size);
+
+        if (packable && !V13::Packing::Pack(bfstate->data(), out.data() + base + layout.state)) {
+            logAi->warn("Snapshot: state is not packable, storing it unpacked");
+            header.flags = 0;
+            layout = Layout(header);
+            out.resize(base);
+            out.resize(base + layout.size);
+        }
+
+        header.size = layout.size;
+        Put(out, base, &header, 1);
+
+        if (!(header.flags & RECORD_PACKED_STATE))
+            Put(out, base + layout.state, bfstate->data(), bfstate->size());
+
+        for (size_t i = 0; i < actmask->size(); ++i)
+            out.at(base + layout.mask + i) = actmask->at(i);
+
+        for (int l = 0; l < LINK_TYPES; ++l) {
+            auto n = header.nlinks[l];
+            auto offset = base + layout.links.at(l);
+            Put(out, offset, srcs.at(l).data(), n);
+            Put(out, offset + n*sizeof(int64_t), dsts.at(l).data(), n);
+            Put(out, offset + 2*n*sizeof(int64_t), attrs.at(l).data(), n);
+        }
+    }
+
+    //
+    // Recorder
+    //
+
+    // static
+    void Recorder::Configure(const std::string &path) {
+        std::call_once(sharedRecorderFlag, [&path] {
+            if (path.empty())
+                return;
+
+            try {
+                sharedRecorder = std::make_unique<Recorder>(path);
+                logAi->info("MMAI: recording state snapshots to %s", path);
+            } catch (const std::exception &e) {
+                logAi->error("MMAI: snapshot recording disabled: %s", e.what());
+            }
+        });
+    }
+
+    // static
+    Recorder* Recorder::Shared() {
+        return sharedRecorder.get();
+    }
+
+    Recorder::Recorder(const std::string &path) {
+        auto exists = boost::filesystem::exists(path) && boost::filesystem::file_size(path) > 0;
+
+        if (exists) {
+            auto header = FileHeader{};
+            auto in = std::ifstream(path, std::ios::binary);
+            in.read(reinterpret_cast<char*>(&header), sizeof(header));
+            if (!in || header.magic != MAGIC || header.formatVersion != FORMAT_VERSION || header.linkTypes != LINK_TYPES)
+                THROW_FORMAT("Not a compatible snapshot file: %s", path);
+        }
+
+        out.open(path, std::ios::binary | std::ios::app);
+        if (!out)
+            THROW_FORMAT("Failed to open snapshot file: %s", path);
+
+        if (!exists) {
+            auto header = FileHeader{MAGIC, FORMAT_VERSION, LINK_TYPES};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.flush();
+        }
+    }
+
+    Recorder::~Recorder() {
+        // Write tasks don't throw (see record), so neither does sync()
+        writer.sync();
+    }
+
+    void Recorder::record(const Schema::IState* s, Schema::Action action) {
+        if (failed)
+            return;
+
+        auto buf = std::shared_ptr<std::vector<char>>{};
+
+        try {
+            buf = std::make_shared<std::vector<char>>(Serialize(s, action));
+        } catch (const std::exception &e) {
+            fail(e.what());
+            return;
+        }
+
+        auto lock = std::lock_guard(mutex);
+        writer.post([this, buf] {
+            if (failed)
+                return;
+
+            out.write(buf->data(), buf->size());
+            out.flush();
+            if (!out)
+                fail("failed to write snapshot record");
+        });
+    }
+
+    void Recorder::fail(const std::string &reason) {
+        logAi->error("MMAI: snapshot recording disabled: %s", reason);
+        failed = true;
+    }
+
+    void Recorder::flush() {
+        auto lock = std::lock_guard(mutex);
+        writer.sync();
+    }
+
+    //
+    // State
+    //
+
+    State::State(const RecordHeader &header, const char* record)
+    : version_(header.version)
+    , side(static_cast<Schema::Side>(header.side))
+    , action_(header.action)
+    , supdata(*this)
+    {
+        auto layout = Layout(header);
+        const auto *mask = reinterpret_cast<const uint8_t*>(record + layout.mask);
+
+        if (header.flags & RECORD_PACKED_STATE) {
+            bfstate.resize(header.nstate);
+            V13::Packing::Unpack(record + layout.state, bfstate.data());
+        } else {
+            const auto *state = reinterpret_cast<const float*>(record + layout.state);
+            bfstate.assign(state, state + header.nstate);
+        }
+
+        actmask.assign(mask, mask + header.nmask);
+        if (header.nmask == Schema::V13::PackedActionMask::N_ACTIONS)
+            packedmask.assign(actmask);
+
+        for (int l = 0; l < LINK_TYPES; ++l) {
+            auto n = header.nlinks[l];
+            const auto *base = record + layout.links.at(l);
+            links.at(l) = Links(
+                reinterpret_cast<const int64_t*>(base),
+                reinterpret_cast<const int64_t*>(base + n*sizeof(int64_t)),
+                reinterpret_cast<const float*>(base + 2*n*sizeof(int64_t)),
+                n
+            );
+        }
+    }
+
+    const std::any State::getSupplementaryData() const {
+        return static_cast<const Schema::V13::ISupplementaryData*>(&supdata);
+    }
+
+    const Schema::V13::AllLinks State::SupplementaryData::getAllLinks() const {
+        auto res = Schema::V13::AllLinks{};
+        for (int l = 0; l < LINK_TYPES; ++l)
+            res[static_cast<Schema::V13::LinkType>(l)] = const_cast<Links*>(&state.links.at(l));
+        return res;
+    }
+
+    const Schema::V13::PackedActionMask* State::SupplementaryData::getPackedActionMask() const {
+        // Only V13 masks can be packed
+        return state.actmask.size() == Schema::V13::PackedActionMask::N_ACTIONS ? &state.packedmask : nullptr;
+    }
+
+    //
+    // Reader
+    //
+
+    Reader::Reader(const std::string &path) : file(path) {
+        const auto *data = static_cast<const char*>(file.data());
+        auto size = file.size();
+
+        auto header = FileHeader{};
+        if (size < sizeof(header))
+            THROW_FORMAT("Snapshot file too small: %s", path);
+
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != MAGIC || header.formatVersion != FORMAT_VERSION || header.linkTypes != LINK_TYPES)
+            THROW_FORMAT("Not a compatible snapshot file: %s", path);
+
+        size_t offset = sizeof(header);
+        while (offset + sizeof(RecordHeader) <= size) {
+            auto rh = RecordHeader{};
+            std::memcpy(&rh, data + offset, sizeof(rh));
+
+            auto badPacking = (rh.flags & RECORD_PACKED_STATE) && rh.nstate != static_cast<uint32_t>(Schema::V13::BATTLEFIELD_STATE_SIZE);
+            if (rh.size != Layout(rh).size || badPacking)
+                THROW_FORMAT("Corrupted snapshot record at offset %d in %s", offset % path);
+
+            if (offset + rh.size > size)
+                break;
+
+            offsets.push_back(offset);
+            offset += rh.size;
+        }
+
+        if (offset != size)
+            logAi->warn("Ignoring truncated snapshot record at offset %d in %s", offset, path);
+    }
+
+    std::unique_ptr<State> Reader::at(size_t i) const {
+        const auto *record = static_cast<const char*>(file.data()) + offsets.at(i);
+        auto header = RecordHeader{};
+        std::memcpy(&header, record, sizeof(header));
+        return std::make_unique<State>(header, record);
+    }
+}
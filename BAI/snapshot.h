@@ -0,0 +1,214 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#include "BAI/model/MappedFile.h"
+#include "BAI/serial_worker.h"
+#include "schema/base.h"
+#include "schema/v13/types.h"
+
+/*
+ * Binary snapshots of the model inputs (and the chosen action), used for
+ * reproducing decisions and latency issues without running the game.
+ *
+ * File layout (native byte order):
+ *
+ *   FileHeader
+ *   Record
+ *   Record
+ *   ...
+ *
+ * Record layout (all sections start at 8-byte aligned offsets):
+ *
+ *   RecordHeader
+ *   float    state[nstate]     // or V13::Packing::PACKED_SIZE bytes if
+ *                              // flags has RECORD_PACKED_STATE
+ *   uint8_t  mask[nmask]
+ *   for each link type L (in LinkType order):
+ *     int64_t  src[nlinks[L]]
+ *     int64_t  dst[nlinks[L]]
+ *     float    attrs[nlinks[L]]
+ *
+ * Files are append-only: a truncated trailing record (e.g. after a crash)
+ * is ignored by the reader.
+ */
+namespace MMAI::BAI::Snapshot {
+    constexpr std::array<char, 8> MAGIC = {'M', 'M', 'A', 'I', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t FORMAT_VERSION = 2;
+    constexpr int LINK_TYPES = EI(Schema::V13::LinkType::_count);
+
+    // RecordHeader flags
+    constexpr uint32_t RECORD_PACKED_STATE = 1;  // see BAI/v13/packed_state.h
+
+    struct FileHeader {
+        std::array<char, 8> magic;
+        uint32_t formatVersion;
+        uint32_t linkTypes;
+    };
+
+    struct RecordHeader {
+        uint64_t size;          // total record size (incl. this header)
+        int32_t version;        // IState::version()
+        int32_t side;           // Schema::Side
+        int32_t action;         // the action chosen by the model
+        uint32_t nstate;        // BattlefieldState size (unpacked)
+        uint32_t nmask;         // ActionMask size
+        uint32_t flags;         // RECORD_* flags
+        uint32_t nlinks[LINK_TYPES];
+    };
+
+    static_assert(std::is_trivially_copyable_v<FileHeader>);
+    static_assert(std::is_trivially_copyable_v<RecordHeader>);
+    static_assert(sizeof(FileHeader) % 8 == 0);
+
+    // A complete record for the given state and action.
+    // V13 states are stored packed whenever packing is lossless.
+    std::vector<char> Serialize(const Schema::IState* s, Schema::Action action);
+
+    // Same as above, appended to `out` (whose size should be 8-byte aligned)
+    void Serialize(const Schema::IState* s, Schema::Action action, std::vector<char> &out);
+
+    /*
+     * Appends records to a snapshot file.
+     *
+     * Records are serialized on the calling thread and written by a
+     * background thread, so recording does not wait for disk I/O.
+     * Errors are logged and disable recording (they never reach the BAI).
+     */
+    class Recorder {
+    public:
+        // Enables the process-wide recorder (empty path => disabled).
+        // Logs an error and leaves it disabled if `path` can't be used.
+        // Not thread-safe; call before any battle starts.
+        static void Configure(const std::string &path);
+
+        // The process-wide recorder, or nullptr if disabled
+        static Recorder* Shared();
+
+        explicit Recorder(const std::string &path);
+        ~Recorder();  // writes all pending records
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        void record(const Schema::IState* s, Schema::Action action);
+
+        // Blocks until all records so far are written
+        void flush();
+
+    private:
+        void fail(const std::string &reason);
+
+        std::ofstream out;
+        std::mutex mutex;  // orders record() calls from multiple BAIs
+        std::atomic<bool> failed = false;
+        SerialWorker writer;
+    };
+
+    /*
+     * A recorded state, exposed via the same interfaces the models consume.
+     * State (unpacked if needed) and mask are copied; links are read from
+     * the mapped file.
+     */
+    class State : public Schema::IState {
+    public:
+        State(const RecordHeader &header, const char* record);
+
+        State(const State&) = delete;
+        State& operator=(const State&) = delete;
+
+        // impl IState
+        const Schema::ActionMask* getActionMask() const override { return &actmask; }
+        const Schema::AttentionMask* getAttentionMask() const override { return &attnmask; }
+        const Schema::BattlefieldState* getBattlefieldState() const override { return &bfstate; }
+        const std::any getSupplementaryData() const override;
+        int version() const override { return version_; }
+
+        Schema::Action action() const { return action_; }
+
+    private:
+        class Links : public Schema::V13::ILinks {
+        public:
+            Links() = default;
+            Links(const int64_t* src_, const int64_t* dst_, const float* attrs_, size_t n_)
+            : src(src_), dst(dst_), attrs(attrs_), n(n_) {}
+
+            const std::vector<int64_t> getSrcIndex() const override { return {src, src + n}; }
+            const std::vector<int64_t> getDstIndex() const override { return {dst, dst + n}; }
+            const std::vector<float> getAttributes() const override { return {attrs, attrs + n}; }
+
+        private:
+            const int64_t* src = nullptr;
+            const int64_t* dst = nullptr;
+            const float* attrs = nullptr;
+            size_t n = 0;
+        };
+
+        class SupplementaryData : public Schema::V13::ISupplementaryData {
+        public:
+            explicit SupplementaryData(const State &state_) : state(state_) {}
+
+            Type getType() const override { return Type::REGULAR; }
+            Schema::Side getSide() const override { return state.side; }
+            std::string getColor() const override { return ""; }
+            Schema::V13::ErrorCode getErrorCode() const override { return Schema::V13::ErrorCode::OK; }
+            bool getIsBattleEnded() const override { return false; }
+            bool getIsVictorious() const override { return false; }
+            const Schema::V13::IGlobalStats* getGlobalStats() const override { return nullptr; }
+            const Schema::V13::IPlayerStats* getLeftPlayerStats() const override { return nullptr; }
+            const Schema::V13::IPlayerStats* getRightPlayerStats() const override { return nullptr; }
+            const Schema::V13::Stacks getStacks() const override { return {}; }
+            const Schema::V13::Hexes getHexes() const override { return {}; }
+            const Schema::V13::AllLinks getAllLinks() const override;
+            const Schema::V13::AttackLogs getAttackLogs() const override { return {}; }
+            const std::string getAnsiRender() const override { return ""; }
+            const Schema::V13::StateTransitions getStateTransitions() const override { return {}; }
+            const Schema::V13::PackedActionMask* getPackedActionMask() const override;
+
+        private:
+            const State &state;
+        };
+
+        const int version_;
+        const Schema::Side side;
+        const Schema::Action action_;
+        Schema::BattlefieldState bfstate;
+        Schema::ActionMask actmask;
+        Schema::V13::PackedActionMask packedmask;
+        Schema::AttentionMask attnmask;
+        std::array<Links, LINK_TYPES> links;
+        SupplementaryData supdata;
+    };
+
+    // Read-only, memory-mapped view of a snapshot file
+    class Reader {
+    public:
+        explicit Reader(const std::string &path);
+
+        size_t size() const { return offsets.size(); }
+        std::unique_ptr<State> at(size_t i) const;
+
+    private:
+        MappedFile file;
+        std::vector<size_t> offsets;  // record offsets in `file`
+    };
+}
@@ -0,0 +1,60 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include "BAI/transition_pool.h"
+
+namespace MMAI::BAI {
+    TransitionPool::TransitionPool(int actmaskSize_, int bfstateSize_)
+    : actmaskSize(actmaskSize_)
+    , bfstateSize(bfstateSize_)
+    {}
+
+    void TransitionPool::record(
+        Schema::Action action,
+        const Schema::ActionMask &actmask,
+        const Schema::BattlefieldState &bfstate
+    ) {
+        if (used == static_cast<int>(slots.size())) {
+            auto slot = std::make_unique<Slot>();
+            slot->actmask.reserve(actmaskSize);
+            slot->bfstate.reserve(bfstateSize);
+            slots.push_back(std::move(slot));
+        }
+
+        auto &slot = *slots.at(used);
+        slot.action = action;
+
+        // assign() reuses the existing capacity
+        slot.actmask.assign(actmask.begin(), actmask.end());
+        slot.bfstate.assign(bfstate.begin(), bfstate.end());
+        ++used;
+    }
+
+    std::vector<TransitionPool::Transition> TransitionPool::get() const {
+        auto res = std::vector<Transition> {};
+        res.reserve(used);
+
+        for (int i=0; i<used; ++i) {
+            auto &slot = *slots.at(i);
+            res.emplace_back(slot.action, &slot.actmask, &slot.bfstate);
+        }
+
+        return res;
+    }
+}
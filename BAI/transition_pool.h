@@ -0,0 +1,64 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include "schema/base.h"
+
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace MMAI::BAI {
+    /*
+     * Pooled storage for recorded state transitions.
+     *
+     * Each slot holds an action and full-sized action mask / state buffers.
+     * Slots are allocated on first use and kept across clear(), so in steady
+     * state recording a transition is a copy into existing capacity (no heap
+     * allocations, no shared_ptr control blocks).
+     *
+     * Pointers returned by get() remain valid until the next clear().
+     */
+    class TransitionPool {
+    public:
+        using Transition = std::tuple<Schema::Action, Schema::ActionMask*, Schema::BattlefieldState*>;
+
+        TransitionPool(int actmaskSize, int bfstateSize);
+
+        // Non-copyable (get() hands out pointers into the slots)
+        TransitionPool(const TransitionPool&) = delete;
+        TransitionPool& operator=(const TransitionPool&) = delete;
+
+        void record(Schema::Action action, const Schema::ActionMask &actmask, const Schema::BattlefieldState &bfstate);
+        void clear() { used = 0; }
+        int size() const { return used; }
+        std::vector<Transition> get() const;
+
+    private:
+        struct Slot {
+            Schema::Action action;
+            Schema::ActionMask actmask;
+            Schema::BattlefieldState bfstate;
+        };
+
+        const int actmaskSize;
+        const int bfstateSize;
+        std::vector<std::unique_ptr<Slot>> slots;
+        int used = 0;
+    };
+}
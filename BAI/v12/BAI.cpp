@@ -102,6 +102,31 @@ namespace MMAI::BAI::V12 {
         state->onBattleTriggerEffect(bte);
     }
 
+    void BAI::battleObstaclesChanged(const BattleID &bid, const std::vector<ObstacleChanges> &obstacles) {
+        Base::battleObstaclesChanged(bid, obstacles);
+        state->onObstaclesChanged();
+    }
+
+    void BAI::battleGateStateChanged(const BattleID &bid, const EGateState gatestate) {
+        Base::battleGateStateChanged(bid, gatestate);
+        state->onObstaclesChanged();
+    }
+
+    void BAI::battleCatapultAttacked(const BattleID &bid, const CatapultAttack &ca) {
+        Base::battleCatapultAttacked(bid, ca);
+        state->onObstaclesChanged();
+    }
+
+    void BAI::battleUnitsChanged(const BattleID &bid, const std::vector<UnitChanges> &changes) {
+        Base::battleUnitsChanged(bid, changes);
+        state->onBattleUnitsChanged(changes);
+    }
+
+    void BAI::battleSpellCast(const BattleID &bid, const BattleSpellCast *sc) {
+        Base::battleSpellCast(bid, sc);
+        state->onBattleSpellCast(sc);
+    }
+
     void BAI::yourTacticPhase(const BattleID &bid, int distance) {
         Base::yourTacticPhase(bid, distance);
         cb->battleMakeTacticAction(bid, BattleAction::makeEndOFTacticPhase(battle->battleGetTacticsSide()));
@@ -194,8 +219,7 @@ namespace MMAI::BAI::V12 {
 
 
         while(true) {
-            for (int i = 0; i < static_cast<int>(state->transitions.size()); ++i) {
-                auto [a, m, s] = state->transitions.at(i);
+            for (auto [a, m, s] : state->transitions.get()) {
                 logAi->debug("PRE-GET_ACTION[%d]: m.size=" + std::to_string(m->size()) + ", s.size()=" + std::to_string(s->size()));
             }
 
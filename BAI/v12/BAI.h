@@ -43,6 +43,11 @@ namespace MMAI::BAI::V12 {
 
         void battleStacksAttacked(const BattleID &bid, const std::vector<BattleStackAttacked> & bsa, bool ranged) override; //called when stack receives damage (after battleAttack())
         void battleTriggerEffect(const BattleID &bid, const BattleTriggerEffect & bte) override;
+        void battleObstaclesChanged(const BattleID &bid, const std::vector<ObstacleChanges> &obstacles) override;
+        void battleGateStateChanged(const BattleID &bid, const EGateState gatestate) override;
+        void battleCatapultAttacked(const BattleID &bid, const CatapultAttack & ca) override;
+        void battleUnitsChanged(const BattleID &bid, const std::vector<UnitChanges> &changes) override;
+        void battleSpellCast(const BattleID &bid, const BattleSpellCast *sc) override;
         void battleEnd(const BattleID &bid, const BattleResult *br, QueryID queryID) override;
         void battleStart(const BattleID &bid, const CCreatureSet *army1, const CCreatureSet *army2, int3 tile, const CGHeroInstance *hero1, const CGHeroInstance *hero2, BattleSide side, bool replayAllowed) override; //called by engine when battle starts; side=0 - left, side=1 - right
 
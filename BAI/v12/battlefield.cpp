@@ -22,6 +22,7 @@
 
 #include "schema/v12/constants.h"
 #include "schema/v12/types.h"
+#include "BAI/hexgeometry.h"
 #include "BAI/v12/battlefield.h"
 #include "BAI/v12/hex.h"
 #include "common.h"
@@ -30,32 +31,6 @@ namespace MMAI::BAI::V12 {
     using HA = HexAttribute;
     using SA = StackAttribute;
 
-    // A custom hash function must be provided for the buffer
-    struct PairHash {
-        std::size_t operator()(const std::pair<si16, si16>& t) const {
-            auto h0 = std::hash<int>{}(std::get<0>(t));
-            auto h1 = std::hash<int>{}(std::get<1>(t));
-            return h0 ^ (h1 << 1);
-        }
-    };
-
-    // static
-    std::unordered_map<std::pair<si16, si16>, bool, PairHash> InitAdjMap() {
-        auto res = std::unordered_map<std::pair<si16, si16>, bool, PairHash> {};
-
-        for(int id1 = 0; id1 < GameConstants::BFIELD_SIZE; id1++) {
-            auto hex1 = BattleHex(id1);
-            for(auto dir : BattleHex::hexagonalDirections()) {
-                auto hex2 = hex1.cloneInDirection(dir, false);
-                res[{hex1.toInt(), hex2.toInt()}] = true;
-            }
-        }
-
-        return res;
-    }
-
-    static auto ADJMAP = InitAdjMap();
-
     Battlefield::Battlefield(
         const std::shared_ptr<Hexes> hexes_,
         const Stacks stacks_,
@@ -66,17 +41,24 @@ namespace MMAI::BAI::V12 {
 
     // static
     std::shared_ptr<const Battlefield> Battlefield::Create(
+        Arena &arena,
+        ObstacleCache &obstacles,
+        BonusCache &bonuses,
         const CPlayerBattleCallback* battle,
         const CStack* acstack,
         const GlobalStats* ogstats,
         const GlobalStats* gstats,
-        std::map<const CStack*, Stack::Stats> stacksStats,
+        const StacksStats &stacksStats,
         bool isMorale
     ) {
-        auto [stacks, queue] = InitStacks(battle, acstack, ogstats, gstats, stacksStats, isMorale);
-        auto [hexes, astack] = InitHexes(battle, acstack, stacks);
+        auto pool = WorkerPool::Shared();
+        auto [stacks, queue] = InitStacks(arena, pool, bonuses, battle, acstack, ogstats, gstats, stacksStats, isMorale);
+        if (!obstacles.valid)
+            InitObstacles(obstacles, battle);
+
+        auto [hexes, astack] = InitHexes(arena, pool, obstacles, battle, acstack, stacks);
 
-        return std::make_shared<const Battlefield>(hexes, stacks, astack);
+        return arena.make_shared<Battlefield>(hexes, stacks, astack);
     }
 
     // static
@@ -119,68 +101,103 @@ namespace MMAI::BAI::V12 {
         return res;
     }
 
+    // static
+    void Battlefield::InitObstacles(ObstacleCache &obstacles, const CPlayerBattleCallback* battle) {
+        obstacles.masks.fill({});
+        obstacles.gatestate = battle->battleGetGateState();
+
+        for (auto &obstacle : battle->battleGetAllObstacles())
+            for (auto &bh : obstacle->getAffectedTiles())
+                if (bh.isAvailable())
+                    Hex::AddObstacleMask(obstacles.masks.at(Hex::CalcId(bh)), obstacle.get());
+
+        obstacles.valid = true;
+    }
+
     // static
     std::tuple<std::shared_ptr<Hexes>, Stack*> Battlefield::InitHexes(
+        Arena &arena,
+        WorkerPool* pool,
+        const ObstacleCache &obstacles,
         const CPlayerBattleCallback* battle,
         const CStack* acstack,
         const Stacks stacks
     ) {
-        auto res = std::make_shared<Hexes>();
+        auto res = arena.make_shared<Hexes>();
         auto ainfo = battle->getAccessibility();
-        auto hexstacks = std::map<BattleHex, std::shared_ptr<Stack>> {};
-        auto hexobstacles = std::array<std::vector<std::shared_ptr<const CObstacleInstance>>, 165> {};
+        auto hexstacks = HexStacks {};
 
         std::shared_ptr<ActiveStackInfo> astackinfo = nullptr;
         Stack* astack = nullptr;
 
-        for (auto &stack : stacks) {
+        hexstacks.fill(-1);
+
+        for (int i=0; i<stacks.size(); ++i) {
+            auto &stack = stacks.at(i);
             for (auto &bh : stack->cstack->getHexes())
-                if (bh.isAvailable())
-                    hexstacks.insert({bh, stack});
+                if (bh.isAvailable() && hexstacks.at(Hex::CalcId(bh)) < 0)
+                    hexstacks.at(Hex::CalcId(bh)) = i;
 
             // XXX: at battle_end, stack->cstack != acstack even if qpos=0
             if ((stack->attr(SA::QUEUE) & 1) && acstack)
                 astack = stack.get();
         }
 
-        for (auto &obstacle : battle->battleGetAllObstacles())
-            for (auto &bh : obstacle->getAffectedTiles())
-                if (bh.isAvailable())
-                    hexobstacles.at(Hex::CalcId(bh)).push_back(obstacle);;
-
         if (astack) {
             // astack can be nullptr if battle just begun (no turns yet)
-            astackinfo = std::make_shared<ActiveStackInfo>(
+            astackinfo = arena.make_shared<ActiveStackInfo>(
                 astack,
                 battle->battleCanShoot(astack->cstack),
-                std::make_shared<ReachabilityInfo>(astack->rinfo)
+                arena.make_shared<ReachabilityInfo>(astack->rinfo)
             );
         }
 
-        auto gatestate = battle->battleGetGateState();
+        // The arena is not thread-safe => allocate upfront, construct per row
+        auto mem = std::array<void*, BF_SIZE> {};
+        auto built = std::array<Hex*, BF_SIZE> {};
+        for (auto &m : mem)
+            m = arena.allocate(sizeof(Hex), alignof(Hex));
+
+        std::exception_ptr eptr;
+        try {
+            WorkerPool::ParallelFor(pool, BF_YMAX, [&](int y) {
+                for (int x=0; x<BF_XMAX; ++x) {
+                    auto i = y*BF_XMAX + x;
+                    auto bh = BattleHex(x+1, y);
+                    built.at(i) = new (mem.at(i)) Hex(
+                        bh, ainfo.at(bh.toInt()), obstacles.gatestate, obstacles.masks.at(i),
+                        stacks, hexstacks, astackinfo
+                    );
+                }
+            });
+        } catch (...) {
+            eptr = std::current_exception();
+        }
 
-        for (int y=0; y<11; ++y) {
-            for (int x=0; x<15; ++x) {
-                auto i = y*15 + x;
-                auto bh = BattleHex(x+1, y);
-                res->at(y).at(x) = std::make_unique<Hex>(
-                    bh, ainfo.at(bh.toInt()), gatestate, hexobstacles.at(i),
-                    hexstacks, astackinfo
-                );
-            }
+        for (int i=0; i<BF_SIZE; ++i) {
+            if (built.at(i))
+                res->at(i / BF_XMAX).at(i % BF_XMAX) = ArenaUniquePtr<Hex>(built.at(i), ArenaDeleter<Hex>{&arena});
+            else
+                arena.deallocate(mem.at(i), sizeof(Hex));
         }
 
+        if (eptr)
+            std::rethrow_exception(eptr);
+
         // XXX: astack can be nullptr (even if acstack is not) -- see above
         return {res, astack};
     };
 
     // static
     std::tuple<Stacks, Queue> Battlefield::InitStacks(
+        Arena &arena,
+        WorkerPool* pool,
+        BonusCache &bonuses,
         const CPlayerBattleCallback* battle,
         const CStack* astack,
         const GlobalStats* ogstats,
         const GlobalStats* gstats,
-        std::map<const CStack*, Stack::Stats> stacksStats,
+        const StacksStats &stacksStats,
         bool isMorale
     ) {
         auto stacks = Stacks{};
@@ -207,17 +224,25 @@ namespace MMAI::BAI::V12 {
         auto blocking = std::map<const CStack*, bool> {};
         auto blocked = std::map<const CStack*, bool> {};
 
-        auto setBlockedBlocking = [&battle, &blocked, &blocking](const CStack* cstack) {
+        // canShoot() && !FREE_SHOOTING && !SIEGE_WEAPON (cached per unit)
+        auto isBlockable = [&bonuses](const battle::Unit* unit) {
+            if (auto cstack = dynamic_cast<const CStack*>(unit))
+                return Stack::GetBonusInfo(bonuses, cstack).blockable;
+
+            return unit->canShoot() && !unit->hasBonusOfType(BonusType::FREE_SHOOTING) && !unit->hasBonusOfType(BonusType::SIEGE_WEAPON);
+        };
+
+        auto setBlockedBlocking = [&battle, &isBlockable, &blocked, &blocking](const CStack* cstack) {
             blocked.emplace(cstack, false);
             blocking.emplace(cstack, false);
 
             for(const auto * adjacent : battle->battleAdjacentUnits(cstack)) {
                 if (adjacent->unitOwner() == cstack->unitOwner()) continue;
 
-                if (!blocked[cstack] && cstack->canShoot() && !cstack->hasBonusOfType(BonusType::FREE_SHOOTING) && !cstack->hasBonusOfType(BonusType::SIEGE_WEAPON)) {
+                if (!blocked[cstack] && isBlockable(cstack)) {
                     blocked[cstack] = true;
                 }
-                if (!blocking[cstack] && adjacent->canShoot() && !adjacent->hasBonusOfType(BonusType::FREE_SHOOTING) && !adjacent->hasBonusOfType(BonusType::SIEGE_WEAPON)) {
+                if (!blocking[cstack] && isBlockable(adjacent)) {
                     blocking[cstack] = true;
                 }
             }
@@ -245,22 +270,31 @@ namespace MMAI::BAI::V12 {
         if (astack)
             setBlockedBlocking(astack);
 
-        for (auto& cstack : cstacks) {
+        // The most expensive per-unit query, independent for each unit
+        auto rinfos = std::vector<ReachabilityInfo>(cstacks.size());
+        WorkerPool::ParallelFor(pool, static_cast<int>(cstacks.size()), [&battle, &cstacks, &rinfos](int i) {
+            rinfos.at(i) = battle->getReachability(cstacks.at(i));
+        });
+
+        for (int i=0; i<cstacks.size(); ++i) {
+            auto cstack = cstacks.at(i);
             if (cstack != astack)
                 setBlockedBlocking(cstack);
 
             estimateDamage(astack, cstack);
 
-            auto stack = std::make_shared<Stack>(
+            auto stack = arena.make_shared<Stack>(
                 cstack,
                 queue,
                 ogstats,
                 gstats,
-                stacksStats[cstack],  // creates new record if missing
-                battle->getReachability(cstack),
+                // no record yet if the unit was never attacked / attacking
+                cstack->unitId() < stacksStats.size() ? stacksStats.at(cstack->unitId()) : Stack::Stats{},
+                std::move(rinfos.at(i)),
                 blocked[cstack],
                 blocking[cstack],
-                estdmg[cstack]
+                estdmg[cstack],
+                Stack::GetBonusInfo(bonuses, cstack)
             );
 
             stacks.push_back(stack);
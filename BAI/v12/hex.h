@@ -33,6 +33,13 @@ namespace MMAI::BAI::V12 {
     using HexStateMask = std::bitset<EI(HexState::_count)>;
     using HexActionHex = std::array<BattleHex, 12>;
 
+    // Hex ID => index in Battlefield's stacks (-1 if no stack on that hex)
+    using HexStacks = std::array<int, BF_SIZE>;
+
+    // Obstacle-derived state bits of a hex, as seen by each side
+    // (index = BattleSide, i.e. ATTACKER=0, DEFENDER=1)
+    using HexObstacleMask = std::array<HexStateMask, 2>;
+
     struct ActiveStackInfo {
         const Stack* stack;
         const bool canshoot;
@@ -55,14 +62,16 @@ namespace MMAI::BAI::V12 {
     public:
         static int CalcId(const BattleHex &bh);
         static std::pair<int, int> CalcXY(const BattleHex &bh);
-        static HexActionHex NearbyBattleHexes(const BattleHex &bh);
+        static const HexActionHex& NearbyBattleHexes(const BattleHex &bh);
+        static void AddObstacleMask(HexObstacleMask &mask, const CObstacleInstance* obstacle);
 
         Hex(
             const BattleHex &bh,
             const EAccessibility accessibility,
             const EGateState gatestate,
-            const std::vector<std::shared_ptr<const CObstacleInstance>> &obstacles,
-            const std::map<BattleHex, std::shared_ptr<Stack>> &hexstacks,
+            const HexObstacleMask &obstaclemask,
+            const std::vector<std::shared_ptr<Stack>> &stacks,
+            const HexStacks &hexstacks,
             const std::shared_ptr<ActiveStackInfo> &astackinfo
         );
 
@@ -87,13 +96,14 @@ namespace MMAI::BAI::V12 {
 
         void setStateMask(
             const EAccessibility accessibility,
-            const std::vector<std::shared_ptr<const CObstacleInstance>> &obstacles,
+            const HexObstacleMask &obstaclemask,
             BattleSide side
         );
 
         void setActionMask(
             const std::shared_ptr<ActiveStackInfo> &astackinfo,
-            const std::map<BattleHex, std::shared_ptr<Stack>> &hexstacks
+            const std::vector<std::shared_ptr<Stack>> &stacks,
+            const HexStacks &hexstacks
         );
     };
 }
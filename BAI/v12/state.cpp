@@ -90,78 +90,69 @@ namespace MMAI::BAI::V12 {
         return {lv, lh, rv, rh};
     }
 
-    std::tuple<int, int, int, int, int, int, int, int> ProcessAttackLogs(
-        std::vector<std::shared_ptr<AttackLog>> attackLogs,
-        std::map<const CStack*, Stack::Stats> sstats
-    ) {
-        // dmg dealt / dmg received / value killed / value lost
-        int ldd = 0, ldr = 0, lvk = 0, lvl = 0;
-        int rdd = 0, rdr = 0, rvk = 0, rvl = 0;
-
-        for (auto &[cstack, ss] : sstats) {
-            ss.dmgDealtNow = 0;
-            ss.dmgReceivedNow = 0;
-            ss.valueKilledNow = 0;
-            ss.valueLostNow = 0;
-        }
-
-        for (auto &al : attackLogs) {
-            if (al->cattacker) {
-                sstats[al->cattacker].dmgDealtNow += al->dmg;
-                sstats[al->cattacker].dmgDealtTotal += al->dmg;
-                sstats[al->cattacker].valueKilledNow += al->value;
-                sstats[al->cattacker].valueKilledTotal += al->value;
-
-                if (al->cattacker->unitSide() == BattleSide::LEFT_SIDE) {
-                    ldd += al->dmg;
-                    lvk += al->value;
-                } else {
-                    rdd += al->dmg;
-                    rvk += al->value;
-                }
-            }
-
-            ASSERT(al->cdefender, "AttackLog cdefender is nullptr!");
-            sstats[al->cdefender].dmgReceivedNow += al->dmg;
-            sstats[al->cdefender].dmgReceivedTotal += al->dmg;
-            sstats[al->cdefender].valueLostNow += al->value;
-            sstats[al->cdefender].valueLostTotal += al->value;
-
-            if (al->cdefender->unitSide() == BattleSide::LEFT_SIDE) {
-                ldr += al->dmg;
-                lvl += al->value;
+    // NOTE: per-unit stats (sstats) are deliberately not accumulated here.
+    // The stack *_REL and *_ACC_REL0 attributes have always been encoded
+    // as 0 and all models are trained that way: populating them requires
+    // a new schema version.
+    void State::processAttackLog(const AttackLog &al) {
+        auto &at = attackTotals;
+
+        if (al.cattacker) {
+            if (al.cattacker->unitSide() == BattleSide::LEFT_SIDE) {
+                at.ldd += al.dmg;
+                at.lvk += al.value;
             } else {
-                rdr += al->dmg;
-                rvl += al->value;
+                at.rdd += al.dmg;
+                at.rvk += al.value;
             }
         }
 
-        return {ldd, ldr, lvk, lvl, rdd, rdr, rvk, rvl};
+        ASSERT(al.cdefender, "AttackLog cdefender is nullptr!");
+
+        // NOTE: dmg is capped to the defender's available health by VCMI
+        if (al.cdefender->unitSide() == BattleSide::LEFT_SIDE) {
+            at.ldr += al.dmg;
+            at.lvl += al.value;
+            armyTotals.lv -= al.value;
+            armyTotals.lh -= al.dmg;
+        } else {
+            at.rdr += al.dmg;
+            at.rvl += al.value;
+            armyTotals.rv -= al.value;
+            armyTotals.rh -= al.dmg;
+        }
     }
 
 
 
     State::State(const int version__, const std::string colorname_, const CPlayerBattleCallback* battle_)
     : version_(version__)
+    , transitions(Schema::V12::N_ACTIONS, Schema::V12::BATTLEFIELD_STATE_SIZE)
     , colorname(colorname_)
     , battle(battle_)
     , side(battle_->battleGetMySide())
     , nullstack(InitNullStack())
     {
         auto [lv, lh, rv, rh] = CalcGlobalStats(battle);
+        armyTotals = {true, lv, lh, rv, rh};
         gstats = std::make_unique<GlobalStats>(battle->battleGetMySide(), lv+rv, lh+rh);
         lpstats = std::make_unique<PlayerStats>(BattleSide::LEFT_SIDE, lv, lh);
         rpstats = std::make_unique<PlayerStats>(BattleSide::RIGHT_SIDE, rv, rh);
 
-        battlefield = Battlefield::Create(battle_, nullptr, gstats.get(), gstats.get(), sstats, false);
+        battlefield = Battlefield::Create(arenas.next(), obstacles, bonuses, battle_, nullptr, gstats.get(), gstats.get(), sstats, false);
         bfstate.reserve(Schema::V12::BATTLEFIELD_STATE_SIZE);
         actmask.reserve(Schema::V12::N_ACTIONS);
     }
 
     void State::onActiveStack(const CStack* astack, CombatResult result, bool recording, bool fastpath) {
         logAi->debug("onActiveStack: result=%d, recording=%d, fastpath=%d", EI(result), recording, fastpath);
-        auto [lv, lh, rv, rh] = CalcGlobalStats(battle);
-        auto [ldd, ldr, lvk, lvl, rdd, rdr, rvk, rvl] = ProcessAttackLogs(attackLogs, sstats);
+        if (!armyTotals.valid) {
+            auto [lv, lh, rv, rh] = CalcGlobalStats(battle);
+            armyTotals = {true, lv, lh, rv, rh};
+        }
+
+        auto [_, lv, lh, rv, rh] = armyTotals;
+        auto [ldd, ldr, lvk, lvl, rdd, rdr, rvk, rvl] = attackTotals;
         auto ogstats = *gstats;  // a copy of the "old" gstats
 
         (result == CombatResult::NONE)
@@ -177,7 +168,7 @@ namespace MMAI::BAI::V12 {
             persistentAttackLogs.clear();
         } else {
             persistentAttackLogs.insert(persistentAttackLogs.end(), attackLogs.begin(), attackLogs.end());
-            battlefield = Battlefield::Create(battle, astack, &ogstats, gstats.get(), sstats, isMorale);
+            battlefield = Battlefield::Create(arenas.next(), obstacles, bonuses, battle, astack, &ogstats, gstats.get(), sstats, isMorale);
             bfstate.clear();
             actmask.clear();
 
@@ -212,14 +203,14 @@ namespace MMAI::BAI::V12 {
             rpstats.get(),
             battlefield.get(),
             persistentAttackLogs, // store the logs since OUR last turn
-            transitions, // store the states since last turn
+            transitions.get(), // store the states since last turn
             result
         );
 
         if (recording) {
             ASSERT(startedAction >= 0, "unexpected startedAction: " + std::to_string(startedAction));
             // NOTE: this creates a copy of bfstate (which is what we want)
-            transitions.push_back({startedAction, std::make_shared<Schema::ActionMask>(actmask), std::make_shared<Schema::BattlefieldState>(bfstate)});
+            transitions.record(startedAction, actmask, bfstate);
         } else {
             actingStack = astack; // for fastpath, see onActionStarted
             startedAction = -1;
@@ -228,6 +219,7 @@ namespace MMAI::BAI::V12 {
         }
 
         attackLogs.clear(); // accumulate new logs until next turn
+        attackTotals = {};
     }
 
 
@@ -381,7 +373,7 @@ namespace MMAI::BAI::V12 {
     }
 
     void State::onBattleStacksAttacked(const std::vector<BattleStackAttacked> &bsa) {
-        auto stacks = battlefield->stacks;
+        const auto &stacks = battlefield->stacks;
 
         for(auto & elem : bsa) {
             auto cdefender = battle->battleGetStackByID(elem.stackAttacked, false);
@@ -390,7 +382,7 @@ namespace MMAI::BAI::V12 {
             ASSERT(cdefender, "defender cannot be NULL");
             // logAi->debug("Attack: %s -> %s (%d dmg, %d died)", attacker->getName(), defender->getName(), elem.damageAmount, elem.killedAmount);
 
-            auto defender = std::find_if(stacks.begin(), stacks.end(), [&cdefender](std::shared_ptr<Stack> stack) {
+            auto defender = std::find_if(stacks.begin(), stacks.end(), [&cdefender](const std::shared_ptr<Stack> &stack) {
                 return cdefender == stack->cstack;
             });
 
@@ -398,7 +390,7 @@ namespace MMAI::BAI::V12 {
                 logAi->info("defender cstack '%s' not found in stacks. Maybe it was just summoned/resurrected?", cdefender->getDescription());
             }
 
-            auto attacker = std::find_if(stacks.begin(), stacks.end(), [&cattacker](std::shared_ptr<Stack> stack) {
+            auto attacker = std::find_if(stacks.begin(), stacks.end(), [&cattacker](const std::shared_ptr<Stack> &stack) {
                 return cattacker == stack->cstack;
             });
 
@@ -413,13 +405,13 @@ namespace MMAI::BAI::V12 {
             // std::cout << ", value=" << (value);
             // std::cout << "\n";
 
-            attackLogs.push_back(std::make_shared<AttackLog>(
+            auto al = std::make_shared<AttackLog>(
                 // XXX: attacker can be NULL when an effect does dmg (eg. Acid)
                 // XXX: attacker or defender can be NULL if it did not exist
                 //      when `stacks` was built (e.g. during our last turn),
                 //      but the enemy just summonned/resurrected it
-                attacker != stacks.end() ? *attacker : nullptr,
-                defender != stacks.end() ? *defender : nullptr,
+                attacker != stacks.end() ? attacker->get() : nullptr,
+                defender != stacks.end() ? defender->get() : nullptr,
                 cattacker,
                 cdefender,
                 elem.damageAmount,
@@ -427,17 +419,37 @@ namespace MMAI::BAI::V12 {
                 elem.killedAmount,
                 value,
                 1000 * value / bf_valueNow
-            ));
+            );
+
+            processAttackLog(*al);
+            attackLogs.push_back(al);
         }
     }
 
+    void State::onBattleUnitsChanged(const std::vector<UnitChanges> &changes) {
+        // summons, resurrections, heals, etc.
+        armyTotals.valid = false;
+    }
+
+    void State::onBattleSpellCast(const BattleSpellCast *sc) {
+        // e.g. max HP changes (age)
+        armyTotals.valid = false;
+    }
+
     void State::onBattleTriggerEffect(const BattleTriggerEffect &bte) {
+        // e.g. regeneration
+        armyTotals.valid = false;
+
         if (static_cast<BonusType>(bte.effect) != BonusType::MORALE)
             return;
 
         isMorale = true;
     }
 
+    void State::onObstaclesChanged() {
+        obstacles.valid = false;
+    }
+
     void State::onActionFinished(const BattleAction &action) {
         // XXX: assuming action was OK (no server error about failed/fishy action)
     }
@@ -57,13 +57,7 @@ namespace MMAI::BAI::V12 {
     }
 
     const Schema::V12::StateTransitions SupplementaryData::getStateTransitions() const {
-        auto res = Schema::V12::StateTransitions{};
-        res.reserve(transitions.size());
-
-        for (auto [action, actmask, transition] : transitions)
-            res.push_back({action, actmask.get(), transition.get()});
-
-        return res;
+        return transitions;
     }
 
 }
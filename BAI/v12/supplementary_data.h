@@ -42,7 +42,7 @@ namespace MMAI::BAI::V12 {
             const PlayerStats* rpstats_,
             const Battlefield* battlefield_,
             const std::vector<std::shared_ptr<AttackLog>> attackLogs_,
-            std::vector<std::tuple<Schema::Action, std::shared_ptr<Schema::ActionMask>, std::shared_ptr<Schema::BattlefieldState>>> transitions_,
+            Schema::V12::StateTransitions transitions_,
             CombatResult result
         ) : colorname(colorname_),
             side(side_),
@@ -83,7 +83,7 @@ namespace MMAI::BAI::V12 {
         const std::vector<std::shared_ptr<AttackLog>> attackLogs;
         const bool ended = false;
         const bool victory = false;
-        const std::vector<std::tuple<Schema::Action, std::shared_ptr<Schema::ActionMask>, std::shared_ptr<Schema::BattlefieldState>>> transitions;
+        const Schema::V12::StateTransitions transitions; // pointers into State's TransitionPool
 
         // Optionally modified (during activeStack if action was invalid)
         ErrorCode errcode = ErrorCode::OK;
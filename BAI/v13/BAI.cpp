@@ -19,17 +19,23 @@
 #include "battle/BattleStateInfoForRetreat.h"
 #include "battle/CBattleInfoEssentials.h"
 
+#include "BAI/alloc_stats.h"
 #include "BAI/base.h"
+#include "BAI/perf_stats.h"
+#include "BAI/snapshot.h"
 #include "BAI/v13/BAI.h"
 #include "BAI/v13/action.h"
 #include "BAI/v13/hexaction.h"
 #include "BAI/v13/hexactmask.h"
 #include "BAI/v13/render.h"
+#include "BAI/v13/state_copy.h"
 #include "BAI/v13/supplementary_data.h"
+#include "BAI/v13/util.h"
 #include "common.h"
 #include "schema/v13/types.h"
 
 #include "AI/BattleAI/BattleEvaluator.h"
+#include <future>
 #include <optional>
 
 namespace MMAI::BAI::V13 {
@@ -60,6 +66,10 @@ namespace MMAI::BAI::V13 {
         Base::battleStart(bid, army1, army2, tile, hero1, hero2, side, replayAllowed);
         battle = cb->getBattle(bid);
         state = initState(battle.get());
+        noCastFingerprint.reset();
+
+        if (auto *writer = EpisodeWriter::Shared())
+            episode = std::make_unique<EpisodeWriter::Episode>(*writer);
         getActionTotalMs = 0;
         getActionTotalCalls = 0;
     }
@@ -71,8 +81,19 @@ namespace MMAI::BAI::V13 {
         Base::battleEnd(bid, br, queryID);
         state->onBattleEnd(br);
 
+        if (episode) {
+            episode->onEnd(state.get());
+            episode.reset();
+        }
+
         debug("MMAI %s this battle.", (br->winner == battle->battleGetMySide() ? "won" : "lost"));
 
+        if (AllocStats::ENABLED)
+            info(AllocStats::Report());
+
+        if (PerfStats::ENABLED)
+            info(PerfStats::Report());
+
         // Check if battle ended normally or was forced via a RETREAT action
         if (state->action == nullptr) {
             // no previous action means battle ended without giving us a turn (OK)
@@ -115,14 +136,38 @@ namespace MMAI::BAI::V13 {
         state->onBattleTriggerEffect(bte);
     }
 
+    void BAI::battleObstaclesChanged(const BattleID &bid, const std::vector<ObstacleChanges> &obstacles) {
+        Base::battleObstaclesChanged(bid, obstacles);
+        state->onObstaclesChanged();
+    }
+
+    void BAI::battleGateStateChanged(const BattleID &bid, const EGateState gatestate) {
+        Base::battleGateStateChanged(bid, gatestate);
+        state->onObstaclesChanged();
+    }
+
+    void BAI::battleCatapultAttacked(const BattleID &bid, const CatapultAttack &ca) {
+        Base::battleCatapultAttacked(bid, ca);
+        state->onObstaclesChanged();
+    }
+
+    void BAI::battleUnitsChanged(const BattleID &bid, const std::vector<UnitChanges> &changes) {
+        Base::battleUnitsChanged(bid, changes);
+        state->onBattleUnitsChanged(changes);
+    }
+
+    void BAI::battleSpellCast(const BattleID &bid, const BattleSpellCast *sc) {
+        Base::battleSpellCast(bid, sc);
+        state->onBattleSpellCast(sc);
+    }
+
     void BAI::yourTacticPhase(const BattleID &bid, int distance) {
         Base::yourTacticPhase(bid, distance);
         cb->battleMakeTacticAction(bid, BattleAction::makeEndOFTacticPhase(battle->battleGetTacticsSide()));
     }
 
-    bool BAI::maybeCastSpell(const CStack* astack, const BattleID &bid) {
-        // return false;
-        if(!enableSpellsUsage)
+    bool BAI::canCastSpell(uint64_t fingerprint) {
+        if(!enableSpellsUsage || spellsCutOff)
             return false;
 
         const auto *hero = battle->battleGetMyHero();
@@ -133,6 +178,15 @@ namespace MMAI::BAI::V13 {
         if (battle->battleCanCastSpell(hero, spells::Mode::HERO) != ESpellCastProblem::OK)
             return false;
 
+        if (noCastFingerprint == fingerprint) {
+            logAi->debug("Battle state unchanged since last spell evaluation, will not cast");
+            return false;
+        }
+
+        return true;
+    }
+
+    bool BAI::maybeCastSpell(const CStack* astack, const BattleID &bid, uint64_t fingerprint) {
         auto lv = state->lpstats->getAttr(PA::ARMY_VALUE_NOW_ABS);
         auto rv = state->rpstats->getAttr(PA::ARMY_VALUE_NOW_ABS);
         float vratio = static_cast<float>(lv) / rv;
@@ -140,8 +194,24 @@ namespace MMAI::BAI::V13 {
             vratio = 1 / vratio;
 
         logAi->debug("Attempting a BattleAI spellcast");
+        auto t0 = std::chrono::steady_clock::now();
         auto evaluator = BattleEvaluator(env, cb, astack, *cb->getPlayerID(), bid, battle->battleGetMySide(), vratio, 2);
-        return evaluator.attemptCastingSpell(astack);
+        auto res = evaluator.attemptCastingSpell(astack);
+        auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+
+        if (res)
+            noCastFingerprint.reset();
+        else
+            noCastFingerprint = fingerprint;
+
+        // XXX: the evaluator makes the cast itself, so it can't be
+        //      abandoned midway -- the cutoff applies to future turns.
+        if (spellCutoffMs > 0 && dt > spellCutoffMs) {
+            warn("Spell evaluation took %lld ms (cutoff: %d ms), disabling it for this battle", dt, spellCutoffMs);
+            spellsCutOff = true;
+        }
+
+        return res;
     }
 
     std::shared_ptr<BattleAction> BAI::maybeBuildAutoAction(const CStack *astack) {
@@ -249,8 +319,26 @@ namespace MMAI::BAI::V13 {
 
         state->onActiveStack(astack);
 
-        if (maybeCastSpell(astack, bid)) {
+        // Computed once: nothing changes until we make an action
+        auto fingerprint = enableSpellsUsage ? Util::SpellStateFingerprint(battle.get(), astack) : 0;
+        auto castable = canCastSpell(fingerprint);
+
+        // Run the model while BattleAI evaluates spells.
+        // NOTE: callbacks arriving meanwhile (e.g. for the spell cast or the
+        //       battle end) rebuild the state, so the model is given a copy
+        //       owned by the prefetch thread.
+        auto prefetched = std::future<Schema::Action> {};
+        #ifndef ENABLE_ML
+            if (state->battlefield->astack && castable) {
+                auto inputs = std::make_shared<StateCopy>(state.get());
+                prefetched = std::async(std::launch::async, [this, inputs] { return model->getAction(inputs.get()); });
+            }
+        #endif
+
+        if (castable && maybeCastSpell(astack, bid, fingerprint)) {
             info("Making spell cast action.");
+            if (prefetched.valid())
+                prefetched.wait();
             return;
         }
 
@@ -273,19 +361,26 @@ namespace MMAI::BAI::V13 {
         logAi->debug("Not conceding.");
 
         while(true) {
-            for (int i = 0; i < static_cast<int>(state->transitions.size()); ++i) {
-                auto [a, m, s] = state->transitions.at(i);
+            for (auto [a, m, s] : state->transitions.get()) {
                 logAi->debug("PRE-GET_ACTION[%d]: m.size=" + std::to_string(m->size()) + ", s.size()=" + std::to_string(s->size()));
             }
 
             auto t0 = std::chrono::steady_clock::now();
-            auto a = getNonRenderAction();
+            auto a = prefetched.valid() ? prefetched.get() : Schema::ACTION_RENDER_ANSI;
+            if (a == Schema::ACTION_RENDER_ANSI)
+                a = getNonRenderAction();  // renders need the live state
             auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
             getActionTotalMs += dt;
             getActionTotalCalls += 1;
 
             allactions.push_back(a);
 
+            if (auto *recorder = Snapshot::Recorder::Shared())
+                recorder->record(state.get(), a);
+
+            // Only the accepted action is a step (invalid ones are retried)
+            auto record = episode && a != Schema::ACTION_RESET;
+
             if (a == Schema::ACTION_RESET) {
                 // XXX: retreat is always allowed for ML, limited by action mask only
                 debug("Received ACTION_RESET, converting to ACTION_RETREAT in order to reset battle");
@@ -302,6 +397,8 @@ namespace MMAI::BAI::V13 {
                 if (ba) {
                     debug("Action is VALID: " + state->action->name());
                     errcounter = 0;
+                    if (record)
+                        episode->onDecision(state.get(), a);
                     cb->battleMakeUnitAction(bid, *ba);
                     break;
                 } else {
@@ -600,9 +697,10 @@ namespace MMAI::BAI::V13 {
 
     void BAI::actionStarted(const BattleID &bid, const BattleAction &action) {
         Base::actionStarted(bid, action);
-        // XXX: disable transitions (for performance)
-        // TODO: if re-enabling, also re-enable "persistentAttackLogs.insert(...)" in State::onActiveStack
-        // state->onActionStarted(action);
+        // Transitions are recorded only when collecting training data
+        #ifdef ENABLE_ML
+            state->onActionStarted(action);
+        #endif
     };
 
     void BAI::actionFinished(const BattleID &bid, const BattleAction &action) {
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "BAI/base.h"
+#include "BAI/episode_writer.h"
 #include "BAI/v13/action.h"
 #include "BAI/v13/attack_log.h"
 #include "BAI/v13/battlefield.h"
@@ -43,6 +44,11 @@ namespace MMAI::BAI::V13 {
 
         void battleStacksAttacked(const BattleID &bid, const std::vector<BattleStackAttacked> & bsa, bool ranged) override; //called when stack receives damage (after battleAttack())
         void battleTriggerEffect(const BattleID &bid, const BattleTriggerEffect & bte) override;
+        void battleObstaclesChanged(const BattleID &bid, const std::vector<ObstacleChanges> &obstacles) override;
+        void battleGateStateChanged(const BattleID &bid, const EGateState gatestate) override;
+        void battleCatapultAttacked(const BattleID &bid, const CatapultAttack & ca) override;
+        void battleUnitsChanged(const BattleID &bid, const std::vector<UnitChanges> &changes) override;
+        void battleSpellCast(const BattleID &bid, const BattleSpellCast *sc) override;
         void battleEnd(const BattleID &bid, const BattleResult *br, QueryID queryID) override;
         void battleStart(const BattleID &bid, const CCreatureSet *army1, const CCreatureSet *army2, int3 tile, const CGHeroInstance *hero1, const CGHeroInstance *hero2, BattleSide side, bool replayAllowed) override; //called by engine when battle starts; side=0 - left, side=1 - right
 
@@ -52,6 +58,9 @@ namespace MMAI::BAI::V13 {
         virtual std::unique_ptr<State> initState(const CPlayerBattleCallback* battle);
         std::unique_ptr<State> state = nullptr;
 
+        // set if EpisodeWriter is enabled
+        std::unique_ptr<EpisodeWriter::Episode> episode = nullptr;
+
         // consecutive invalid actions counter
         int errcounter = 0;
 
@@ -66,7 +75,16 @@ namespace MMAI::BAI::V13 {
         std::string debugInfo(Action *action, const CStack *astack, BattleHex *nbh); // DEBUG ONLY
         std::shared_ptr<BattleAction> buildBattleAction();
         std::shared_ptr<BattleAction> maybeBuildAutoAction(const CStack * stack);
-        bool maybeCastSpell(const CStack * stack, const BattleID &bid);
+        bool canCastSpell(uint64_t fingerprint);
+        bool maybeCastSpell(const CStack * stack, const BattleID &bid, uint64_t fingerprint);
+
+        // set once a spell evaluation took longer than spellCutoffMs
+        bool spellsCutOff = false;
+
+        // Fingerprint of the battle state when BattleAI last decided
+        // *not* to cast (re-evaluating in the same state is pointless).
+        // Computed once per activeStack() call (see Util::SpellStateFingerprint).
+        std::optional<uint64_t> noCastFingerprint;
 
         std::optional<BattleAction> maybeFleeOrSurrender(const BattleID &bid);
     };
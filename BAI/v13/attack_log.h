@@ -23,8 +23,8 @@ namespace MMAI::BAI::V13 {
     class AttackLog : public Schema::V13::IAttackLog {
     public:
         AttackLog(
-            std::shared_ptr<Stack> attacker_,
-            std::shared_ptr<Stack> defender_,
+            const Stack* attacker_,
+            const Stack* defender_,
             const CStack* cattacker_,
             const CStack* cdefender_,
             int dmg_,
@@ -32,8 +32,8 @@ namespace MMAI::BAI::V13 {
             int units_,
             int value_,
             int valuePermille_
-        ) : attacker(attacker_)
-          , defender(defender_)
+        ) : attacker(attacker_ ? std::make_unique<StackSnapshot>(*attacker_) : nullptr)
+          , defender(defender_ ? std::make_unique<StackSnapshot>(*defender_) : nullptr)
           , cattacker(cattacker_)
           , cdefender(cdefender_)
           , dmg(dmg_)
@@ -44,8 +44,8 @@ namespace MMAI::BAI::V13 {
         {}
 
         // IAttackLog impl
-        Stack* getAttacker() const override { return attacker.get(); }
-        Stack* getDefender() const override { return defender.get(); }
+        StackSnapshot* getAttacker() const override { return attacker.get(); }
+        StackSnapshot* getDefender() const override { return defender.get(); }
         int getDamageDealt() const override { return dmg; }
         int getDamageDealtPermille() const override { return dmgPermille; }
         int getUnitsKilled() const override { return units; }
@@ -62,8 +62,9 @@ namespace MMAI::BAI::V13 {
          * => store only defender slot
          */
 
-        const std::shared_ptr<Stack> attacker;  // XXX: can be nullptr if dmg is not from creature
-        const std::shared_ptr<Stack> defender;
+        // Snapshots (not references) => old Battlefields are not kept alive
+        const std::unique_ptr<StackSnapshot> attacker;  // XXX: can be nullptr if dmg is not from creature
+        const std::unique_ptr<StackSnapshot> defender;
         const CStack* cattacker;
         const CStack* cdefender;
         const int dmg;
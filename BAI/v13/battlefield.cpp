@@ -21,6 +21,9 @@
 
 #include "schema/v13/constants.h"
 #include "schema/v13/types.h"
+#include "BAI/alloc_stats.h"
+#include "BAI/hexgeometry.h"
+#include "BAI/perf_stats.h"
 #include "BAI/v13/battlefield.h"
 #include "BAI/v13/hex.h"
 #include "common.h"
@@ -31,32 +34,6 @@ namespace MMAI::BAI::V13 {
     using SA = StackAttribute;
     using LT = LinkType;
 
-    // A custom hash function must be provided for the adjmap
-    struct PairHash {
-        std::size_t operator()(const std::pair<si16, si16>& t) const {
-            auto h0 = std::hash<int>{}(std::get<0>(t));
-            auto h1 = std::hash<int>{}(std::get<1>(t));
-            return h0 ^ (h1 << 1);
-        }
-    };
-
-    // static
-    std::unordered_map<std::pair<si16, si16>, bool, PairHash> InitAdjMap() {
-        auto res = std::unordered_map<std::pair<si16, si16>, bool, PairHash> {};
-
-        for(int id1 = 0; id1 < GameConstants::BFIELD_SIZE; id1++) {
-            auto hex1 = BattleHex(id1);
-            for(auto dir : BattleHex::hexagonalDirections()) {
-                auto hex2 = hex1.cloneInDirection(dir, false);
-                res[{hex1.toInt(), hex2.toInt()}] = true;
-            }
-        }
-
-        return res;
-    }
-
-    static auto ADJMAP = InitAdjMap();
-
     Battlefield::Battlefield(
         const std::shared_ptr<Hexes> hexes_,
         const Stacks stacks_,
@@ -69,18 +46,44 @@ namespace MMAI::BAI::V13 {
 
     // static
     std::shared_ptr<const Battlefield> Battlefield::Create(
+        Arena &arena,
+        ObstacleCache &obstacles,
+        BonusCache &bonuses,
         const CPlayerBattleCallback* battle,
         const CStack* acstack,
         const GlobalStats* ogstats,
         const GlobalStats* gstats,
-        std::map<const CStack*, Stack::Stats> stacksStats,
-        bool isMorale
+        const StacksStats &stacksStats,
+        bool isMorale,
+        bool withLinks
+    ) {
+        return Create(WorkerPool::Shared(), arena, obstacles, bonuses, battle, acstack, ogstats, gstats, stacksStats, isMorale, withLinks);
+    }
+
+    // static
+    std::shared_ptr<const Battlefield> Battlefield::Create(
+        WorkerPool* pool,
+        Arena &arena,
+        ObstacleCache &obstacles,
+        BonusCache &bonuses,
+        const CPlayerBattleCallback* battle,
+        const CStack* acstack,
+        const GlobalStats* ogstats,
+        const GlobalStats* gstats,
+        const StacksStats &stacksStats,
+        bool isMorale,
+        bool withLinks
     ) {
-        auto [stacks, queue] = InitStacks(battle, acstack, ogstats, gstats, stacksStats, isMorale);
-        auto [hexes, astack] = InitHexes(battle, acstack, stacks);
-        auto links = InitAllLinks(battle, stacks, queue, hexes);
+        auto allocScope = AllocStats::Scope(AllocStats::Stage::BATTLEFIELD);
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::BATTLEFIELD);
+        auto [stacks, queue] = InitStacks(arena, pool, bonuses, battle, acstack, ogstats, gstats, stacksStats, isMorale);
+        if (!obstacles.valid)
+            InitObstacles(obstacles, battle);
+
+        auto [hexes, astack] = InitHexes(arena, pool, obstacles, battle, acstack, stacks);
+        auto links = InitAllLinks(arena, pool, battle, stacks, queue, hexes, withLinks);
 
-        return std::make_shared<const Battlefield>(hexes, stacks, links, astack);
+        return arena.make_shared<Battlefield>(hexes, stacks, links, astack);
     }
 
     // static
@@ -123,68 +126,103 @@ namespace MMAI::BAI::V13 {
         return res;
     }
 
+    // static
+    void Battlefield::InitObstacles(ObstacleCache &obstacles, const CPlayerBattleCallback* battle) {
+        obstacles.masks.fill({});
+        obstacles.gatestate = battle->battleGetGateState();
+
+        for (auto &obstacle : battle->battleGetAllObstacles())
+            for (auto &bh : obstacle->getAffectedTiles())
+                if (bh.isAvailable())
+                    Hex::AddObstacleMask(obstacles.masks.at(Hex::CalcId(bh)), obstacle.get());
+
+        obstacles.valid = true;
+    }
+
     // static
     std::tuple<std::shared_ptr<Hexes>, Stack*> Battlefield::InitHexes(
+        Arena &arena,
+        WorkerPool* pool,
+        const ObstacleCache &obstacles,
         const CPlayerBattleCallback* battle,
         const CStack* acstack,
         const Stacks stacks
     ) {
-        auto res = std::make_shared<Hexes>();
+        auto res = arena.make_shared<Hexes>();
         auto ainfo = battle->getAccessibility();
-        auto hexstacks = std::map<BattleHex, std::shared_ptr<Stack>> {};
-        auto hexobstacles = std::array<std::vector<std::shared_ptr<const CObstacleInstance>>, 165> {};
+        auto hexstacks = HexStacks {};
 
         std::shared_ptr<ActiveStackInfo> astackinfo = nullptr;
         Stack* astack = nullptr;
 
-        for (auto &stack : stacks) {
+        hexstacks.fill(-1);
+
+        for (int i=0; i<stacks.size(); ++i) {
+            auto &stack = stacks.at(i);
             for (auto &bh : stack->cstack->getHexes())
-                if (bh.isAvailable())
-                    hexstacks.insert({bh, stack});
+                if (bh.isAvailable() && hexstacks.at(Hex::CalcId(bh)) < 0)
+                    hexstacks.at(Hex::CalcId(bh)) = i;
 
             // XXX: at battle_end, stack->cstack != acstack even if qpos=0
             if ((stack->attr(SA::QUEUE) & 1) && acstack)
                 astack = stack.get();
         }
 
-        for (auto &obstacle : battle->battleGetAllObstacles())
-            for (auto &bh : obstacle->getAffectedTiles())
-                if (bh.isAvailable())
-                    hexobstacles.at(Hex::CalcId(bh)).push_back(obstacle);;
-
         if (astack) {
             // astack can be nullptr if battle just begun (no turns yet)
-            astackinfo = std::make_shared<ActiveStackInfo>(
+            astackinfo = arena.make_shared<ActiveStackInfo>(
                 astack,
                 battle->battleCanShoot(astack->cstack),
-                std::make_shared<ReachabilityInfo>(astack->rinfo)
+                arena.make_shared<ReachabilityInfo>(astack->rinfo)
             );
         }
 
-        auto gatestate = battle->battleGetGateState();
+        // The arena is not thread-safe => allocate upfront, construct per row
+        auto mem = std::array<void*, BF_SIZE> {};
+        auto built = std::array<Hex*, BF_SIZE> {};
+        for (auto &m : mem)
+            m = arena.allocate(sizeof(Hex), alignof(Hex));
+
+        std::exception_ptr eptr;
+        try {
+            WorkerPool::ParallelFor(pool, BF_YMAX, [&](int y) {
+                for (int x=0; x<BF_XMAX; ++x) {
+                    auto i = y*BF_XMAX + x;
+                    auto bh = BattleHex(x+1, y);
+                    built.at(i) = new (mem.at(i)) Hex(
+                        bh, ainfo.at(bh.toInt()), obstacles.gatestate, obstacles.masks.at(i),
+                        stacks, hexstacks, astackinfo
+                    );
+                }
+            });
+        } catch (...) {
+            eptr = std::current_exception();
+        }
 
-        for (int y=0; y<11; ++y) {
-            for (int x=0; x<15; ++x) {
-                auto i = y*15 + x;
-                auto bh = BattleHex(x+1, y);
-                res->at(y).at(x) = std::make_unique<Hex>(
-                    bh, ainfo.at(bh.toInt()), gatestate, hexobstacles.at(i),
-                    hexstacks, astackinfo
-                );
-            }
+        for (int i=0; i<BF_SIZE; ++i) {
+            if (built.at(i))
+                res->at(i / BF_XMAX).at(i % BF_XMAX) = ArenaUniquePtr<Hex>(built.at(i), ArenaDeleter<Hex>{&arena});
+            else
+                arena.deallocate(mem.at(i), sizeof(Hex));
         }
 
+        if (eptr)
+            std::rethrow_exception(eptr);
+
         // XXX: astack can be nullptr (even if acstack is not) -- see above
         return {res, astack};
     };
 
     // static
     std::tuple<Stacks, Queue> Battlefield::InitStacks(
+        Arena &arena,
+        WorkerPool* pool,
+        BonusCache &bonuses,
         const CPlayerBattleCallback* battle,
         const CStack* astack,
         const GlobalStats* ogstats,
         const GlobalStats* gstats,
-        std::map<const CStack*, Stack::Stats> stacksStats,
+        const StacksStats &stacksStats,
         bool isMorale
     ) {
         auto stacks = Stacks{};
@@ -211,17 +249,25 @@ namespace MMAI::BAI::V13 {
         auto blocking = std::map<const CStack*, bool> {};
         auto blocked = std::map<const CStack*, bool> {};
 
-        auto setBlockedBlocking = [&battle, &blocked, &blocking](const CStack* cstack) {
+        // canShoot() && !FREE_SHOOTING && !SIEGE_WEAPON (cached per unit)
+        auto isBlockable = [&bonuses](const battle::Unit* unit) {
+            if (auto cstack = dynamic_cast<const CStack*>(unit))
+                return Stack::GetBonusInfo(bonuses, cstack).blockable;
+
+            return unit->canShoot() && !unit->hasBonusOfType(BonusType::FREE_SHOOTING) && !unit->hasBonusOfType(BonusType::SIEGE_WEAPON);
+        };
+
+        auto setBlockedBlocking = [&battle, &isBlockable, &blocked, &blocking](const CStack* cstack) {
             blocked.emplace(cstack, false);
             blocking.emplace(cstack, false);
 
             for(const auto * adjacent : battle->battleAdjacentUnits(cstack)) {
                 if (adjacent->unitOwner() == cstack->unitOwner()) continue;
 
-                if (!blocked[cstack] && cstack->canShoot() && !cstack->hasBonusOfType(BonusType::FREE_SHOOTING) && !cstack->hasBonusOfType(BonusType::SIEGE_WEAPON)) {
+                if (!blocked[cstack] && isBlockable(cstack)) {
                     blocked[cstack] = true;
                 }
-                if (!blocking[cstack] && adjacent->canShoot() && !adjacent->hasBonusOfType(BonusType::FREE_SHOOTING) && !adjacent->hasBonusOfType(BonusType::SIEGE_WEAPON)) {
+                if (!blocking[cstack] && isBlockable(adjacent)) {
                     blocking[cstack] = true;
                 }
             }
@@ -249,22 +295,31 @@ namespace MMAI::BAI::V13 {
         if (astack)
             setBlockedBlocking(astack);
 
-        for (auto& cstack : cstacks) {
+        // The most expensive per-unit query, independent for each unit
+        auto rinfos = std::vector<ReachabilityInfo>(cstacks.size());
+        WorkerPool::ParallelFor(pool, static_cast<int>(cstacks.size()), [&battle, &cstacks, &rinfos](int i) {
+            rinfos.at(i) = battle->getReachability(cstacks.at(i));
+        });
+
+        for (int i=0; i<cstacks.size(); ++i) {
+            auto cstack = cstacks.at(i);
             if (cstack != astack)
                 setBlockedBlocking(cstack);
 
             estimateDamage(astack, cstack);
 
-            auto stack = std::make_shared<Stack>(
+            auto stack = arena.make_shared<Stack>(
                 cstack,
                 queue,
                 ogstats,
                 gstats,
-                stacksStats[cstack],  // creates new record if missing
-                battle->getReachability(cstack),
+                // no record yet if the unit was never attacked / attacking
+                cstack->unitId() < stacksStats.size() ? stacksStats.at(cstack->unitId()) : Stack::Stats{},
+                std::move(rinfos.at(i)),
                 blocked[cstack],
                 blocking[cstack],
-                estdmg[cstack]
+                estdmg[cstack],
+                Stack::GetBonusInfo(bonuses, cstack)
             );
 
             stacks.push_back(stack);
@@ -275,23 +330,51 @@ namespace MMAI::BAI::V13 {
 
     // static
     AllLinks Battlefield::InitAllLinks(
+        Arena &arena,
+        WorkerPool* pool,
         const CPlayerBattleCallback* battle,
         const Stacks stacks,
         const Queue &queue,
-        const std::shared_ptr<Hexes> hexes
+        const std::shared_ptr<Hexes> hexes,
+        bool withLinks
     ) {
+        auto perfScope = PerfStats::Scope(PerfStats::Stage::LINKS);
         auto allLinks = AllLinks();
 
         for (auto i=0; i<EI(LT::_count); ++i)
-            allLinks[LT(i)] = std::make_shared<Links>();
-
-        for (auto &srcrow : *hexes) {
-            for (auto &srchex : srcrow) {
-                for (auto &dstrow : *hexes) {
-                    for (auto &dsthex : dstrow) {
-                        LinkTwoHexes(allLinks, battle, stacks, queue, srchex.get(), dsthex.get());
-                    }
-                }
+            allLinks[LT(i)] = arena.make_shared<Links>(arena);
+
+        // The 165x165 pairwise scan dominates Battlefield construction.
+        // Recorded (non-acting) states only need bfstate+actmask.
+        if (!withLinks)
+            return allLinks;
+
+        auto buildRow = [&](int i, LinkRow &row) {
+            auto src = hexes->at(i / BF_XMAX).at(i % BF_XMAX).get();
+            for (auto &dstrow : *hexes)
+                for (auto &dsthex : dstrow)
+                    LinkTwoHexes(row, battle, stacks, queue, src, dsthex.get());
+        };
+
+        // Rows are merged in src order => same links as the serial path
+        auto mergeRow = [&](int i, LinkRow &row) {
+            for (int t=0; t<EI(LT::_count); ++t)
+                for (auto &[dst, attr] : row.at(t))
+                    allLinks[LT(t)]->add(i, dst, attr);
+        };
+
+        if (pool) {
+            auto rows = std::vector<LinkRow>(BF_SIZE);
+            pool->run(BF_SIZE, [&buildRow, &rows](int i) { buildRow(i, rows.at(i)); });
+            for (int i=0; i<BF_SIZE; ++i)
+                mergeRow(i, rows.at(i));
+        } else {
+            auto row = LinkRow {};
+            for (int i=0; i<BF_SIZE; ++i) {
+                for (auto &v : row)
+                    v.clear();
+                buildRow(i, row);
+                mergeRow(i, row);
             }
         }
 
@@ -299,14 +382,14 @@ namespace MMAI::BAI::V13 {
     }
 
     void Battlefield::LinkTwoHexes(
-        AllLinks &allLinks,
+        LinkRow &row,
         const CPlayerBattleCallback* battle,
         const Stacks &stacks,
         const Queue &queue,
         const Hex* src,
         const Hex* dst
     ) {
-        bool neighbour = ADJMAP.count({src->bhex.toInt(), dst->bhex.toInt()}) > 0;
+        bool neighbour = HexGeometry::Adjacent(src->id, dst->id);
 
         bool reachable = false;
         float rangemod = 0;
@@ -364,24 +447,24 @@ namespace MMAI::BAI::V13 {
         //
 
         if (neighbour)
-            allLinks[LT::ADJACENT]->add(src->id, dst->id, 1);
+            row.at(EI(LT::ADJACENT)).emplace_back(dst->id, 1);
 
         if (reachable)
-            allLinks[LT::REACH]->add(src->id, dst->id, 1);
+            row.at(EI(LT::REACH)).emplace_back(dst->id, 1);
 
         if (actsBefore)
-            allLinks[LT::ACTS_BEFORE]->add(src->id, dst->id, std::min<int>(2, actsBefore));
+            row.at(EI(LT::ACTS_BEFORE)).emplace_back(dst->id, std::min<int>(2, actsBefore));
 
         if (rangemod)
-            allLinks[LT::RANGED_MOD]->add(src->id, dst->id, std::min<float>(2, rangemod));
+            row.at(EI(LT::RANGED_MOD)).emplace_back(dst->id, std::min<float>(2, rangemod));
 
         if (rangedDmgFrac)
-            allLinks[LT::RANGED_DMG_REL]->add(src->id, dst->id, std::min<float>(2, rangedDmgFrac));
+            row.at(EI(LT::RANGED_DMG_REL)).emplace_back(dst->id, std::min<float>(2, rangedDmgFrac));
 
         if (meleeDmgFrac)
-            allLinks[LT::MELEE_DMG_REL]->add(src->id, dst->id, std::min<float>(2, meleeDmgFrac));
+            row.at(EI(LT::MELEE_DMG_REL)).emplace_back(dst->id, std::min<float>(2, meleeDmgFrac));
 
         if (retalDmgFrac)
-            allLinks[LT::RETAL_DMG_REL]->add(src->id, dst->id, std::min<float>(2, retalDmgFrac));
+            row.at(EI(LT::RETAL_DMG_REL)).emplace_back(dst->id, std::min<float>(2, retalDmgFrac));
     }
 }
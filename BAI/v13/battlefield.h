@@ -18,6 +18,8 @@
 
 #include "battle/CPlayerBattleCallback.h"
 
+#include "BAI/arena.h"
+#include "BAI/worker_pool.h"
 #include "BAI/v13/hex.h"
 #include "BAI/v13/links.h"
 #include "BAI/v13/stack.h"
@@ -25,20 +27,51 @@
 
 namespace MMAI::BAI::V13 {
     using Stacks = std::vector<std::shared_ptr<Stack>>;
-    using Hexes = std::array<std::array<std::unique_ptr<Hex>, BF_XMAX>, BF_YMAX>;
+    using Hexes = std::array<std::array<ArenaUniquePtr<Hex>, BF_XMAX>, BF_YMAX>;
     using AllLinks = std::map<LinkType, std::shared_ptr<Links>>;
 
     using XY = std::pair<int, int>;
 
+    // Obstacle-derived hex state (moat, firewall, quicksand, etc.) and the
+    // gate state only change on battleObstaclesChanged, battleGateStateChanged
+    // and battleCatapultAttacked => computed once and reused across turns
+    // until invalidated (see State::onObstaclesChanged).
+    struct ObstacleCache {
+        bool valid = false;
+        EGateState gatestate = EGateState::NONE;
+        std::array<HexObstacleMask, BF_SIZE> masks = {};
+    };
+
     class Battlefield {
     public:
+        // The returned object graph is allocated in `arena`
+        // Uses WorkerPool::Shared() if configured (result is the same)
         static std::shared_ptr<const Battlefield> Create(
+            Arena &arena,
+            ObstacleCache &obstacles,
+            BonusCache &bonuses,
             const CPlayerBattleCallback* battle,
             const CStack* astack,
             const GlobalStats* ogstats,
             const GlobalStats* gstats,
-            const std::map<const CStack*, Stack::Stats> stacksStats,
-            bool isMorale
+            const StacksStats &stacksStats,
+            bool isMorale,
+            bool withLinks = true   // false => all link sets are left empty
+        );
+
+        // Same as above, with an explicit pool (nullptr => serial)
+        static std::shared_ptr<const Battlefield> Create(
+            WorkerPool* pool,
+            Arena &arena,
+            ObstacleCache &obstacles,
+            BonusCache &bonuses,
+            const CPlayerBattleCallback* battle,
+            const CStack* astack,
+            const GlobalStats* ogstats,
+            const GlobalStats* gstats,
+            const StacksStats &stacksStats,
+            bool isMorale,
+            bool withLinks = true
         );
 
         Battlefield(
@@ -54,29 +87,43 @@ namespace MMAI::BAI::V13 {
         const Stack* const astack;     // XXX: nullptr on battle start/end, or if army stacks > MAX_STACKS_PER_SIDE
     private:
         static std::tuple<Stacks, Queue> InitStacks(
+            Arena &arena,
+            WorkerPool* pool,
+            BonusCache &bonuses,
             const CPlayerBattleCallback* battle,
             const CStack* astack,
             const GlobalStats* ogstats,
             const GlobalStats* gstats,
-            const std::map<const CStack*, Stack::Stats> stacksStats,
+            const StacksStats &stacksStats,
             bool isMorale
         );
 
+        static void InitObstacles(ObstacleCache &obstacles, const CPlayerBattleCallback* battle);
+
         static std::tuple<std::shared_ptr<Hexes>, Stack*> InitHexes(
+            Arena &arena,
+            WorkerPool* pool,
+            const ObstacleCache &obstacles,
             const CPlayerBattleCallback* battle,
             const CStack* acstack,
             const Stacks stacks
         );
 
+        // Links from a single source hex: (dst, attr) per link type
+        using LinkRow = std::array<std::vector<std::pair<int, float>>, EI(LinkType::_count)>;
+
         static AllLinks InitAllLinks(
+            Arena &arena,
+            WorkerPool* pool,
             const CPlayerBattleCallback* battle,
             const Stacks stacks,
             const Queue &queue,
-            const std::shared_ptr<Hexes>
+            const std::shared_ptr<Hexes>,
+            bool withLinks
         );
 
         static void LinkTwoHexes(
-            AllLinks &allLinks,
+            LinkRow &row,
             const CPlayerBattleCallback* battle,
             const Stacks &stacks,
             const Queue &queue,
@@ -18,6 +18,7 @@
 #include "vcmi/spells/Service.h"
 #include "vcmi/spells/Spell.h"
 
+#include "BAI/hexgeometry.h"
 #include "BAI/v13/hex.h"
 #include "common.h"
 #include "schema/v13/constants.h"
@@ -35,15 +36,20 @@ namespace MMAI::BAI::V13 {
 
     // static
     int Hex::CalcId(const BattleHex &bh) {
-        ASSERT(bh.isAvailable(), "Hex unavailable: " + std::to_string(bh.toInt()));
-        return bh.getX()-1 + bh.getY()*BF_XMAX;
+        auto id = HexGeometry::Id(bh.toInt());
+        ASSERT(id >= 0, "Hex unavailable: " + std::to_string(bh.toInt()));
+        return id;
     }
 
     // static
     std::pair<int, int> Hex::CalcXY(const BattleHex &bh) {
-        return {bh.getX() - 1, bh.getY()};
-    }
+        auto id = HexGeometry::Id(bh.toInt());
+        if (id < 0)
+            return {bh.getX() - 1, bh.getY()};
 
+        const auto &xy = HexGeometry::TABLES.xy[id];
+        return {xy[0], xy[1]};
+    }
 
     //
     // Return bh's neighbouring hexes for setting action mask
@@ -61,7 +67,7 @@ namespace MMAI::BAI::V13 {
     // the respective AMOVE_* HexAction w.r.t. "X" (see hexaction.h)
     //
     // static
-    HexActionHex Hex::NearbyBattleHexes(const BattleHex &bh) {
+    const HexActionHex& Hex::NearbyBattleHexes(const BattleHex &bh) {
         static_assert(EI(HexAction::AMOVE_TR) == 0);
         static_assert(EI(HexAction::AMOVE_R) == 1);
         static_assert(EI(HexAction::AMOVE_BR) == 2);
@@ -75,44 +81,47 @@ namespace MMAI::BAI::V13 {
         static_assert(EI(HexAction::AMOVE_2L) == 10);
         static_assert(EI(HexAction::AMOVE_2TL) == 11);
 
-        auto nbhR = bh.cloneInDirection(BattleHex::EDir::RIGHT, false);
-        auto nbhL = bh.cloneInDirection(BattleHex::EDir::LEFT, false);
-
-        return HexActionHex{
-            // The 6 basic directions
-            bh.cloneInDirection(BattleHex::EDir::TOP_RIGHT, false),
-            nbhR,
-            bh.cloneInDirection(BattleHex::EDir::BOTTOM_RIGHT, false),
-            bh.cloneInDirection(BattleHex::EDir::BOTTOM_LEFT, false),
-            nbhL,
-            bh.cloneInDirection(BattleHex::EDir::TOP_LEFT, false),
-
-            // Extended directions for R-side wide creatures
-            nbhR.cloneInDirection(BattleHex::EDir::TOP_RIGHT, false),
-            nbhR.cloneInDirection(BattleHex::EDir::RIGHT, false),
-            nbhR.cloneInDirection(BattleHex::EDir::BOTTOM_RIGHT, false),
-
-            // Extended directions for L-side wide creatures
-            nbhL.cloneInDirection(BattleHex::EDir::BOTTOM_LEFT, false),
-            nbhL.cloneInDirection(BattleHex::EDir::LEFT, false),
-            nbhL.cloneInDirection(BattleHex::EDir::TOP_LEFT, false)
-        };
+        static_assert(HexGeometry::N_NEARBY == std::tuple_size<HexActionHex>::value);
+
+        // Built once from the compile-time table (BattleHex itself is not
+        // a literal type in all VCMI versions)
+        static const auto table = [] {
+            auto res = std::array<HexActionHex, BF_SIZE> {};
+            for (int id=0; id<BF_SIZE; ++id)
+                for (int i=0; i<HexGeometry::N_NEARBY; ++i)
+                    res.at(id).at(i) = BattleHex(HexGeometry::TABLES.nearby[id][i]);
+            return res;
+        }();
+
+        return table[CalcId(bh)];
     }
 
+    // Stack attributes are laid out contiguously at the end of the hex
+    // attributes (see also the per-attribute static_asserts in state.cpp)
+    static_assert(EI(A::STACK_SIDE) == STACK_ATTR_OFFSET + EI(SA::SIDE));
+    static_assert(EI(SA::SIDE) == 0);
+    static_assert(STACK_ATTR_OFFSET + EI(SA::_count) == EI(A::_count));
+
     Hex::Hex(
         const BattleHex &bhex_,
         const EAccessibility accessibility,
         const EGateState gatestate,
-        const std::vector<std::shared_ptr<const CObstacleInstance>> &obstacles,
-        const std::map<BattleHex, std::shared_ptr<Stack>> &hexstacks,
+        const HexObstacleMask &obstaclemask,
+        const std::vector<std::shared_ptr<Stack>> &stacks,
+        const HexStacks &hexstacks,
         const std::shared_ptr<ActiveStackInfo> &astackinfo
     ) : bhex(bhex_)
       , id(CalcId(bhex_)) {
-        attrs.fill(NULL_VALUE_UNENCODED);
-
         auto [x, y] = CalcXY(bhex);
-        auto it = hexstacks.find(bhex);
-        stack = it == hexstacks.end() ? nullptr : it->second;
+        auto si = hexstacks.at(id);
+        stack = si < 0 ? nullptr : stacks.at(si);
+
+        if (stack) {
+            std::fill(attrs.begin(), attrs.begin() + STACK_ATTR_OFFSET, NULL_VALUE_UNENCODED);
+            std::copy(stack->attrs.begin(), stack->attrs.end(), attrs.begin() + STACK_ATTR_OFFSET);
+        } else {
+            attrs.fill(NULL_VALUE_UNENCODED);
+        }
 
         setattr(A::Y_COORD, y);
         setattr(A::X_COORD, x);
@@ -120,52 +129,11 @@ namespace MMAI::BAI::V13 {
         // This is never N/A => set separately (not within the if below)
         setattr(A::IS_REAR, stack && bhex == stack->cstack->occupiedHex());
 
-        static_assert(EI(SA::_count) == 25, "whistleblower in case attributes change");
-
-        auto attrmap = std::map<A, SA> {
-            {A::STACK_SIDE,                  SA::SIDE},
-            {A::STACK_SLOT,                  SA::SLOT},
-            {A::STACK_QUANTITY,              SA::QUANTITY},
-            {A::STACK_ATTACK,                SA::ATTACK},
-            {A::STACK_DEFENSE,               SA::DEFENSE},
-            {A::STACK_SHOTS,                 SA::SHOTS},
-            {A::STACK_DMG_MIN,               SA::DMG_MIN},
-            {A::STACK_DMG_MAX,               SA::DMG_MAX},
-            {A::STACK_HP,                    SA::HP},
-            {A::STACK_HP_LEFT,               SA::HP_LEFT},
-            {A::STACK_SPEED,                 SA::SPEED},
-            {A::STACK_QUEUE,                 SA::QUEUE},
-            {A::STACK_VALUE_ONE,             SA::VALUE_ONE},
-            {A::STACK_FLAGS1,                SA::FLAGS1},
-            {A::STACK_FLAGS2,                SA::FLAGS2},
-
-            {A::STACK_VALUE_REL,             SA::VALUE_REL},
-            {A::STACK_VALUE_REL0,            SA::VALUE_REL0},
-            {A::STACK_VALUE_KILLED_REL,      SA::VALUE_KILLED_REL},
-            {A::STACK_VALUE_KILLED_ACC_REL0, SA::VALUE_KILLED_ACC_REL0},
-            {A::STACK_VALUE_LOST_REL,        SA::VALUE_LOST_REL},
-            {A::STACK_VALUE_LOST_ACC_REL0,   SA::VALUE_LOST_ACC_REL0},
-            {A::STACK_DMG_DEALT_REL,         SA::DMG_DEALT_REL},
-            {A::STACK_DMG_DEALT_ACC_REL0,    SA::DMG_DEALT_ACC_REL0},
-            {A::STACK_DMG_RECEIVED_REL,      SA::DMG_RECEIVED_REL},
-            {A::STACK_DMG_RECEIVED_ACC_REL0, SA::DMG_RECEIVED_ACC_REL0},
-        };
-
-        if (stack) {
-            int i = 0;
-            for (const auto &[a, sa] : attrmap) {
-                setattr(a, stack->attr(sa));
-                ++i;
-            }
-
-            ASSERT(i == EI(SA::_count), "not all stack attributes encoded: i=" + std::to_string(i));
-        }
-
         if (astackinfo) {
-            setStateMask(accessibility, obstacles, astackinfo->stack->cstack->unitSide());
-            setActionMask(astackinfo, hexstacks);
+            setStateMask(accessibility, obstaclemask, astackinfo->stack->cstack->unitSide());
+            setActionMask(astackinfo, stacks, hexstacks);
         } else {
-            setStateMask(accessibility, obstacles, BattleSide::ATTACKER);
+            setStateMask(accessibility, obstaclemask, BattleSide::ATTACKER);
         }
 
         finalize();
@@ -202,17 +170,11 @@ namespace MMAI::BAI::V13 {
         return stack.get();
     }
 
-    // private
-
-    void Hex::setStateMask(
-        const EAccessibility accessibility,
-        const std::vector<std::shared_ptr<const CObstacleInstance>> &obstacles,
-        BattleSide side
-    ) {
-        // First process obstacles
+    // static
+    void Hex::AddObstacleMask(HexObstacleMask &mask, const CObstacleInstance* obstacle) {
         // XXX: set only non-PASSABLE flags
         // (e.g. there may be a stack standing on the obstacle (firewall, moat))
-        // so the PASSABLE mask bit will set later
+        // so the PASSABLE mask bit will set later (see setStateMask)
         // XXX: moats are a weird obstacle:
         //      * if dispellable (Tower mines?) => type=SPELL_CREATED
         //      * otherwise => type=MOAT
@@ -223,34 +185,50 @@ namespace MMAI::BAI::V13 {
         //           BattleEvaluator::goTowardsNearest() // var triggerAbility
         //
 
-        for (auto &obstacle : obstacles) {
-            switch (obstacle->obstacleType) {
-            break; case CObstacleInstance::USUAL:
-                   case CObstacleInstance::ABSOLUTE_OBSTACLE:
-                statemask &= ~S_PASSABLE;
-            break; case CObstacleInstance::MOAT:
-                statemask |= (S_STOPPING | S_DAMAGING_ALL);
-            break; case CObstacleInstance::SPELL_CREATED:
-                // XXX: the public Obstacle / Spell API does not seem to expose
-                //      any useful methods for checking if friendly creatures
-                //      would get damaged by an obstacle.
-                switch(SpellID(obstacle->ID)) {
-                break; case SpellID::QUICKSAND:
-                    statemask |= S_STOPPING;
-                break; case SpellID::LAND_MINE:
-                    auto casterside = dynamic_cast<const SpellCreatedObstacle *>(obstacle.get())->casterSide;
-                    // XXX: in practice, there is no situation where enemy
-                    //      mines are visible as the UI simply does not allow
-                    //      to cast the spell in this case (e.g. if there is a
-                    //      terrain-native stack in the enemy army).
-                    statemask |= (side == casterside)
+        auto &lmask = mask.at(EI(BattleSide::ATTACKER));
+        auto &rmask = mask.at(EI(BattleSide::DEFENDER));
+
+        switch (obstacle->obstacleType) {
+        break; case CObstacleInstance::USUAL:
+               case CObstacleInstance::ABSOLUTE_OBSTACLE:
+            // not PASSABLE (accessibility is OBSTACLE)
+        break; case CObstacleInstance::MOAT:
+            lmask |= (S_STOPPING | S_DAMAGING_ALL);
+            rmask |= (S_STOPPING | S_DAMAGING_ALL);
+        break; case CObstacleInstance::SPELL_CREATED:
+            // XXX: the public Obstacle / Spell API does not seem to expose
+            //      any useful methods for checking if friendly creatures
+            //      would get damaged by an obstacle.
+            switch(SpellID(obstacle->ID)) {
+            break; case SpellID::QUICKSAND:
+                lmask |= S_STOPPING;
+                rmask |= S_STOPPING;
+            break; case SpellID::LAND_MINE:
+                auto casterside = dynamic_cast<const SpellCreatedObstacle *>(obstacle)->casterSide;
+                // XXX: in practice, there is no situation where enemy
+                //      mines are visible as the UI simply does not allow
+                //      to cast the spell in this case (e.g. if there is a
+                //      terrain-native stack in the enemy army).
+                for (auto side : {BattleSide::ATTACKER, BattleSide::DEFENDER}) {
+                    mask.at(EI(side)) |= (side == casterside)
                         ? (side == BattleSide::DEFENDER ? S_DAMAGING_L : S_DAMAGING_R)
                         : (side == BattleSide::DEFENDER ? S_DAMAGING_R : S_DAMAGING_L);
                 }
-            break; default:
-                THROW_FORMAT("Unexpected obstacle type: %d", EI(obstacle->obstacleType));
             }
+        break; default:
+            THROW_FORMAT("Unexpected obstacle type: %d", EI(obstacle->obstacleType));
         }
+    }
+
+    // private
+
+    void Hex::setStateMask(
+        const EAccessibility accessibility,
+        const HexObstacleMask &obstaclemask,
+        BattleSide side
+    ) {
+        // Obstacle bits are precomputed per battle (see ObstacleCache)
+        statemask |= obstaclemask.at(EI(side));
 
         switch(accessibility) {
         break; case EAccessibility::ACCESSIBLE:
@@ -297,7 +275,8 @@ namespace MMAI::BAI::V13 {
 
     void Hex::setActionMask(
         const std::shared_ptr<ActiveStackInfo> &astackinfo,
-        const std::map<BattleHex, std::shared_ptr<Stack>> &hexstacks
+        const std::vector<std::shared_ptr<Stack>> &stacks,
+        const HexStacks &hexstacks
     ) {
         auto astack = astackinfo->stack;
 
@@ -325,11 +304,11 @@ namespace MMAI::BAI::V13 {
             if (!n_bhex.isAvailable())
                 continue;
 
-            auto it = hexstacks.find(n_bhex);
-            if (it == hexstacks.end())
+            auto n_si = hexstacks.at(CalcId(n_bhex));
+            if (n_si < 0)
                 continue;
 
-            auto &n_cstack = it->second->cstack;
+            auto &n_cstack = stacks.at(n_si)->cstack;
             auto hexaction = HexAction(i);
 
             if (n_cstack->unitSide() != a_cstack->unitSide()) {
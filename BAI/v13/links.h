@@ -16,18 +16,25 @@
 
 #pragma once
 
+#include "BAI/arena.h"
 #include "schema/v13/types.h"
 
 namespace MMAI::BAI::V13 {
     class Links : public Schema::V13::ILinks {
     public:
-        std::vector<int64_t> srcIndex = {};       // [src1, src2, ...]
-        std::vector<int64_t> dstIndex = {};       // [dst1, dst2, ...]
-        std::vector<float> attributes = {};   // [attr1, attr2, ...]
+        explicit Links(Arena &arena)
+        : srcIndex(ArenaAllocator<int64_t>(&arena))
+        , dstIndex(ArenaAllocator<int64_t>(&arena))
+        , attributes(ArenaAllocator<float>(&arena))
+        {}
 
-        const std::vector<int64_t> getSrcIndex() const override { return srcIndex; }
-        const std::vector<int64_t> getDstIndex() const override { return dstIndex; }
-        const std::vector<float> getAttributes() const override { return attributes; }
+        ArenaVector<int64_t> srcIndex;       // [src1, src2, ...]
+        ArenaVector<int64_t> dstIndex;       // [dst1, dst2, ...]
+        ArenaVector<float> attributes;   // [attr1, attr2, ...]
+
+        const std::vector<int64_t> getSrcIndex() const override { return {srcIndex.begin(), srcIndex.end()}; }
+        const std::vector<int64_t> getDstIndex() const override { return {dstIndex.begin(), dstIndex.end()}; }
+        const std::vector<float> getAttributes() const override { return {attributes.begin(), attributes.end()}; }
 
         void add(int src, int dst, float attr) {
             srcIndex.push_back(src);
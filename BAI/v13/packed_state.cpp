@@ -0,0 +1,153 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include "BAI/v13/packed_state.h"
+
+namespace MMAI::BAI::V13::Packing {
+    namespace {
+        // Runs are visited in BattlefieldState order
+        template <typename F>
+        void ForEachRun(F &&f) {
+            for (auto &run : GLOBAL_RUNS)
+                f(run);
+            for (int p = 0; p < 2; ++p)
+                for (auto &run : PLAYER_RUNS)
+                    f(run);
+            for (int h = 0; h < 165; ++h)
+                for (auto &run : HEX_RUNS)
+                    f(run);
+        }
+
+        // Bits are accumulated into a byte and stored once it's full
+        struct BitWriter {
+            uint8_t* out;
+            uint8_t acc = 0;
+            int n = 0;
+
+            void put(bool bit) {
+                acc |= static_cast<uint8_t>(bit) << n;
+                if (++n == 8) {
+                    *out++ = acc;
+                    acc = 0;
+                    n = 0;
+                }
+            }
+
+            void finish() {
+                if (n > 0)
+                    *out = acc;
+            }
+        };
+
+        struct BitReader {
+            const uint8_t* in;
+            uint8_t acc = 0;
+            int n = 0;
+
+            float get() {
+                if (n == 0) {
+                    acc = *in++;
+                    n = 8;
+                }
+                auto bit = acc & 1;
+                acc >>= 1;
+                --n;
+                return bit;
+            }
+        };
+
+        struct Planes {
+            size_t ternary;
+            size_t bits;
+        };
+
+        constexpr Planes PLANES = {NFLOATS*sizeof(float), NFLOATS*sizeof(float) + NTERNARY};
+    }
+
+    bool Pack(const float* state, float* floats, int8_t* ternary, uint8_t* bits) {
+        auto writer = BitWriter{bits};
+        bool bad = false;
+
+        ForEachRun([&](const Run &run) {
+            switch (run.kind) {
+            case Kind::BIT:
+                for (int i = 0; i < run.length; ++i) {
+                    auto v = state[i];
+                    bad |= (v != 0.0f) & (v != 1.0f);
+                    writer.put(v != 0.0f);
+                }
+                break;
+            case Kind::TERNARY:
+                for (int i = 0; i < run.length; ++i) {
+                    auto v = state[i];
+                    bad |= (v != 0.0f) & (v != 1.0f) & (v != -1.0f);
+                    *ternary++ = (v > 0.0f) - (v < 0.0f);
+                }
+                break;
+            case Kind::FLOAT:
+                floats = std::copy(state, state + run.length, floats);
+                break;
+            }
+            state += run.length;
+        });
+
+        writer.finish();
+        return !bad;
+    }
+
+    void Unpack(const float* floats, const int8_t* ternary, const uint8_t* bits, float* state) {
+        auto reader = BitReader{bits};
+
+        ForEachRun([&](const Run &run) {
+            switch (run.kind) {
+            case Kind::BIT:
+                for (int i = 0; i < run.length; ++i)
+                    state[i] = reader.get();
+                break;
+            case Kind::TERNARY:
+                for (int i = 0; i < run.length; ++i)
+                    state[i] = *ternary++;
+                break;
+            case Kind::FLOAT:
+                std::copy(floats, floats + run.length, state);
+                floats += run.length;
+                break;
+            }
+            state += run.length;
+        });
+    }
+
+    bool Pack(const float* state, char* packed) {
+        return Pack(
+            state,
+            reinterpret_cast<float*>(packed),
+            reinterpret_cast<int8_t*>(packed + PLANES.ternary),
+            reinterpret_cast<uint8_t*>(packed + PLANES.bits)
+        );
+    }
+
+    void Unpack(const char* packed, float* state) {
+        Unpack(
+            reinterpret_cast<const float*>(packed),
+            reinterpret_cast<const int8_t*>(packed + PLANES.ternary),
+            reinterpret_cast<const uint8_t*>(packed + PLANES.bits),
+            state
+        );
+    }
+}
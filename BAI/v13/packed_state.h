@@ -0,0 +1,145 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include "schema/v13/constants.h"
+
+/*
+ * Lossless compact form of the v13 BattlefieldState.
+ *
+ * Most of the state consists of one-hot, binary and accumulating encodings
+ * whose values are always 0 or 1. Those are stored as bits, *_MASKING_NULL
+ * encodings (0, 1 or -1) as int8 and only the EXPNORM, LINNORM and RAW
+ * encodings remain floats. Which storage an attribute gets is derived from
+ * its encoding at compile time, so the layout follows any schema changes.
+ *
+ * Packed layout (three planes, each in BattlefieldState order):
+ *
+ *   float    floats[NFLOATS]
+ *   int8_t   ternary[NTERNARY]
+ *   uint8_t  bits[NBYTES]        // bit i is (bits[i/8] >> (i%8)) & 1
+ *
+ * Models which include an unpack layer can consume the planes directly
+ * (see TorchModel_LT), and snapshots store states in this form.
+ */
+namespace MMAI::BAI::V13::Packing {
+    using Schema::V13::Encoding;
+
+    enum class Kind : int {
+        BIT,        // 0 or 1
+        TERNARY,    // 0, 1 or -1 (masked)
+        FLOAT
+    };
+
+    struct Run {
+        Kind kind;
+        int length;
+    };
+
+    constexpr Kind KindOf(Encoding e) {
+        switch (e) {
+        case Encoding::ACCUMULATING_MASKING_NULL:
+        case Encoding::BINARY_MASKING_NULL:
+        case Encoding::CATEGORICAL_MASKING_NULL:
+        case Encoding::EXPBIN_MASKING_NULL:
+        case Encoding::ACCUMULATING_EXPBIN_MASKING_NULL:
+        case Encoding::LINBIN_MASKING_NULL:
+        case Encoding::ACCUMULATING_LINBIN_MASKING_NULL:
+            return Kind::TERNARY;
+        case Encoding::EXPNORM_EXPLICIT_NULL:
+        case Encoding::EXPNORM_MASKING_NULL:
+        case Encoding::EXPNORM_STRICT_NULL:
+        case Encoding::EXPNORM_ZERO_NULL:
+        case Encoding::LINNORM_EXPLICIT_NULL:
+        case Encoding::LINNORM_MASKING_NULL:
+        case Encoding::LINNORM_STRICT_NULL:
+        case Encoding::LINNORM_ZERO_NULL:
+        case Encoding::RAW:
+            return Kind::FLOAT;
+        default:
+            return Kind::BIT;
+        }
+    }
+
+    // Number of runs of same-kind attributes
+    template <typename T>
+    constexpr int CountRuns(const T &elems) {
+        int ret = 0;
+        for (size_t i = 0; i < elems.size(); ++i) {
+            if (i == 0 || KindOf(std::get<1>(elems[i])) != KindOf(std::get<1>(elems[i-1])))
+                ++ret;
+        }
+        return ret;
+    }
+
+    template <int N, typename T>
+    constexpr std::array<Run, N> MakeRuns(const T &elems) {
+        auto ret = std::array<Run, N>{};
+        int r = -1;
+        for (size_t i = 0; i < elems.size(); ++i) {
+            auto kind = KindOf(std::get<1>(elems[i]));
+            if (r == -1 || ret[r].kind != kind)
+                ret[++r] = Run{kind, 0};
+            ret[r].length += std::get<2>(elems[i]);
+        }
+        return ret;
+    }
+
+    template <size_t N>
+    constexpr int CountKind(const std::array<Run, N> &runs, Kind kind) {
+        int ret = 0;
+        for (auto &run : runs)
+            if (run.kind == kind)
+                ret += run.length;
+        return ret;
+    }
+
+    constexpr auto GLOBAL_RUNS = MakeRuns<CountRuns(Schema::V13::GLOBAL_ENCODING)>(Schema::V13::GLOBAL_ENCODING);
+    constexpr auto PLAYER_RUNS = MakeRuns<CountRuns(Schema::V13::PLAYER_ENCODING)>(Schema::V13::PLAYER_ENCODING);
+    constexpr auto HEX_RUNS = MakeRuns<CountRuns(Schema::V13::HEX_ENCODING)>(Schema::V13::HEX_ENCODING);
+
+    // Global, 2 players, 165 hexes (same as BATTLEFIELD_STATE_SIZE)
+    constexpr int Count(Kind kind) {
+        return CountKind(GLOBAL_RUNS, kind) + 2*CountKind(PLAYER_RUNS, kind) + 165*CountKind(HEX_RUNS, kind);
+    }
+
+    constexpr int NBITS = Count(Kind::BIT);
+    constexpr int NTERNARY = Count(Kind::TERNARY);
+    constexpr int NFLOATS = Count(Kind::FLOAT);
+    constexpr int NBYTES = (NBITS + 7) / 8;
+
+    // Total size of the three planes, in bytes
+    constexpr int PACKED_SIZE = NFLOATS*sizeof(float) + NTERNARY + NBYTES;
+
+    static_assert(NBITS + NTERNARY + NFLOATS == Schema::V13::BATTLEFIELD_STATE_SIZE, "packing does not cover the state");
+
+    /*
+     * Packs a BATTLEFIELD_STATE_SIZE-long state into the three planes.
+     * Returns false if a value can't be represented exactly in its plane
+     * (e.g. 0.5 in a binary encoding), in which case the output is
+     * incomplete and must not be used.
+     */
+    bool Pack(const float* state, float* floats, int8_t* ternary, uint8_t* bits);
+
+    // Inverse of Pack. Writes BATTLEFIELD_STATE_SIZE floats to `state`.
+    void Unpack(const float* floats, const int8_t* ternary, const uint8_t* bits, float* state);
+
+    // Same as above, for a contiguous PACKED_SIZE-byte buffer (see layout)
+    bool Pack(const float* state, char* packed);
+    void Unpack(const char* packed, float* state);
+}
@@ -168,41 +168,21 @@ namespace MMAI::BAI::V13 {
     }
 
 
-    Stack::Stack(
-        const CStack* cstack_,
-        Queue &q,
-        const GlobalStats* ogstats,
-        const GlobalStats* gstats,
-        const Stats stats,
-        const ReachabilityInfo rinfo_,
-        bool blocked,
-        bool blocking,
-        DamageEstimation estdmg
-    ) : cstack(cstack_)
-      , rinfo(rinfo_)
+    BonusInfo::BonusInfo(const CStack* cstack)
+    : treeVersion(cstack->getTreeVersion())
+    , shots(cstack->shots.available())
+    , attack(cstack->getAttack(shots > 0))
+    , defense(cstack->getDefense(false))
+    , dmgMin(cstack->getMinDamage(shots > 0))
+    , dmgMax(cstack->getMaxDamage(shots > 0))
+    , hp(cstack->getMaxHealth())
+    , speed(cstack->getMovementRange())
+    , blockable(
+        cstack->canShoot()
+        && !cstack->hasBonusOfType(BonusType::FREE_SHOOTING)
+        && !cstack->hasBonusOfType(BonusType::SIEGE_WEAPON)
+    )
     {
-        // XXX: NULL attrs are used only for non-existing stacks
-        // => don't fill with null here (as opposed to attrs in Hex)
-
-        int slot = cstack->unitSlot();
-        if (slot >= 0 && slot < 7) {
-            alias = slot + '0';
-        } else if (slot == SlotID::WAR_MACHINES_SLOT) {
-            // "machine" slot
-            alias = 'M';
-            slot = STACK_SLOT_WARMACHINES;
-        } else {
-            // "special" slot
-            // SlotID::SUMMONED_SLOT_PLACEHOLDER
-            // SlotID::COMMANDER_SLOT_PLACEHOLDER
-            alias = 'S';
-            slot = STACK_SLOT_SPECIAL;
-        }
-
-        // queue needs to be set first to determine if stack is active
-        auto [qbits, pos] = QBits(cstack, q);
-        qposFirst = pos; // for comparing two positions
-
         auto bonuses = cstack->getAllBonuses(Selector::all);
 
         // XXX: config/creatures/<faction>.json is misleading
@@ -471,6 +451,66 @@ namespace MMAI::BAI::V13 {
                 }
             }
         }
+    }
+
+    void BonusInfo::setflag(StackFlag1 f) {
+        flags1.set(EI(f));
+    };
+
+    void BonusInfo::setflag(StackFlag2 f) {
+        flags2.set(EI(f));
+    };
+
+    // static
+    const BonusInfo& Stack::GetBonusInfo(BonusCache &cache, const CStack* cstack) {
+        auto it = cache.find(cstack->unitId());
+        if (
+            it != cache.end()
+            && it->second.treeVersion == cstack->getTreeVersion()
+            && it->second.shots == cstack->shots.available()
+        ) return it->second;
+
+        return cache.insert_or_assign(cstack->unitId(), BonusInfo(cstack)).first->second;
+    }
+
+    Stack::Stack(
+        const CStack* cstack_,
+        Queue &q,
+        const GlobalStats* ogstats,
+        const GlobalStats* gstats,
+        const Stats stats,
+        const ReachabilityInfo rinfo_,
+        bool blocked,
+        bool blocking,
+        DamageEstimation estdmg,
+        const BonusInfo &bonusinfo
+    ) : cstack(cstack_)
+      , rinfo(rinfo_)
+    {
+        // XXX: NULL attrs are used only for non-existing stacks
+        // => don't fill with null here (as opposed to attrs in Hex)
+
+        int slot = cstack->unitSlot();
+        if (slot >= 0 && slot < 7) {
+            alias = slot + '0';
+        } else if (slot == SlotID::WAR_MACHINES_SLOT) {
+            // "machine" slot
+            alias = 'M';
+            slot = STACK_SLOT_WARMACHINES;
+        } else {
+            // "special" slot
+            // SlotID::SUMMONED_SLOT_PLACEHOLDER
+            // SlotID::COMMANDER_SLOT_PLACEHOLDER
+            alias = 'S';
+            slot = STACK_SLOT_SPECIAL;
+        }
+
+        // queue needs to be set first to determine if stack is active
+        auto [qbits, pos] = QBits(cstack, q);
+        qposFirst = pos; // for comparing two positions
+
+        flags1 = bonusinfo.flags1;
+        flags2 = bonusinfo.flags2;
 
         // double avgdmg = 0.5*(estdmg.damage.max + estdmg.damage.min);
         // auto dmgPermilleHP = std::clamp<int>(std::round(1000ll * avgdmg / cstack->getAvailableHealth()), 0, 1000);
@@ -502,7 +542,7 @@ namespace MMAI::BAI::V13 {
         if (qbits.test(0))
             setflag(F1::IS_ACTIVE);
 
-        shots = cstack->shots.available();
+        shots = bonusinfo.shots;
 
         int cid = cstack->creatureId().num;
         if (cid > Schema::V13::CREATURE_ID_MAX) {
@@ -533,14 +573,14 @@ namespace MMAI::BAI::V13 {
         setattr(A::SIDE, EI(cstack->unitSide()));
         setattr(A::SLOT, slot);
         setattr(A::QUANTITY, cstack->getCount());
-        setattr(A::ATTACK, cstack->getAttack(shots > 0));
-        setattr(A::DEFENSE, cstack->getDefense(false));
+        setattr(A::ATTACK, bonusinfo.attack);
+        setattr(A::DEFENSE, bonusinfo.defense);
         setattr(A::SHOTS, shots);
-        setattr(A::DMG_MIN, cstack->getMinDamage(shots > 0));
-        setattr(A::DMG_MAX, cstack->getMaxDamage(shots > 0));
-        setattr(A::HP, cstack->getMaxHealth());
+        setattr(A::DMG_MIN, bonusinfo.dmgMin);
+        setattr(A::DMG_MAX, bonusinfo.dmgMax);
+        setattr(A::HP, bonusinfo.hp);
         setattr(A::HP_LEFT, cstack->getFirstHPleft());
-        setattr(A::SPEED, cstack->getMovementRange());
+        setattr(A::SPEED, bonusinfo.speed);
         setattr(A::QUEUE, qbits.to_ulong());
         setattr(A::VALUE_ONE, valueOne);
         setattr(A::VALUE_REL,             permille(value, bf_valueNow));
@@ -32,12 +32,39 @@ namespace MMAI::BAI::V13 {
     static_assert(1<<STACK_QUEUE_SIZE < std::numeric_limits<int>::max(), "BitQueue must be convertible to int");
 
 
+    /**
+     * Unit properties derived from VCMI's bonus system, which is relatively
+     * expensive to traverse. Cached per unit id and reused for as long as
+     * the bonus tree (and the unit's shots) are unchanged.
+     */
+    struct BonusInfo {
+        explicit BonusInfo(const CStack* cstack);
+
+        int64_t treeVersion;
+        int shots;          // attack, dmg and canShoot depend on it
+        int attack;
+        int defense;
+        int dmgMin;
+        int dmgMax;
+        int hp;
+        int speed;
+        bool blockable;     // a shooter which gets blocked by adjacent enemies
+        StackFlags1 flags1 = 0;   // bonus-derived flags only
+        StackFlags2 flags2 = 0;   //
+    private:
+        void setflag(StackFlag1 f);
+        void setflag(StackFlag2 f);
+    };
+
+    using BonusCache = std::map<uint32_t, BonusInfo>; // key=unit id
+
     /**
      * A wrapper around CStack
      */
     class Stack : public Schema::V13::IStack {
     public:
         static int CalcValue(const CCreature* creature);
+        static const BonusInfo& GetBonusInfo(BonusCache &cache, const CStack* cstack);
 
         // not the quantum version :)
         static std::pair<BitQueue, int> QBits(const CStack*, const Queue&);
@@ -62,7 +89,8 @@ namespace MMAI::BAI::V13 {
             const ReachabilityInfo rinfo,
             bool blocked,
             bool blocking,
-            DamageEstimation estdmg
+            DamageEstimation estdmg,
+            const BonusInfo &bonusinfo
         );
 
         // IStack impl
@@ -91,4 +119,35 @@ namespace MMAI::BAI::V13 {
         void addattr(StackAttribute a, int value);
         void finalize();
     };
+
+    using StacksStats = std::vector<Stack::Stats>; // index=unit id
+
+    /**
+     * A value copy of a Stack's attributes and flags, for referring to a
+     * stack after its Battlefield is gone (e.g. in attack logs) without
+     * keeping the Stack (and its ReachabilityInfo) alive.
+     */
+    class StackSnapshot : public Schema::V13::IStack {
+    public:
+        explicit StackSnapshot(const Stack &stack)
+        : unitId(stack.cstack->unitId())
+        , attrs(stack.attrs)
+        , flags1(stack.flags1)
+        , flags2(stack.flags2)
+        , alias(stack.alias)
+        {}
+
+        // IStack impl
+        const StackAttrs& getAttrs() const override { return attrs; }
+        int getAttr(StackAttribute a) const override { return attrs.at(EI(a)); }
+        int getFlag(StackFlag1 f) const override { return flags1.test(EI(f)); }
+        int getFlag(StackFlag2 f) const override { return flags2.test(EI(f)); }
+        char getAlias() const override { return alias; }
+
+        const uint32_t unitId;
+        const StackAttrs attrs;
+        const StackFlags1 flags1;
+        const StackFlags2 flags2;
+        const char alias;
+    };
 }
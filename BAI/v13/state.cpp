@@ -19,6 +19,8 @@
 #include "battle/CPlayerBattleCallback.h"
 #include "networkPacks/PacksForClientBattle.h"
 
+#include "BAI/alloc_stats.h"
+#include "BAI/perf_stats.h"
 #include "BAI/v13/encoder.h"
 #include "BAI/v13/hexaction.h"
 #include "BAI/v13/state.h"
@@ -90,80 +92,80 @@ namespace MMAI::BAI::V13 {
         return {lv, lh, rv, rh};
     }
 
-    std::tuple<int, int, int, int, int, int, int, int> ProcessAttackLogs(
-        std::vector<std::shared_ptr<AttackLog>> attackLogs,
-        std::map<const CStack*, Stack::Stats> sstats
-    ) {
-        // dmg dealt / dmg received / value killed / value lost
-        int ldd = 0, ldr = 0, lvk = 0, lvl = 0;
-        int rdd = 0, rdr = 0, rvk = 0, rvl = 0;
-
-        for (auto &[cstack, ss] : sstats) {
-            ss.dmgDealtNow = 0;
-            ss.dmgReceivedNow = 0;
-            ss.valueKilledNow = 0;
-            ss.valueLostNow = 0;
-        }
-
-        for (auto &al : attackLogs) {
-            if (al->cattacker) {
-                sstats[al->cattacker].dmgDealtNow += al->dmg;
-                sstats[al->cattacker].dmgDealtTotal += al->dmg;
-                sstats[al->cattacker].valueKilledNow += al->value;
-                sstats[al->cattacker].valueKilledTotal += al->value;
-
-                if (al->cattacker->unitSide() == BattleSide::LEFT_SIDE) {
-                    ldd += al->dmg;
-                    lvk += al->value;
-                } else {
-                    rdd += al->dmg;
-                    rvk += al->value;
-                }
-            }
-
-            ASSERT(al->cdefender, "AttackLog cdefender is nullptr!");
-            sstats[al->cdefender].dmgReceivedNow += al->dmg;
-            sstats[al->cdefender].dmgReceivedTotal += al->dmg;
-            sstats[al->cdefender].valueLostNow += al->value;
-            sstats[al->cdefender].valueLostTotal += al->value;
-
-            if (al->cdefender->unitSide() == BattleSide::LEFT_SIDE) {
-                ldr += al->dmg;
-                lvl += al->value;
+    // NOTE: per-unit stats (sstats) are deliberately not accumulated here.
+    // The stack *_REL and *_ACC_REL0 attributes have always been encoded
+    // as 0 and all models are trained that way: populating them requires
+    // a new schema version.
+    void State::processAttackLog(const AttackLog &al) {
+        auto &at = attackTotals;
+
+        if (al.cattacker) {
+            if (al.cattacker->unitSide() == BattleSide::LEFT_SIDE) {
+                at.ldd += al.dmg;
+                at.lvk += al.value;
             } else {
-                rdr += al->dmg;
-                rvl += al->value;
+                at.rdd += al.dmg;
+                at.rvk += al.value;
             }
         }
 
-        return {ldd, ldr, lvk, lvl, rdd, rdr, rvk, rvl};
+        ASSERT(al.cdefender, "AttackLog cdefender is nullptr!");
+
+        // NOTE: dmg is capped to the defender's available health by VCMI
+        if (al.cdefender->unitSide() == BattleSide::LEFT_SIDE) {
+            at.ldr += al.dmg;
+            at.lvl += al.value;
+            armyTotals.lv -= al.value;
+            armyTotals.lh -= al.dmg;
+        } else {
+            at.rdr += al.dmg;
+            at.rvl += al.value;
+            armyTotals.rv -= al.value;
+            armyTotals.rh -= al.dmg;
+        }
     }
 
 
 
     State::State(const int version__, const std::string colorname_, const CPlayerBattleCallback* battle_)
     : version_(version__)
+    , transitions(Schema::V13::N_ACTIONS, Schema::V13::BATTLEFIELD_STATE_SIZE)
     , colorname(colorname_)
     , battle(battle_)
     , side(battle_->battleGetMySide())
     , nullstack(InitNullStack())
     {
         auto [lv, lh, rv, rh] = CalcGlobalStats(battle);
+        armyTotals = {true, lv, lh, rv, rh};
         gstats = std::make_unique<GlobalStats>(battle->battleGetMySide(), lv+rv, lh+rh);
         lpstats = std::make_unique<PlayerStats>(BattleSide::LEFT_SIDE, lv, lh);
         rpstats = std::make_unique<PlayerStats>(BattleSide::RIGHT_SIDE, rv, rh);
 
-        battlefield = Battlefield::Create(battle_, nullptr, gstats.get(), gstats.get(), sstats, false);
+        battlefield = Battlefield::Create(arenas.next(), obstacles, bonuses, battle_, nullptr, gstats.get(), gstats.get(), sstats, false);
         bfstate.reserve(Schema::V13::BATTLEFIELD_STATE_SIZE);
         actmask.reserve(Schema::V13::N_ACTIONS);
     }
 
     void State::onActiveStack(const CStack* astack, CombatResult result, bool recording, bool fastpath) {
+        // Logging allocates (outside of the STATE budget, see alloc_test)
         logAi->debug("onActiveStack: result=%d, recording=%d, fastpath=%d", EI(result), recording, fastpath);
-        auto [lv, lh, rv, rh] = CalcGlobalStats(battle);
-        auto [ldd, ldr, lvk, lvl, rdd, rdr, rvk, rvl] = ProcessAttackLogs(attackLogs, sstats);
+        auto allocScope = AllocStats::Scope(AllocStats::Stage::STATE);
+        if (!armyTotals.valid) {
+            auto [lv, lh, rv, rh] = CalcGlobalStats(battle);
+            armyTotals = {true, lv, lh, rv, rh};
+        }
+
+        auto [_, lv, lh, rv, rh] = armyTotals;
+        auto [ldd, ldr, lvk, lvl, rdd, rdr, rvk, rvl] = attackTotals;
         auto ogstats = *gstats;  // a copy of the "old" gstats
 
+        // Recorded transitions (see onActionStarted) are encoded with the
+        // stats as of this action, but only our own turns advance them:
+        // the *_NOW attributes mean "since our last turn" whether or not
+        // transitions are recorded (i.e. in ENABLE_ML builds or not).
+        auto olpstats = *lpstats;
+        auto orpstats = *rpstats;
+
         (result == CombatResult::NONE)
             ? gstats->update(astack->unitSide(), result, lv+rv, lh+rh, !astack->waitedThisTurn)
             : gstats->update(BattleSide::NONE, result, lv+rv, lh+rh, false);
@@ -176,11 +178,16 @@ namespace MMAI::BAI::V13 {
             transitions.clear();
             persistentAttackLogs.clear();
         } else {
-            // XXX: uncomment when enabling transitions (1/2)
-            // persistentAttackLogs.insert(persistentAttackLogs.end(), attackLogs.begin(), attackLogs.end());
-            battlefield = Battlefield::Create(battle, astack, &ogstats, gstats.get(), sstats, isMorale);
+            #ifdef ENABLE_ML
+                // fastpath (which clears these) is reached only via onActionStarted
+                persistentAttackLogs.insert(persistentAttackLogs.end(), attackLogs.begin(), attackLogs.end());
+            #endif
+            // Links are consumed only when it's our turn to act (see supdata)
+            battlefield = Battlefield::Create(arenas.next(), obstacles, bonuses, battle, astack, &ogstats, gstats.get(), sstats, isMorale, !recording);
+            auto perfScope = PerfStats::Scope(PerfStats::Stage::ENCODING);
             bfstate.clear();
             actmask.clear();
+            packedmask.clear();
 
             for (int i=0; i<EI(GlobalAction::_count); i++) {
                 switch (GlobalAction(i)) {
@@ -190,6 +197,9 @@ namespace MMAI::BAI::V13 {
                 break; default:
                     THROW_FORMAT("Unexpected GlobalAction: %d", i);
                 }
+
+                if (actmask.back())
+                    packedmask.set(i);
             }
 
             encodeGlobal(result);
@@ -208,33 +218,48 @@ namespace MMAI::BAI::V13 {
             verify();
         }
 
-        isMorale = false;
-
-        supdata = std::make_unique<SupplementaryData>(
-            colorname,
-            Side(side),
-            gstats.get(),
-            lpstats.get(),
-            rpstats.get(),
-            battlefield.get(),
-            // XXX: replace with persistentAttackLogs when enabling transitions (2/2)
-            attackLogs, // store the logs since OUR last turn
-            transitions, // store the states since last turn
-            result
-        );
+        #ifdef ENABLE_ML
+            auto &turnAttackLogs = persistentAttackLogs;
+        #else
+            auto &turnAttackLogs = attackLogs;
+        #endif
+
+        {
+            auto supdataScope = AllocStats::Scope(AllocStats::Stage::SUPDATA);
+            supdata = std::make_unique<SupplementaryData>(
+                colorname,
+                Side(side),
+                gstats.get(),
+                lpstats.get(),
+                rpstats.get(),
+                battlefield.get(),
+                turnAttackLogs, // store the logs since OUR last turn
+                transitions.get(), // store the states since last turn
+                &packedmask,
+                result
+            );
+        }
 
         if (recording) {
             ASSERT(startedAction >= 0, "unexpected startedAction: " + std::to_string(startedAction));
             // NOTE: this creates a copy of bfstate (which is what we want)
-            transitions.push_back({startedAction, std::make_shared<Schema::ActionMask>(actmask), std::make_shared<Schema::BattlefieldState>(bfstate)});
-        } else {
-            actingStack = astack; // for fastpath, see onActionStarted
-            startedAction = -1;
-            // XXX: must NOT clear transitions here (can do it only after BAI's activeStack completes)
-            // transitions.clear();
+            transitions.record(startedAction, actmask, bfstate);
+
+            // Keep accumulating logs and totals until our turn
+            *gstats = ogstats;
+            *lpstats = olpstats;
+            *rpstats = orpstats;
+            return;
         }
 
+        actingStack = astack; // for fastpath, see onActionStarted
+        startedAction = -1;
+        isMorale = false;
+        // XXX: must NOT clear transitions here (can do it only after BAI's activeStack completes)
+        // transitions.clear();
+
         attackLogs.clear(); // accumulate new logs until next turn
+        attackTotals = {};
     }
 
 
@@ -378,8 +403,13 @@ namespace MMAI::BAI::V13 {
             Encoder::Encode(HA(i), hex->attrs.at(i), bfstate);
 
         // Action mask
-        for (int m=0; m<hex->actmask.size(); ++m)
-            actmask.push_back(hex->actmask.test(m));
+        auto base = static_cast<int>(actmask.size());
+        for (int m=0; m<hex->actmask.size(); ++m) {
+            auto allowed = hex->actmask.test(m);
+            actmask.push_back(allowed);
+            if (allowed)
+                packedmask.set(base + m);
+        }
     }
 
     void State::verify() {
@@ -388,7 +418,7 @@ namespace MMAI::BAI::V13 {
     }
 
     void State::onBattleStacksAttacked(const std::vector<BattleStackAttacked> &bsa) {
-        auto stacks = battlefield->stacks;
+        const auto &stacks = battlefield->stacks;
 
         for(auto & elem : bsa) {
             auto cdefender = battle->battleGetStackByID(elem.stackAttacked, false);
@@ -397,7 +427,7 @@ namespace MMAI::BAI::V13 {
             ASSERT(cdefender, "defender cannot be NULL");
             // logAi->debug("Attack: %s -> %s (%d dmg, %d died)", attacker->getName(), defender->getName(), elem.damageAmount, elem.killedAmount);
 
-            auto defender = std::find_if(stacks.begin(), stacks.end(), [&cdefender](std::shared_ptr<Stack> stack) {
+            auto defender = std::find_if(stacks.begin(), stacks.end(), [&cdefender](const std::shared_ptr<Stack> &stack) {
                 return cdefender == stack->cstack;
             });
 
@@ -405,7 +435,7 @@ namespace MMAI::BAI::V13 {
                 logAi->info("defender cstack '%s' not found in stacks. Maybe it was just summoned/resurrected?", cdefender->getDescription());
             }
 
-            auto attacker = std::find_if(stacks.begin(), stacks.end(), [&cattacker](std::shared_ptr<Stack> stack) {
+            auto attacker = std::find_if(stacks.begin(), stacks.end(), [&cattacker](const std::shared_ptr<Stack> &stack) {
                 return cattacker == stack->cstack;
             });
 
@@ -420,13 +450,13 @@ namespace MMAI::BAI::V13 {
             // std::cout << ", value=" << (value);
             // std::cout << "\n";
 
-            attackLogs.push_back(std::make_shared<AttackLog>(
+            auto al = std::make_shared<AttackLog>(
                 // XXX: attacker can be NULL when an effect does dmg (eg. Acid)
                 // XXX: attacker or defender can be NULL if it did not exist
                 //      when `stacks` was built (e.g. during our last turn),
                 //      but the enemy just summonned/resurrected it
-                attacker != stacks.end() ? *attacker : nullptr,
-                defender != stacks.end() ? *defender : nullptr,
+                attacker != stacks.end() ? attacker->get() : nullptr,
+                defender != stacks.end() ? defender->get() : nullptr,
                 cattacker,
                 cdefender,
                 elem.damageAmount,
@@ -434,17 +464,37 @@ namespace MMAI::BAI::V13 {
                 elem.killedAmount,
                 value,
                 1000 * value / bf_valueNow
-            ));
+            );
+
+            processAttackLog(*al);
+            attackLogs.push_back(al);
         }
     }
 
+    void State::onBattleUnitsChanged(const std::vector<UnitChanges> &changes) {
+        // summons, resurrections, heals, etc.
+        armyTotals.valid = false;
+    }
+
+    void State::onBattleSpellCast(const BattleSpellCast *sc) {
+        // e.g. max HP changes (age)
+        armyTotals.valid = false;
+    }
+
     void State::onBattleTriggerEffect(const BattleTriggerEffect &bte) {
+        // e.g. regeneration
+        armyTotals.valid = false;
+
         if (static_cast<BonusType>(bte.effect) != BonusType::MORALE)
             return;
 
         isMorale = true;
     }
 
+    void State::onObstaclesChanged() {
+        obstacles.valid = false;
+    }
+
     void State::onActionFinished(const BattleAction &action) {
         // XXX: assuming action was OK (no server error about failed/fishy action)
     }
@@ -454,8 +504,8 @@ namespace MMAI::BAI::V13 {
      * !!!!!! IMPORTANT: `battlefield` must not be used here (old state) !!!!!!
      * !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
      */
-    // XXX: this is never called (transitions are disabled for performance)
-    //      See BAI::actionStarted
+    // XXX: called only in ENABLE_ML builds (transitions are needed only
+    //      for training data). See BAI::actionStarted
     void State::onActionStarted(const BattleAction &action) {
         _onActionStarted(action);
         actingStack = nullptr;
@@ -19,6 +19,8 @@
 #include "battle/CPlayerBattleCallback.h"
 #include "networkPacks/PacksForClientBattle.h"
 
+#include "BAI/arena.h"
+#include "BAI/transition_pool.h"
 #include "BAI/v13/action.h"
 #include "BAI/v13/attack_log.h"
 #include "BAI/v13/battlefield.h"
@@ -51,6 +53,9 @@ namespace MMAI::BAI::V13 {
         void onActiveStack(const CStack* astack, CombatResult result = CombatResult::NONE, bool recording = false, bool fastpath = false);
         void onBattleStacksAttacked(const std::vector<BattleStackAttacked> &bsa);
         void onBattleTriggerEffect(const BattleTriggerEffect &bte);
+        void onBattleUnitsChanged(const std::vector<UnitChanges> &changes);
+        void onBattleSpellCast(const BattleSpellCast *sc);
+        void onObstaclesChanged();
         void onActionStarted(const BattleAction &action);
         void _onActionStarted(const BattleAction &action);
         void onActionFinished(const BattleAction &action);
@@ -66,15 +71,40 @@ namespace MMAI::BAI::V13 {
         const int version_;
         Schema::BattlefieldState bfstate = {};
         Schema::ActionMask actmask = {};
+        Schema::V13::PackedActionMask packedmask = {};
+
+        // Per-turn Battlefield allocations. Declared before any members
+        // which may refer to them (i.e. must be destroyed after them).
+        ArenaPool arenas;
+        ObstacleCache obstacles;
+        BonusCache bonuses;
+
         std::unique_ptr<SupplementaryData> supdata = nullptr;
         std::vector<std::shared_ptr<AttackLog>> attackLogs = {};
         std::vector<std::shared_ptr<AttackLog>> persistentAttackLogs = {};
-        std::vector<std::tuple<Schema::Action, std::shared_ptr<Schema::ActionMask>, std::shared_ptr<Schema::BattlefieldState>>> transitions = {};
+        TransitionPool transitions;
         std::unique_ptr<Action> action = nullptr;
         std::unique_ptr<GlobalStats> gstats = nullptr;
         std::unique_ptr<PlayerStats> lpstats = nullptr;
         std::unique_ptr<PlayerStats> rpstats = nullptr;
-        std::map<const CStack*, Stack::Stats> sstats;
+        StacksStats sstats;  // always empty, see processAttackLog
+
+        // Army value/HP totals, updated incrementally from attack logs.
+        // Recalculated from `battle` only after events which may change
+        // them in other ways (summons, resurrections, spells, etc.)
+        struct ArmyTotals {
+            bool valid = false;
+            int lv = 0, lh = 0, rv = 0, rh = 0;
+        } armyTotals;
+
+        // dmg dealt / dmg received / value killed / value lost per side,
+        // accumulated from attack logs since the last onActiveStack
+        struct AttackTotals {
+            int ldd = 0, ldr = 0, lvk = 0, lvl = 0;
+            int rdd = 0, rdr = 0, rvk = 0, rvl = 0;
+        } attackTotals;
+
+        void processAttackLog(const AttackLog &al);
         const std::pair<int, int> initialArmyValues;
         const std::string colorname;
         const CPlayerBattleCallback* const battle;
@@ -0,0 +1,63 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include "BAI/v13/state_copy.h"
+#include "common.h"
+
+namespace MMAI::BAI::V13 {
+    StateCopy::StateCopy(const Schema::IState* s)
+    : version_(s->version())
+    , bfstate(*s->getBattlefieldState())
+    , actmask(*s->getActionMask())
+    , attnmask(*s->getAttentionMask())
+    , supdata(SupplementaryDataOf(s))
+    {}
+
+    const Schema::V13::ISupplementaryData* StateCopy::SupplementaryDataOf(const Schema::IState* s) {
+        auto any = s->getSupplementaryData();
+        if (!any.has_value())
+            throw std::runtime_error("StateCopy: supdata is empty");
+
+        auto sup = std::any_cast<const Schema::V13::ISupplementaryData*>(any);
+        ASSERT(sup, "StateCopy: supdata is nullptr");
+        return sup;
+    }
+
+    StateCopy::SupplementaryData::SupplementaryData(const Schema::V13::ISupplementaryData* sup)
+    : type(sup->getType())
+    , side(sup->getSide())
+    , color(sup->getColor())
+    , errcode(sup->getErrorCode())
+    , ended(sup->getIsBattleEnded())
+    , victory(sup->getIsVictorious())
+    {
+        for (auto &[lt, l] : sup->getAllLinks())
+            links.emplace(lt, std::make_unique<Links>(l));
+
+        if (const auto *pm = sup->getPackedActionMask())
+            packedmask = *pm;
+    }
+
+    const Schema::V13::AllLinks StateCopy::SupplementaryData::getAllLinks() const {
+        auto res = Schema::V13::AllLinks{};
+        for (auto &[lt, l] : links)
+            res.emplace(lt, l.get());
+        return res;
+    }
+}
@@ -0,0 +1,113 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <optional>
+
+#include "schema/base.h"
+#include "schema/v13/types.h"
+
+namespace MMAI::BAI::V13 {
+    /*
+     * A self-contained copy of the model inputs of a (live) state: bfstate,
+     * actmask, attnmask and the parts of the supplementary data the models
+     * read (links, side, battle result, packed action mask).
+     * Unlike the live state, it is not modified by battle callbacks, so it
+     * can be handed to a model running on another thread.
+     */
+    class StateCopy : public Schema::IState {
+    public:
+        explicit StateCopy(const Schema::IState* s);
+
+        StateCopy(const StateCopy&) = delete;
+        StateCopy& operator=(const StateCopy&) = delete;
+
+        // impl IState
+        const Schema::ActionMask* getActionMask() const override { return &actmask; }
+        const Schema::AttentionMask* getAttentionMask() const override { return &attnmask; }
+        const Schema::BattlefieldState* getBattlefieldState() const override { return &bfstate; }
+        const std::any getSupplementaryData() const override {
+            return static_cast<const Schema::V13::ISupplementaryData*>(&supdata);
+        }
+        int version() const override { return version_; }
+
+    private:
+        class Links : public Schema::V13::ILinks {
+        public:
+            explicit Links(const Schema::V13::ILinks* links)
+            : srcIndex(links->getSrcIndex())
+            , dstIndex(links->getDstIndex())
+            , attributes(links->getAttributes())
+            {}
+
+            const std::vector<int64_t> getSrcIndex() const override { return srcIndex; }
+            const std::vector<int64_t> getDstIndex() const override { return dstIndex; }
+            const std::vector<float> getAttributes() const override { return attributes; }
+
+        private:
+            const std::vector<int64_t> srcIndex;
+            const std::vector<int64_t> dstIndex;
+            const std::vector<float> attributes;
+        };
+
+        class SupplementaryData : public Schema::V13::ISupplementaryData {
+        public:
+            explicit SupplementaryData(const Schema::V13::ISupplementaryData* sup);
+
+            // impl ISupplementaryData
+            Type getType() const override { return type; }
+            Schema::Side getSide() const override { return side; }
+            std::string getColor() const override { return color; }
+            Schema::V13::ErrorCode getErrorCode() const override { return errcode; }
+            bool getIsBattleEnded() const override { return ended; }
+            bool getIsVictorious() const override { return victory; }
+            const Schema::V13::IGlobalStats* getGlobalStats() const override { return nullptr; }
+            const Schema::V13::IPlayerStats* getLeftPlayerStats() const override { return nullptr; }
+            const Schema::V13::IPlayerStats* getRightPlayerStats() const override { return nullptr; }
+            const Schema::V13::Stacks getStacks() const override { return {}; }
+            const Schema::V13::Hexes getHexes() const override { return {}; }
+            const Schema::V13::AllLinks getAllLinks() const override;
+            const Schema::V13::AttackLogs getAttackLogs() const override { return {}; }
+            const std::string getAnsiRender() const override { return ""; }
+            const Schema::V13::StateTransitions getStateTransitions() const override { return {}; }
+            const Schema::V13::PackedActionMask* getPackedActionMask() const override {
+                return packedmask ? &*packedmask : nullptr;
+            }
+
+        private:
+            const Type type;
+            const Schema::Side side;
+            const std::string color;
+            const Schema::V13::ErrorCode errcode;
+            const bool ended;
+            const bool victory;
+            std::map<Schema::V13::LinkType, std::unique_ptr<Links>> links;
+            std::optional<Schema::V13::PackedActionMask> packedmask;
+        };
+
+        static const Schema::V13::ISupplementaryData* SupplementaryDataOf(const Schema::IState* s);
+
+        const int version_;
+        const Schema::BattlefieldState bfstate;
+        const Schema::ActionMask actmask;
+        const Schema::AttentionMask attnmask;
+        const SupplementaryData supdata;
+    };
+}
@@ -68,13 +68,7 @@ namespace MMAI::BAI::V13 {
     }
 
     const Schema::V13::StateTransitions SupplementaryData::getStateTransitions() const {
-        auto res = Schema::V13::StateTransitions{};
-        res.reserve(transitions.size());
-
-        for (auto [action, actmask, transition] : transitions)
-            res.push_back({action, actmask.get(), transition.get()});
-
-        return res;
+        return transitions;
     }
 
 }
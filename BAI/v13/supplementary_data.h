@@ -41,17 +41,19 @@ namespace MMAI::BAI::V13 {
             const PlayerStats* lpstats_,
             const PlayerStats* rpstats_,
             const Battlefield* battlefield_,
-            const std::vector<std::shared_ptr<AttackLog>> attackLogs_,
-            std::vector<std::tuple<Schema::Action, std::shared_ptr<Schema::ActionMask>, std::shared_ptr<Schema::BattlefieldState>>> transitions_,
+            std::vector<std::shared_ptr<AttackLog>> attackLogs_,
+            Schema::V13::StateTransitions transitions_,
+            const Schema::V13::PackedActionMask* packedmask_,
             CombatResult result
-        ) : colorname(colorname_),
+        ) : colorname(std::move(colorname_)),
             side(side_),
             gstats(gstats_),
             lpstats(lpstats_),
             rpstats(rpstats_),
             battlefield(battlefield_),
-            attackLogs(attackLogs_),
-            transitions(transitions_),
+            attackLogs(std::move(attackLogs_)),
+            transitions(std::move(transitions_)),
+            packedmask(packedmask_),
             ended(result != CombatResult::NONE),
             victory(EI(result) == EI(side))
         {};
@@ -74,6 +76,7 @@ namespace MMAI::BAI::V13 {
         const Schema::V13::IPlayerStats* getLeftPlayerStats() const override { return lpstats; }
         const Schema::V13::IPlayerStats* getRightPlayerStats() const override { return rpstats; }
         const std::string getAnsiRender() const override { return ansiRender; }
+        const Schema::V13::PackedActionMask* getPackedActionMask() const override { return packedmask; }
 
         const std::string colorname;
         const Side side;
@@ -84,7 +87,8 @@ namespace MMAI::BAI::V13 {
         const std::vector<std::shared_ptr<AttackLog>> attackLogs;
         const bool ended = false;
         const bool victory = false;
-        const std::vector<std::tuple<Schema::Action, std::shared_ptr<Schema::ActionMask>, std::shared_ptr<Schema::BattlefieldState>>> transitions;
+        const Schema::V13::StateTransitions transitions; // pointers into State's TransitionPool
+        const Schema::V13::PackedActionMask* const packedmask; // State's mask
 
         // Optionally modified (during activeStack if action was invalid)
         ErrorCode errcode = ErrorCode::OK;
@@ -15,11 +15,39 @@
 // =============================================================================
 
 #include "StdInc.h"
+#include "mapObjects/CGHeroInstance.h"
+
+#include "BAI/v13/util.h"
 
 namespace MMAI::BAI::V13 {
     namespace Util {
         int Damp(int v, int max) {
             return std::round(max * std::tanh(static_cast<double>(v) / max));
         }
+
+        uint64_t SpellStateFingerprint(const CPlayerBattleCallback* battle, const CStack* astack) {
+            uint64_t res = 0;
+            auto mix = [&res](uint64_t v) {
+                res ^= v + 0x9e3779b97f4a7c15ULL + (res << 6) + (res >> 2);
+            };
+
+            if (const auto *hero = battle->battleGetMyHero())
+                mix(hero->mana);
+
+            mix(astack->unitId());
+            mix(astack->waitedThisTurn);
+
+            for (const auto *cstack : battle->battleGetAllStacks(true)) {
+                mix(cstack->unitId());
+                mix(cstack->alive());
+                mix(cstack->getCount());
+                mix(cstack->getFirstHPleft());
+                mix(cstack->getPosition().toInt());
+                mix(cstack->getTreeVersion());
+            }
+
+            mix(battle->battleGetAllObstacles().size());
+            return res;
+        }
     }
 }
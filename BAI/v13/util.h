@@ -16,8 +16,17 @@
 
 #pragma once
 
+#include "CStack.h"
+#include "battle/CPlayerBattleCallback.h"
+
 namespace MMAI::BAI::V13 {
     namespace Util {
         int Damp(int v, int max);
+
+        // Covers what BattleAI's spell evaluation depends on: mana, units,
+        // their bonuses (spell effects, incl. their durations), obstacles
+        // and the active stack (a spell is cast only if it beats the best
+        // action of that stack, which also depends on whether it waited).
+        uint64_t SpellStateFingerprint(const CPlayerBattleCallback* battle, const CStack* astack);
     }
 }
@@ -0,0 +1,142 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#include "StdInc.h"
+
+#include "BAI/worker_pool.h"
+
+namespace MMAI::BAI {
+    static std::unique_ptr<WorkerPool> sharedPool;
+    static std::once_flag sharedPoolFlag;
+
+    WorkerPool::WorkerPool(int threads) {
+        for (int i=1; i<threads; ++i)
+            workers.emplace_back([this] { loop(); });
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            auto lock = std::lock_guard(mutex);
+            stopping = true;
+        }
+
+        cv.notify_all();
+        for (auto &t : workers)
+            t.join();
+    }
+
+    void WorkerPool::work(Job &job) {
+        while (true) {
+            int i = job.next.fetch_add(1);
+            if (i >= job.n)
+                return;
+
+            try {
+                job.fn(i);
+            } catch (...) {
+                job.errors.at(i) = std::current_exception();
+            }
+
+            if (job.done.fetch_add(1) + 1 == job.n) {
+                auto lock = std::lock_guard(job.mutex);
+                job.cv.notify_all();
+            }
+        }
+    }
+
+    void WorkerPool::loop() {
+        while (true) {
+            std::shared_ptr<Job> job;
+
+            {
+                auto lock = std::unique_lock(mutex);
+                cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+
+                job = jobs.front();
+
+                // All indexes claimed => nothing left for other workers
+                if (job->next.load() >= job->n) {
+                    jobs.pop_front();
+                    continue;
+                }
+            }
+
+            work(*job);
+        }
+    }
+
+    void WorkerPool::run(int n, const std::function<void(int)> &fn) {
+        if (n <= 0)
+            return;
+
+        auto job = std::make_shared<Job>(n, fn);
+
+        if (n > 1 && !workers.empty()) {
+            {
+                auto lock = std::lock_guard(mutex);
+                jobs.push_back(job);
+            }
+            cv.notify_all();
+        }
+
+        work(*job);
+
+        {
+            auto lock = std::unique_lock(job->mutex);
+            job->cv.wait(lock, [&job] { return job->done.load() == job->n; });
+        }
+
+        {
+            auto lock = std::lock_guard(mutex);
+            auto it = std::find(jobs.begin(), jobs.end(), job);
+            if (it != jobs.end())
+                jobs.erase(it);
+        }
+
+        for (auto &e : job->errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+
+    // static
+    void WorkerPool::Configure(int threads) {
+        std::call_once(sharedPoolFlag, [threads] {
+            if (threads > 1) {
+                sharedPool = std::make_unique<WorkerPool>(threads);
+                logAi->info("MMAI: using %d threads for battlefield construction", threads);
+            }
+        });
+    }
+
+    // static
+    WorkerPool* WorkerPool::Shared() {
+        return sharedPool.get();
+    }
+
+    // static
+    void WorkerPool::ParallelFor(WorkerPool* pool, int n, const std::function<void(int)> &fn) {
+        if (pool) {
+            pool->run(n, fn);
+            return;
+        }
+
+        for (int i=0; i<n; ++i)
+            fn(i);
+    }
+}
@@ -0,0 +1,87 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MMAI::BAI {
+    /*
+     * A small fixed-size thread pool for data-parallel loops.
+     *
+     * run(n, fn) calls fn(i) for each i in [0, n) and blocks until all
+     * calls have completed. The calling thread participates, and idle
+     * threads claim the next unclaimed index, so the execution order is
+     * unspecified. Callers get deterministic results by writing only to
+     * per-index outputs and merging them in index order afterwards.
+     *
+     * If any call throws, the exception from the lowest index is
+     * rethrown (after all other calls have completed).
+     *
+     * Multiple threads may call run() concurrently.
+     */
+    class WorkerPool {
+    public:
+        // `threads` is the total parallelism (including the caller)
+        explicit WorkerPool(int threads);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        void run(int n, const std::function<void(int)> &fn);
+        int size() const { return static_cast<int>(workers.size()) + 1; }
+
+        // Process-wide pool used for Battlefield construction.
+        // Configure() takes effect only once; threads <= 1 means disabled.
+        static void Configure(int threads);
+        static WorkerPool* Shared();  // nullptr if disabled
+
+        // Runs serially (in index order) if pool is nullptr
+        static void ParallelFor(WorkerPool* pool, int n, const std::function<void(int)> &fn);
+
+    private:
+        struct Job {
+            Job(int n_, const std::function<void(int)> &fn_) : n(n_), fn(fn_), errors(n_) {}
+
+            const int n;
+            const std::function<void(int)> &fn;
+            std::atomic<int> next {0};
+            std::atomic<int> done {0};
+            std::vector<std::exception_ptr> errors;  // index=call
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        void work(Job &job);
+        void loop();
+
+        std::vector<std::thread> workers;
+        std::deque<std::shared_ptr<Job>> jobs;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stopping = false;
+    };
+}
@@ -629,6 +629,38 @@ namespace MMAI::Schema::V13 {
     using StateTransition = std::tuple<Action, ActionMask*, BattlefieldState*>;
     using StateTransitions = std::vector<StateTransition>;
 
+    /*
+     * The action mask as a uint64 bitmap, where bit `i` is
+     * `(actions[i/64] >> (i%64)) & 1` (global actions followed by the
+     * [hex][HexAction] actions, as in ActionMask).
+     */
+    struct PackedActionMask {
+        static constexpr int N_GLOBAL = EI(GlobalAction::_count);
+        static constexpr int N_HEX = EI(HexAction::_count);
+        static constexpr int N_ACTIONS = N_GLOBAL + 165*N_HEX;
+
+        std::array<uint64_t, (N_ACTIONS + 63) / 64> actions = {};
+
+        bool test(int action) const {
+            return (actions[action >> 6] >> (action & 63)) & 1;
+        }
+
+        void set(int action) {
+            actions[action >> 6] |= uint64_t(1) << (action & 63);
+        }
+
+        void clear() {
+            *this = PackedActionMask{};
+        }
+
+        void assign(const ActionMask &mask) {
+            clear();
+            for (size_t i = 0; i < mask.size(); ++i)
+                if (mask[i])
+                    set(i);
+        }
+    };
+
     // This is returned as std::any by IState
     // => MMAI_DLL_LINKAGE is needed to ensure std::any_cast sees the same symbol
     class MMAI_DLL_LINKAGE ISupplementaryData {
@@ -650,7 +682,11 @@ namespace MMAI::Schema::V13 {
         virtual const AttackLogs getAttackLogs() const = 0;
         virtual const std::string getAnsiRender() const = 0;
         virtual const StateTransitions getStateTransitions() const = 0;
+
         virtual ~ISupplementaryData() = default;
 
+        // The action mask as bitmaps (nullptr if not available)
+        // NOTE: declared last to keep the vtable layout of older versions
+        virtual const PackedActionMask* getPackedActionMask() const { return nullptr; }
     };
 }
@@ -0,0 +1,185 @@
+// Heap allocation budgets per decision stage (see BAI/alloc_stats.h).
+//
+// The counts are available only in ENABLE_MMAI_ALLOC_STATS builds, so all
+// tests here are skipped otherwise. Battle-based tests also need the VCMI
+// game data.
+//
+// Budgets apply to a single call in steady state, i.e. after the first
+// turns of a battle have warmed up the arenas and caches. STATE and
+// SUPDATA are exact: the arenas, pools and buffers they use are reused,
+// and the only allocation is the SupplementaryData object itself.
+// BATTLEFIELD is dominated by VCMI's battle queries (reachability, damage
+// estimation, turn order), which allocate per call. When allocations are
+// removed from a stage, lower its budget so they can't creep back in.
+// Failures include the actual counts of all stages.
+
+#include "BAI/alloc_stats.h"
+#include "BAI/arena.h"
+#include "BAI/model/ModelUtil.h"
+#include "BAI/v13/links.h"
+#include "BAI/v13/state.h"
+#include "test/battle_fixture.h"
+#include "test/googletest/googletest/include/gtest/gtest.h"
+#include <random>
+
+using namespace MMAI::Test;
+namespace AllocStats = MMAI::BAI::AllocStats;
+namespace ModelUtil = MMAI::BAI::ModelUtil;
+using Stage = AllocStats::Stage;
+
+namespace {
+  struct Budget {
+    Stage stage;
+    uint64_t allocs;            // per call...
+    uint64_t allocsPerStack;    // ...plus this many per stack on the battlefield
+  };
+
+  // INPUTS is not covered here as it requires a model (see mmai-replay).
+  // SAMPLING is required to be allocation-free (see SamplingIsAllocationFree).
+  const auto BUDGETS = std::vector<Budget>{
+    {Stage::BATTLEFIELD, 2000, 400},
+    {Stage::STATE, 0, 0},
+    {Stage::SUPDATA, 1, 0},
+  };
+
+  using Counts = std::array<AllocStats::Counters, static_cast<int>(Stage::_count)>;
+
+  Counts Snapshot() {
+    auto res = Counts{};
+    for (size_t i = 0; i < res.size(); ++i)
+      res.at(i) = AllocStats::Get(static_cast<Stage>(i));
+    return res;
+  }
+
+  std::string Describe(const Counts &counts) {
+    auto res = std::string{};
+    for (size_t i = 0; i < counts.size(); ++i) {
+      auto &c = counts.at(i);
+      res += boost::str(boost::format("\n  stage %d: calls=%d allocs=%d frees=%d bytes=%d")
+        % i % c.calls % c.allocs % c.frees % c.bytes);
+    }
+    return res;
+  }
+
+  bool HaveLibrary() {
+    try {
+      BattleFixture::InitLibrary();
+      return true;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+}
+
+TEST(AllocStats, SamplingIsAllocationFree) {
+  if (!AllocStats::ENABLED)
+    GTEST_SKIP() << "requires ENABLE_MMAI_ALLOC_STATS";
+
+  auto rng = std::mt19937(0);
+  auto dist = std::uniform_real_distribution<float>(-5, 5);
+  auto a0 = std::vector<float>(4);
+  auto h1 = std::vector<float>(165);
+  auto h2 = std::vector<float>(165);
+  auto m0 = std::vector<int32_t>(4, 1);
+  auto m1 = std::vector<int32_t>(4*165, 1);
+  auto m2 = std::vector<int32_t>(4*165*165, 1);
+
+  for (auto *v : {&a0, &h1, &h2})
+    for (auto &x : *v)
+      x = dist(rng);
+
+  AllocStats::Reset();
+
+  for (auto temperature : {0.0f, 1.0f, 1e9f}) {
+    for (int i = 0; i < 100; ++i)
+      ModelUtil::sample_triplet(a0.data(), h1.data(), h2.data(), m0.data(), m1.data(), m2.data(), temperature, rng);
+  }
+
+  auto counts = Snapshot();
+  ASSERT_EQ(counts.at(static_cast<int>(Stage::SAMPLING)).calls, 300u);
+  ASSERT_EQ(counts.at(static_cast<int>(Stage::SAMPLING)).allocs, 0u) << Describe(counts);
+}
+
+// The per-turn object graph (here: links) is built in an arena, kept alive
+// until the next turn's graph is built (as State::battlefield is).
+TEST(AllocStats, ArenaReuseIsAllocationFree) {
+  if (!AllocStats::ENABLED)
+    GTEST_SKIP() << "requires ENABLE_MMAI_ALLOC_STATS";
+
+  auto arenas = MMAI::BAI::ArenaPool{};
+  auto current = std::shared_ptr<MMAI::BAI::V13::Links>{};
+
+  auto turn = [&arenas, &current] {
+    auto &arena = arenas.next();
+    auto links = arena.make_shared<MMAI::BAI::V13::Links>(arena);
+    for (int i = 0; i < 10000; ++i)
+      links->add(i % 165, (i * 7) % 165, 1);
+    current = links;
+  };
+
+  // Warm-up: two arenas, each grown and then coalesced on reuse
+  for (int i = 0; i < 4; ++i)
+    turn();
+
+  AllocStats::Reset();
+
+  for (int i = 0; i < 10; ++i) {
+    auto scope = AllocStats::Scope(Stage::BATTLEFIELD);
+    turn();
+  }
+
+  auto counts = Snapshot();
+  ASSERT_EQ(arenas.size(), 2u);
+  ASSERT_EQ(counts.at(static_cast<int>(Stage::BATTLEFIELD)).calls, 10u);
+  ASSERT_EQ(counts.at(static_cast<int>(Stage::BATTLEFIELD)).allocs, 0u) << Describe(counts);
+}
+
+TEST(AllocStats, SteadyStateBudgets) {
+  if (!AllocStats::ENABLED)
+    GTEST_SKIP() << "requires ENABLE_MMAI_ALLOC_STATS";
+
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  for (uint32_t seed = 0; seed < 4; ++seed) {
+    auto spec = BattleSpec::Random(7, 1, seed);
+    spec.obstacles = 3;
+    spec.siege = (seed % 2 == 1);
+    spec.sides.at(0).warMachines = true;
+
+    auto nstacks = size_t(0);
+    for (auto &side : spec.sides)
+      nstacks += side.stacks.size() + (side.warMachines ? 3 : 0);
+
+    auto fixture = BattleFixture(spec);
+    auto state = MMAI::BAI::V13::State(13, "red", fixture.callback(BattleSide::LEFT_SIDE));
+    auto *astack = fixture.activeStack();
+
+    // Warm-up
+    state.onActiveStack(astack);
+    state.onActiveStack(astack);
+
+    auto first = Counts{};
+
+    for (int i = 0; i < 5; ++i) {
+      AllocStats::Reset();
+      state.onActiveStack(astack);
+      auto counts = Snapshot();
+
+      for (auto &b : BUDGETS) {
+        auto &c = counts.at(static_cast<int>(b.stage));
+        auto budget = b.allocs + b.allocsPerStack * nstacks;
+        ASSERT_LE(c.allocs, budget) << "seed " << seed << ", stage " << static_cast<int>(b.stage) << Describe(counts);
+      }
+
+      // The same turn repeated must not allocate more each time
+      if (i == 0) {
+        first = counts;
+        continue;
+      }
+
+      for (size_t s = 0; s < counts.size(); ++s)
+        ASSERT_LE(counts.at(s).allocs, first.at(s).allocs) << "seed " << seed << ", call " << i << Describe(counts);
+    }
+  }
+}
@@ -0,0 +1,295 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#include "StdInc.h"
+#include "CCreatureHandler.h"
+#include "CStack.h"
+#include "GameLibrary.h"
+#include "ObstacleHandler.h"
+#include "battle/BattleLayout.h"
+#include "battle/CObstacleInstance.h"
+#include "battle/Unit.h"
+#include "json/JsonNode.h"
+
+#include "common.h"
+#include "test/battle_fixture.h"
+
+namespace MMAI::Test {
+    namespace {
+        // Standard starting rows for 1..7 stacks (as in VCMI's default layout)
+        const std::array<std::vector<int>, 7> STACK_ROWS = {{
+            {5},
+            {2, 8},
+            {0, 5, 10},
+            {0, 4, 6, 10},
+            {0, 2, 5, 8, 10},
+            {0, 2, 4, 6, 8, 10},
+            {0, 2, 4, 5, 6, 8, 10},
+        }};
+
+        // Rows for summoned stacks, in front of the regular ones
+        const std::vector<int> SUMMON_ROWS = {1, 9, 3, 7, 5, 0, 10};
+
+        // Typical army sizes by creature level
+        const std::array<int, 8> LEVEL_COUNTS = {0, 60, 35, 20, 12, 8, 5, 2};
+
+        // VCMI hex numbering (i.e. including the "side" columns)
+        int DefaultHex(BattleSide side, int row, bool summoned) {
+            constexpr int W = GameConstants::BFIELD_WIDTH;
+            int x = summoned ? 3 : 1;
+            return row*W + (side == BattleSide::LEFT_SIDE ? x : W-1-x);
+        }
+    }
+
+    // Supplies the side armies, players and town (normally obtained from
+    // the game state via the game callback, which fixtures do not have)
+    class BattleFixture::Info : public BattleInfo {
+    public:
+        explicit Info(const BattleFixture &fixture_)
+        : BattleInfo(nullptr, BattleLayout())
+        , fixture(fixture_)
+        {}
+
+        const CArmedInstance * getSideArmy(BattleSide side) const override {
+            return fixture.armies.at(EI(side)).get();
+        }
+
+        const CGHeroInstance * getSideHero(BattleSide) const override {
+            return nullptr;
+        }
+
+        PlayerColor getSidePlayer(BattleSide side) const override {
+            return PlayerColor(EI(side));
+        }
+
+        const CGTownInstance * getDefendedTown() const override {
+            return fixture.town.get();
+        }
+
+    private:
+        const BattleFixture &fixture;
+    };
+
+    // static
+    void BattleFixture::InitLibrary() {
+        static std::once_flag flag;
+        std::call_once(flag, [] {
+            LIBRARY = new GameLibrary();
+            LIBRARY->initializeFilesystem(false);
+            LIBRARY->initializeLibrary();
+        });
+    }
+
+    // static
+    BattleSpec BattleSpec::Random(int nstacks, int nsummons, uint32_t seed) {
+        if (nstacks < 1 || nstacks > 7)
+            THROW_FORMAT("Bad nstacks: %d", nstacks);
+        if (nsummons < 0 || nsummons > static_cast<int>(SUMMON_ROWS.size()))
+            THROW_FORMAT("Bad nsummons: %d", nsummons);
+
+        auto creatures = std::vector<const CCreature*>{};
+        for (auto &c : LIBRARY->creh->objects) {
+            if (c && !c->special && c->getLevel() >= 1 && c->getLevel() <= 7)
+                creatures.push_back(c.get());
+        }
+
+        if (creatures.empty())
+            throw std::runtime_error("No creatures loaded (was InitLibrary called?)");
+
+        auto rng = std::mt19937(seed);
+        auto cdist = std::uniform_int_distribution<int>(0, creatures.size() - 1);
+        auto mdist = std::uniform_real_distribution<double>(0.5, 1.5);
+
+        auto randomStack = [&](bool summoned) {
+            auto *c = creatures.at(cdist(rng));
+            auto count = std::max<int>(1, LEVEL_COUNTS.at(c->getLevel()) * mdist(rng));
+            return StackSpec{c->getId(), count, -1, summoned};
+        };
+
+        auto res = BattleSpec{};
+        res.seed = seed;
+
+        for (auto &side : res.sides) {
+            for (int i=0; i<nstacks; ++i)
+                side.stacks.push_back(randomStack(false));
+            for (int i=0; i<nsummons; ++i)
+                side.stacks.push_back(randomStack(true));
+        }
+
+        return res;
+    }
+
+    BattleFixture::BattleFixture(const BattleSpec &spec) {
+        for (int i=0; i<2; ++i) {
+            armies.at(i) = std::make_unique<CArmedInstance>(nullptr);
+            armies.at(i)->tempOwner = PlayerColor(i);
+        }
+
+        if (spec.siege)
+            setupSiege();
+
+        info = std::make_unique<Info>(*this);
+        info->battleID = BattleID(0);
+        info->round = 1;
+        info->localInit();
+
+        addStacks(BattleSide::LEFT_SIDE, spec.sides.at(0));
+        addStacks(BattleSide::RIGHT_SIDE, spec.sides.at(1));
+        addObstacles(spec.obstacles, spec.seed);
+
+        if (spec.siege) {
+            for (auto part : {EWallPart::KEEP, EWallPart::BOTTOM_TOWER, EWallPart::BOTTOM_WALL, EWallPart::BELOW_GATE, EWallPart::OVER_GATE, EWallPart::UPPER_WALL, EWallPart::UPPER_TOWER})
+                info->setWallState(part, EWallState::INTACT);
+            info->setGateState(EGateState::CLOSED);
+        }
+
+        for (int i=0; i<2; ++i)
+            callbacks.at(i) = std::make_unique<CPlayerBattleCallback>(info.get(), PlayerColor(i));
+
+        auto queue = std::vector<battle::Units>{};
+        callbacks.at(0)->battleGetTurnOrder(queue, 1, 0);
+        if (queue.empty() || queue.front().empty())
+            throw std::runtime_error("Fixture has no units to act");
+
+        info->activeStack = queue.front().front()->unitId();
+    }
+
+    BattleFixture::~BattleFixture() {
+        // callbacks refer to info, info refers to armies and town
+        for (auto &cb : callbacks)
+            cb.reset();
+        info.reset();
+    }
+
+    const CPlayerBattleCallback* BattleFixture::callback(BattleSide side) const {
+        return callbacks.at(EI(side)).get();
+    }
+
+    const CStack* BattleFixture::activeStack() const {
+        return info->battleGetStackByID(info->activeStack, false);
+    }
+
+    BattleInfo* BattleFixture::battleInfo() const {
+        return info.get();
+    }
+
+    void BattleFixture::addStacks(BattleSide side, const SideSpec &spec) {
+        int nregular = 0;
+        int nsummoned = 0;
+        for (auto &s : spec.stacks)
+            s.summoned ? ++nsummoned : ++nregular;
+
+        if (nregular > 7)
+            THROW_FORMAT("Too many stacks: %d", nregular);
+        if (nsummoned > static_cast<int>(SUMMON_ROWS.size()))
+            THROW_FORMAT("Too many summoned stacks: %d", nsummoned);
+
+        auto add = [this, side](CreatureID creature, int count, int hex, bool summoned) {
+            auto ui = battle::UnitInfo();
+            ui.id = info->nextUnitId();
+            ui.count = count;
+            ui.type = creature;
+            ui.side = side;
+            ui.position = BattleHex(hex);
+            ui.summoned = summoned;
+
+            auto data = JsonNode();
+            ui.save(data);
+            info->addUnit(ui.id, data);
+        };
+
+        int iregular = 0;
+        int isummoned = 0;
+        for (auto &s : spec.stacks) {
+            auto hex = s.hex;
+            if (hex == -1) {
+                hex = s.summoned
+                    ? DefaultHex(side, SUMMON_ROWS.at(isummoned++), true)
+                    : DefaultHex(side, STACK_ROWS.at(nregular-1).at(iregular++), false);
+            }
+            add(s.creature, s.count, hex, s.summoned);
+        }
+
+        if (spec.warMachines) {
+            bool left = (side == BattleSide::LEFT_SIDE);
+            add(CreatureID::BALLISTA, 1, left ? 52 : 66, false);
+            add(CreatureID::AMMO_CART, 1, left ? 18 : 32, false);
+            add(CreatureID::FIRST_AID_TENT, 1, left ? 154 : 168, false);
+        }
+    }
+
+    // Random usual (non-absolute) obstacles, not overlapping any unit
+    void BattleFixture::addObstacles(int n, uint32_t seed) {
+        if (n <= 0)
+            return;
+
+        auto candidates = std::vector<const ObstacleInfo*>{};
+        for (auto &obi : LIBRARY->obstacleHandler->objects) {
+            if (obi && !obi->isAbsoluteObstacle)
+                candidates.push_back(obi.get());
+        }
+
+        if (candidates.empty())
+            throw std::runtime_error("No obstacles loaded (was InitLibrary called?)");
+
+        auto occupied = std::set<BattleHex>{};
+        for (auto *unit : info->battleGetAllUnits()) {
+            for (auto &bh : unit->getHexes())
+                occupied.insert(bh);
+        }
+
+        auto rng = std::mt19937(seed);
+        auto odist = std::uniform_int_distribution<int>(0, candidates.size() - 1);
+        auto xdist = std::uniform_int_distribution<int>(4, GameConstants::BFIELD_WIDTH - 5);
+        auto ydist = std::uniform_int_distribution<int>(0, GameConstants::BFIELD_HEIGHT - 1);
+
+        // Bounded number of attempts, as not every placement fits
+        for (int attempt = 0, added = 0; added < n && attempt < 100*n; ++attempt) {
+            auto obstacle = std::make_shared<CObstacleInstance>();
+            obstacle->ID = candidates.at(odist(rng))->obstacle;
+            obstacle->pos = BattleHex(xdist(rng), ydist(rng));
+            obstacle->obstacleType = CObstacleInstance::USUAL;
+            obstacle->uniqueID = info->obstacles.size();
+
+            bool ok = true;
+            for (auto &bh : obstacle->getBlockedTiles()) {
+                if (!bh.isAvailable() || occupied.count(bh)) {
+                    ok = false;
+                    break;
+                }
+            }
+
+            if (!ok)
+                continue;
+
+            for (auto &bh : obstacle->getBlockedTiles())
+                occupied.insert(bh);
+
+            info->obstacles.push_back(obstacle);
+            ++added;
+        }
+    }
+
+    // A fully built castle (walls, towers and gate) owned by the defender
+    void BattleFixture::setupSiege() {
+        town = std::make_unique<CGTownInstance>(nullptr);
+        town->setType(Obj::TOWN, FactionID::CASTLE);
+        town->tempOwner = PlayerColor(1);
+
+        for (auto bid : {BuildingID::FORT, BuildingID::CITADEL, BuildingID::CASTLE})
+            town->addBuilding(bid);
+    }
+}
@@ -0,0 +1,85 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#pragma once
+
+#include "battle/BattleInfo.h"
+#include "battle/CPlayerBattleCallback.h"
+#include "constants/EntityIdentifiers.h"
+#include "mapObjects/CArmedInstance.h"
+#include "mapObjects/CGTownInstance.h"
+
+// In-memory battles for tests and benchmarks.
+//
+// A BattleFixture owns a VCMI BattleInfo populated directly (no game
+// state, map or heroes involved), so Battlefield, State and the BAI
+// can be driven deterministically outside of a running game.
+// The VCMI game data must be available (see InitLibrary).
+namespace MMAI::Test {
+    struct StackSpec {
+        CreatureID creature;
+        int count;
+        int hex = -1;           // -1 => standard starting position
+        bool summoned = false;
+    };
+
+    struct SideSpec {
+        std::vector<StackSpec> stacks;
+        bool warMachines = false;   // ballista, ammo cart, first aid tent
+    };
+
+    struct BattleSpec {
+        std::array<SideSpec, 2> sides;  // [0] = attacker (left), [1] = defender
+        int obstacles = 0;              // number of random (usual) obstacles
+        bool siege = false;             // defender is a castle with intact walls
+        uint32_t seed = 0;              // obstacle placement
+
+        // Random non-special creatures with level-dependent counts.
+        // `nstacks` regular stacks (1..7) and `nsummons` summoned
+        // stacks per side.
+        static BattleSpec Random(int nstacks, int nsummons, uint32_t seed);
+    };
+
+    class BattleFixture {
+    public:
+        // Loads the VCMI game data (once per process).
+        // Must be called before any fixture is created.
+        static void InitLibrary();
+
+        explicit BattleFixture(const BattleSpec &spec);
+        ~BattleFixture();
+
+        // The battle as seen by the given side
+        const CPlayerBattleCallback* callback(BattleSide side) const;
+
+        // The first stack in the turn queue
+        const CStack* activeStack() const;
+
+        BattleInfo* battleInfo() const;
+
+    private:
+        class Info;
+
+        std::array<std::unique_ptr<CArmedInstance>, 2> armies;
+        std::unique_ptr<CGTownInstance> town;
+        std::unique_ptr<Info> info;
+        std::array<std::unique_ptr<CPlayerBattleCallback>, 2> callbacks;
+
+        void addStacks(BattleSide side, const SideSpec &spec);
+        void addObstacles(int n, uint32_t seed);
+        void setupSiege();
+    };
+}
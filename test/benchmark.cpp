@@ -0,0 +1,234 @@
+#include "BAI/model/ModelUtil.h"
+#include "BAI/v13/encoder.h"
+#include "BAI/v13/state.h"
+#include "schema/v13/constants.h"
+#include "schema/v13/types.h"
+#include "test/battle_fixture.h"
+#include <benchmark/benchmark.h>
+#include <random>
+
+using Encoder = MMAI::BAI::V13::Encoder;
+using namespace MMAI::Schema::V13;
+namespace ModelUtil = MMAI::BAI::ModelUtil;
+
+//
+// Microbenchmarks for the per-decision hot paths:
+// observation encoding, graph input building and action sampling.
+//
+// Example:
+// MMAI_bench --benchmark_format=json --benchmark_out=mmai_bench.json
+//
+
+namespace {
+    bool IsStrict(Encoding e) {
+        switch (e) {
+            case Encoding::ACCUMULATING_STRICT_NULL:
+            case Encoding::BINARY_STRICT_NULL:
+            case Encoding::CATEGORICAL_STRICT_NULL:
+            case Encoding::EXPNORM_STRICT_NULL:
+            case Encoding::LINNORM_STRICT_NULL:
+            case Encoding::EXPBIN_STRICT_NULL:
+            case Encoding::ACCUMULATING_EXPBIN_STRICT_NULL:
+            case Encoding::LINBIN_STRICT_NULL:
+            case Encoding::ACCUMULATING_LINBIN_STRICT_NULL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Random graph with `nedges` edges per link type
+    std::array<ModelUtil::IndexContainer, ModelUtil::LT_COUNT> MakeContainers(int nedges, uint32_t seed) {
+        auto rng = std::mt19937(seed);
+        auto hexdist = std::uniform_int_distribution<int>(0, 164);
+        auto attrdist = std::uniform_real_distribution<float>(0, 1);
+        auto res = std::array<ModelUtil::IndexContainer, ModelUtil::LT_COUNT>{};
+
+        for (auto &c : res) {
+            auto dst = std::vector<int64_t>{};
+            for (int e = 0; e < nedges; ++e) {
+                c.ei.at(0).push_back(hexdist(rng));
+                c.ei.at(1).push_back(hexdist(rng));
+                c.ea.push_back(attrdist(rng));
+                dst.push_back(c.ei.at(1).back());
+            }
+            c.nbrs = ModelUtil::buildNBR_unpadded(dst);
+        }
+
+        return res;
+    }
+
+    // Buckets at 1x, 1.5x, 2x and 4x the required sizes (smallest one fits)
+    std::vector<std::vector<std::vector<int32_t>>> MakeBuckets(const std::array<ModelUtil::IndexContainer, ModelUtil::LT_COUNT> &containers) {
+        auto res = std::vector<std::vector<std::vector<int32_t>>>{};
+        for (auto mult : {1.0, 1.5, 2.0, 4.0}) {
+            auto bucket = std::vector<std::vector<int32_t>>{};
+            for (auto &c : containers) {
+                size_t kmax = 0;
+                for (auto &nbr : c.nbrs)
+                    kmax = std::max(kmax, nbr.size());
+                bucket.push_back({
+                    static_cast<int32_t>(c.ea.size() * mult),
+                    static_cast<int32_t>(kmax * mult)
+                });
+            }
+            res.push_back(bucket);
+        }
+        return res;
+    }
+}
+
+static void BM_Encode(benchmark::State& state) {
+    auto e = static_cast<Encoding>(state.range(0));
+    constexpr int n = 16;
+    constexpr int vmax = 15;
+    const int vmin = IsStrict(e) ? 0 : -1;
+
+    auto vec = std::vector<float>{};
+    vec.reserve(n);
+    int v = vmin;
+
+    for (auto _ : state) {
+        vec.clear();
+        Encoder::Encode("bench", 0, e, n, vmax, 1.0, v, vec);
+        benchmark::DoNotOptimize(vec.data());
+        v = (v == vmax - 1) ? vmin : v + 1;
+    }
+
+    state.SetLabel(IsStrict(e) ? "strict" : "");
+}
+BENCHMARK(BM_Encode)->DenseRange(0, static_cast<int>(Encoding::RAW));
+
+// Encodes all attributes of all 165 hexes, as State does for each
+// observation. The attribute values are synthetic, but they cover each
+// attribute's full value range (see BM_StateOnActiveStack for real ones).
+static void BM_EncodeHexes(benchmark::State& state) {
+    auto values = std::vector<int>{};
+    for (int ihex = 0; ihex < 165; ++ihex) {
+        for (int iattr = 0; iattr < EI(HexAttribute::_count); ++iattr) {
+            auto vmax = std::get<3>(HEX_ENCODING.at(iattr));
+            values.push_back((ihex*31 + iattr*17) % (vmax + 1));
+        }
+    }
+
+    auto vec = std::vector<float>{};
+    vec.reserve(BATTLEFIELD_STATE_SIZE);
+
+    for (auto _ : state) {
+        vec.clear();
+        auto it = values.begin();
+        for (int ihex = 0; ihex < 165; ++ihex)
+            for (int iattr = 0; iattr < EI(HexAttribute::_count); ++iattr)
+                Encoder::Encode(static_cast<HexAttribute>(iattr), *it++, vec);
+        benchmark::DoNotOptimize(vec.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * 165);
+}
+BENCHMARK(BM_EncodeHexes);
+
+static void BM_BuildNBR(benchmark::State& state) {
+    auto rng = std::mt19937(42);
+    auto hexdist = std::uniform_int_distribution<int>(0, 164);
+    auto dst = std::vector<int64_t>(state.range(0));
+    for (auto &d : dst)
+        d = hexdist(rng);
+
+    for (auto _ : state) {
+        auto nbr = ModelUtil::buildNBR_unpadded(dst);
+        benchmark::DoNotOptimize(nbr.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BuildNBR)->RangeMultiplier(4)->Range(256, 16384);
+
+// range(0): edges per link type
+// range(1): bucket index (-1 = smallest that fits)
+static void BM_BuildFlattened(benchmark::State& state) {
+    auto containers = MakeContainers(state.range(0), 42);
+    auto buckets = MakeBuckets(containers);
+    auto bucket = static_cast<int>(state.range(1));
+
+    for (auto _ : state) {
+        auto out = ModelUtil::build_flattened(containers, buckets, bucket);
+        benchmark::DoNotOptimize(out.ea_flat.data());
+    }
+}
+BENCHMARK(BM_BuildFlattened)->ArgsProduct({{256, 1024, 4096}, {-1, 1, 2, 3}});
+
+// range(0): temperature * 1000 (0 = greedy, 1e9 = uniform)
+static void BM_SampleTriplet(benchmark::State& state) {
+    auto rng = std::mt19937(42);
+    auto logitdist = std::normal_distribution<float>(0, 3);
+    auto maskdist = std::bernoulli_distribution(0.3);
+
+    auto a0_log = std::vector<float>(4);
+    auto h1_log = std::vector<float>(165);
+    auto h2_log = std::vector<float>(165);
+    auto m_a0 = std::vector<int32_t>(4, 1);
+    auto m_h1 = std::vector<int32_t>(4*165);
+    auto m_h2 = std::vector<int32_t>(4*165*165);
+
+    for (auto *vec : {&a0_log, &h1_log, &h2_log})
+        for (auto &x : *vec)
+            x = logitdist(rng);
+
+    for (auto *vec : {&m_h1, &m_h2})
+        for (auto &x : *vec)
+            x = maskdist(rng);
+
+    auto temperature = static_cast<float>(state.range(0)) / 1000;
+
+    for (auto _ : state) {
+        auto res = ModelUtil::sample_triplet(
+            a0_log.data(), h1_log.data(), h2_log.data(),
+            m_a0.data(), m_h1.data(), m_h2.data(),
+            temperature, rng
+        );
+        benchmark::DoNotOptimize(res);
+    }
+}
+BENCHMARK(BM_SampleTriplet)->Arg(0)->Arg(1000)->Arg(1000000000000);
+
+// Full observation for a synthetic battle: Battlefield construction,
+// encoding and (optionally) link building.
+// Requires the VCMI game data (skipped if it can't be loaded).
+// range(0): stacks per side (1..7)
+// range(1): summoned stacks per side
+// range(2): siege
+// range(3): build links
+static void BM_StateOnActiveStack(benchmark::State& state) {
+    using namespace MMAI::Test;
+
+    try {
+        BattleFixture::InitLibrary();
+    } catch (const std::exception &e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+
+    auto spec = BattleSpec::Random(state.range(0), state.range(1), 42);
+    spec.obstacles = 3;
+    spec.siege = state.range(2);
+    spec.sides.at(0).warMachines = true;
+
+    auto fixture = BattleFixture(spec);
+    auto bstate = std::make_unique<MMAI::BAI::V13::State>(13, "red", fixture.callback(BattleSide::LEFT_SIDE));
+    auto *astack = fixture.activeStack();
+
+    // Without links, the observation is recorded as a transition, as for
+    // another stack's turn (which requires its action to have started)
+    auto recording = !state.range(3);
+    if (recording)
+        bstate->startedAction = 0;
+
+    for (auto _ : state) {
+        bstate->onActiveStack(astack, CombatResult::NONE, recording);
+        benchmark::DoNotOptimize(bstate->getBattlefieldState());
+        bstate->transitions.clear();  // or it grows with each iteration
+    }
+}
+BENCHMARK(BM_StateOnActiveStack)->ArgsProduct({{1, 4, 7}, {0, 2}, {0, 1}, {0, 1}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,197 @@
+// Episodes written by the BAI (see BAI/episode_writer.h).
+// Needs the VCMI game data.
+
+#include "BAI/base.h"
+#include "BAI/episode_writer.h"
+#include "BAI/snapshot.h"
+#include "BAI/v13/state.h"
+#include "battle/BattleAction.h"
+#include "battle/BattleStateInfoForRetreat.h"
+#include "callback/CBattleCallback.h"
+#include "schema/v13/types.h"
+#include "test/battle_fixture.h"
+#include "test/googletest/googletest/include/gtest/gtest.h"
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+
+using namespace MMAI::Test;
+namespace BAI = MMAI::BAI;
+namespace Schema = MMAI::Schema;
+namespace fs = boost::filesystem;
+using EpisodeWriter = BAI::EpisodeWriter;
+
+namespace {
+  bool HaveLibrary() {
+    try {
+      BattleFixture::InitLibrary();
+      return true;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+
+  fs::path TempDir() {
+    auto res = fs::temp_directory_path() / fs::unique_path("mmai-episodes-%%%%-%%%%");
+    fs::create_directories(res);
+    return res;
+  }
+
+  struct Entry {
+    uint64_t episode;
+    uint32_t step;
+    uint32_t flags;
+    Schema::Action action;
+  };
+
+  // All entries in the shards in `dir` (a single shard is expected)
+  std::vector<Entry> ReadEntries(const fs::path &dir) {
+    auto res = std::vector<Entry>{};
+    for (auto &f : fs::directory_iterator(dir)) {
+      if (f.path().extension() != ".bin")
+        continue;
+
+      auto in = std::ifstream(f.path().string(), std::ios::binary);
+      auto data = std::vector<char>(std::istreambuf_iterator<char>(in), {});
+      auto offset = sizeof(BAI::Snapshot::FileHeader);
+
+      while (offset < data.size()) {
+        auto eh = EpisodeWriter::EntryHeader{};
+        auto rh = BAI::Snapshot::RecordHeader{};
+        std::memcpy(&eh, data.data() + offset, sizeof(eh));
+        std::memcpy(&rh, data.data() + offset + sizeof(eh), sizeof(rh));
+        res.push_back({eh.episode, eh.step, eh.flags, rh.action});
+        offset += eh.size;
+      }
+    }
+    return res;
+  }
+
+  // The first allowed hex action
+  Schema::Action FirstHexAction(const Schema::IState* s) {
+    const auto &mask = *s->getActionMask();
+    for (size_t i = EI(Schema::V13::GlobalAction::_count); i < mask.size(); ++i)
+      if (mask.at(i))
+        return i;
+    throw std::runtime_error("No hex action allowed");
+  }
+
+  // Plays the scripted actions, then the first allowed hex action
+  class ScriptedModel : public Schema::IModel {
+  public:
+    explicit ScriptedModel(std::vector<Schema::Action> actions_) : actions(std::move(actions_)) {}
+
+    Schema::ModelType getType() override { return Schema::ModelType::SCRIPTED; }
+    std::string getName() override { return "scripted"; }
+    int getVersion() override { return 13; }
+    double getValue(const Schema::IState*) override { return 0; }
+    Schema::Side getSide() override { return Schema::Side::BOTH; }
+
+    int getAction(const Schema::IState* s) override {
+      ++calls;
+      last = (next < actions.size()) ? actions.at(next++) : FirstHexAction(s);
+      return last;
+    }
+
+    int calls = 0;
+    Schema::Action last = -1;
+
+  private:
+    std::vector<Schema::Action> actions;
+    size_t next = 0;
+  };
+
+  // Collects the actions instead of sending them to a server
+  class TestCallback : public CBattleCallback {
+  public:
+    explicit TestCallback(PlayerColor player) : CBattleCallback(player, nullptr) {}
+
+    void battleMakeUnitAction(const BattleID &, const BattleAction &action) override {
+      actions.push_back(action);
+    }
+
+    std::optional<BattleAction> makeSurrenderRetreatDecision(const BattleID &, const BattleStateInfoForRetreat &) override {
+      return std::nullopt;
+    }
+
+    std::vector<BattleAction> actions;
+  };
+}
+
+TEST(EpisodeWriter, StepsAndFlags) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  auto dir = TempDir();
+  auto fixture = BattleFixture(BattleSpec::Random(2, 0, 0));
+  auto state = BAI::V13::State(13, "red", fixture.callback(BattleSide::LEFT_SIDE));
+  state.onActiveStack(fixture.activeStack());
+
+  {
+    auto writer = EpisodeWriter(dir.string(), EpisodeWriter::DEFAULT_SHARD_BYTES);
+    auto done = EpisodeWriter::Episode(writer);
+    done.onDecision(&state, 1);
+    done.onDecision(&state, 2);
+    done.onEnd(&state);
+
+    auto truncated = EpisodeWriter::Episode(writer);
+    truncated.onDecision(&state, 3);
+  }
+
+  auto entries = ReadEntries(dir);
+  fs::remove_all(dir);
+
+  ASSERT_EQ(entries.size(), 3u);
+  EXPECT_EQ(entries.at(0).step, 0u);
+  EXPECT_EQ(entries.at(0).flags, 0u);
+  EXPECT_EQ(entries.at(0).action, 1);
+  EXPECT_EQ(entries.at(1).step, 1u);
+  EXPECT_EQ(entries.at(1).flags, EpisodeWriter::DONE);
+  EXPECT_EQ(entries.at(1).action, 2);
+  EXPECT_NE(entries.at(2).episode, entries.at(0).episode);
+  EXPECT_EQ(entries.at(2).step, 0u);
+  EXPECT_EQ(entries.at(2).flags, EpisodeWriter::TRUNCATED);
+  EXPECT_EQ(entries.at(2).action, 3);
+}
+
+// An invalid action is retried within the same turn and must not become
+// a step of its own (only the accepted action is).
+TEST(EpisodeWriter, InvalidActionIsNotAStep) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  // Uses the process-wide writer, as the BAI does
+  auto dir = TempDir();
+  EpisodeWriter::Configure(dir.string(), EpisodeWriter::DEFAULT_SHARD_BYTES);
+  ASSERT_NE(EpisodeWriter::Shared(), nullptr);
+
+  auto fixture = BattleFixture(BattleSpec::Random(2, 0, 0));
+  auto *astack = fixture.activeStack();
+
+  // Makes WAIT invalid
+  fixture.battleInfo()->getStack(astack->unitId())->waitedThisTurn = true;
+
+  auto player = PlayerColor(EI(astack->unitSide()));
+  auto cb = std::make_shared<TestCallback>(player);
+  cb->onBattleStarted(fixture.battleInfo());
+
+  auto model = ScriptedModel({EI(Schema::V13::GlobalAction::WAIT)});
+
+  {
+    auto bai = BAI::Base::Create(&model, nullptr, cb, false);
+    bai->battleStart(fixture.battleInfo()->battleID, nullptr, nullptr, int3(), nullptr, nullptr, astack->unitSide(), false);
+    bai->activeStack(fixture.battleInfo()->battleID, astack);
+
+    ASSERT_EQ(model.calls, 2);
+    ASSERT_EQ(cb->actions.size(), 1u);
+  }
+
+  EpisodeWriter::Shared()->flush();
+  auto entries = ReadEntries(dir);
+  fs::remove_all(dir);
+
+  ASSERT_EQ(entries.size(), 1u);
+  EXPECT_EQ(entries.at(0).step, 0u);
+  EXPECT_EQ(entries.at(0).flags, EpisodeWriter::TRUNCATED);
+  EXPECT_EQ(entries.at(0).action, model.last);
+}
@@ -0,0 +1,630 @@
+// Differential equivalence tests: optimised code vs a frozen reference.
+//
+// - BuildNBR / BuildFlattened: ModelUtil vs the frozen copies in
+//   test/reference/model_util.h on randomized graphs
+// - BattlefieldReference: Battlefield::Create vs the frozen baseline copy
+//   in test/reference/v13 on randomized synthetic battles (hex and stack
+//   attributes, links)
+// - BattlefieldParallel: Battlefield::Create with a WorkerPool vs serial
+// - StateReference: complete State outputs (bfstate, actmask, links) vs
+//   the frozen baseline State on randomized synthetic battles
+// - StateRecording: State outputs on our turn with vs without recording
+//   the enemy's actions as transitions (ENABLE_ML vs regular builds)
+// - StateGolden: complete State outputs vs a golden snapshot file
+//   recorded from the frozen baseline State
+// - PackedActionMask: the packed bitmaps vs the plain action mask
+// - SampleTripletPackedMask: sampling with masks derived from a packed
+//   action mask vs sampling with the full int32 masks
+//
+// All comparisons are bit-exact. Failing randomized cases are shrunk to a
+// minimal failing input, which is included in the failure message.
+//
+// The battle tests need the VCMI game data and are skipped without it.
+// The golden file is (re)generated from the frozen baseline with:
+//   MMAI_EQUIV_GOLDEN=golden.bin MMAI_EQUIV_RECORD=1 MMAI_test --gtest_filter=Equivalence.StateGolden
+// and checked by running the same without MMAI_EQUIV_RECORD.
+
+#include "BAI/model/ModelUtil.h"
+#include "BAI/snapshot.h"
+#include "BAI/v13/battlefield.h"
+#include "BAI/v13/state.h"
+#include "battle/BattleAction.h"
+#include "test/battle_fixture.h"
+#include "test/googletest/googletest/include/gtest/gtest.h"
+#include "test/reference/model_util.h"
+#include "test/reference/v13/battlefield.h"
+#include "test/reference/v13/state.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+
+using namespace MMAI;
+using namespace MMAI::Test;
+namespace ModelUtil = MMAI::BAI::ModelUtil;
+
+namespace {
+  constexpr int RANDOM_CASES = 50;
+
+  // Named byte blobs: compared bit-exactly, reported by name on mismatch
+  using Fields = std::vector<std::pair<std::string, std::vector<uint8_t>>>;
+
+  template <typename T>
+  void AddField(Fields &fields, const std::string &name, const T* data, size_t n) {
+    auto bytes = std::vector<uint8_t>(n * sizeof(T));
+    if (n > 0)
+      std::memcpy(bytes.data(), data, bytes.size());
+    fields.emplace_back(name, std::move(bytes));
+  }
+
+  template <typename Container>
+  void AddField(Fields &fields, const std::string &name, const Container &c) {
+    AddField(fields, name, c.data(), c.size());
+  }
+
+  // Empty string if equal
+  std::string FirstDiff(const Fields &want, const Fields &have) {
+    if (want.size() != have.size())
+      return boost::str(boost::format("field count: want: %d, have: %d") % want.size() % have.size());
+
+    for (size_t i = 0; i < want.size(); ++i) {
+      auto &[wname, wbytes] = want.at(i);
+      auto &[hname, hbytes] = have.at(i);
+      if (wname != hname)
+        return boost::str(boost::format("field #%d: want: %s, have: %s") % i % wname % hname);
+      if (wbytes.size() != hbytes.size())
+        return boost::str(boost::format("%s: size: want: %d, have: %d") % wname % wbytes.size() % hbytes.size());
+      auto mm = std::mismatch(wbytes.begin(), wbytes.end(), hbytes.begin());
+      if (mm.first != wbytes.end())
+        return boost::str(boost::format("%s: differs at byte %d") % wname % (mm.first - wbytes.begin()));
+    }
+
+    return "";
+  }
+
+  // Greedy shrinking: keeps applying the first simplification which
+  // still fails until none does.
+  template <typename T>
+  T Shrink(T input, const std::function<std::vector<T>(const T&)> &simplify, const std::function<bool(const T&)> &fails) {
+    bool progress = true;
+    while (progress) {
+      progress = false;
+      for (auto &candidate : simplify(input)) {
+        if (fails(candidate)) {
+          input = candidate;
+          progress = true;
+          break;
+        }
+      }
+    }
+    return input;
+  }
+
+  //
+  // Graph inputs
+  //
+
+  using Containers = std::array<ModelUtil::IndexContainer, ModelUtil::LT_COUNT>;
+  using Buckets = std::vector<std::vector<std::vector<int32_t>>>;
+
+  Containers RandomContainers(std::mt19937 &rng) {
+    auto hexdist = std::uniform_int_distribution<int>(0, 164);
+    auto ndist = std::uniform_int_distribution<int>(0, 600);
+    auto attrdist = std::uniform_real_distribution<float>(-1, 1);
+    auto res = Containers{};
+
+    for (auto &c : res) {
+      auto dst = std::vector<int64_t>{};
+      for (int n = ndist(rng); n > 0; --n) {
+        c.ei.at(0).push_back(hexdist(rng));
+        c.ei.at(1).push_back(hexdist(rng));
+        c.ea.push_back(attrdist(rng));
+        dst.push_back(c.ei.at(1).back());
+      }
+      c.nbrs = ModelUtil::buildNBR_unpadded(dst);
+    }
+
+    return res;
+  }
+
+  Buckets RandomBuckets(std::mt19937 &rng) {
+    auto sdist = std::uniform_int_distribution<int>(1, 5);
+    auto edist = std::uniform_int_distribution<int>(0, 800);
+    auto kdist = std::uniform_int_distribution<int>(0, 40);
+    auto res = Buckets(sdist(rng));
+    for (auto &bucket : res)
+      for (int l = 0; l < ModelUtil::LT_COUNT; ++l)
+        bucket.push_back({edist(rng), kdist(rng)});
+    return res;
+  }
+
+  // Outputs (or the exception message) of a build_flattened implementation
+  template <typename F>
+  Fields BuildFields(F fn, const Containers &containers, const Buckets &buckets, int bucket) {
+    auto fields = Fields{};
+    try {
+      auto out = fn(containers, buckets, bucket);
+      AddField(fields, "size_index", &out.size_index, 1);
+      AddField(fields, "emax", out.emax);
+      AddField(fields, "kmax", out.kmax);
+      AddField(fields, "ei_flat[0]", out.ei_flat.at(0));
+      AddField(fields, "ei_flat[1]", out.ei_flat.at(1));
+      AddField(fields, "ea_flat", out.ea_flat);
+      for (int i = 0; i < 165; ++i)
+        AddField(fields, "nbrs_flat[" + std::to_string(i) + "]", out.nbrs_flat.at(i));
+    } catch (const std::exception &) {
+      // Only whether it throws matters (messages have different prefixes)
+      fields.emplace_back("exception", std::vector<uint8_t>{});
+    }
+    return fields;
+  }
+
+  std::string DescribeGraph(const Containers &containers, int bucket) {
+    auto res = boost::str(boost::format("bucket=%d, edges=[") % bucket);
+    for (auto &c : containers)
+      res += std::to_string(c.ea.size()) + " ";
+    return res + "]";
+  }
+
+  std::vector<Containers> SimplifyGraph(const Containers &containers) {
+    auto res = std::vector<Containers>{};
+    for (int l = 0; l < ModelUtil::LT_COUNT; ++l) {
+      auto n = containers.at(l).ea.size();
+      for (auto keep : {size_t(0), n / 2, n - 1}) {
+        if (n == 0 || keep >= n)
+          continue;
+        auto candidate = containers;
+        auto &c = candidate.at(l);
+        c.ei.at(0).resize(keep);
+        c.ei.at(1).resize(keep);
+        c.ea.resize(keep);
+        c.nbrs = ModelUtil::buildNBR_unpadded(std::vector<int64_t>(c.ei.at(1).begin(), c.ei.at(1).end()));
+        res.push_back(std::move(candidate));
+      }
+    }
+    return res;
+  }
+
+  //
+  // Battles
+  //
+
+  bool HaveLibrary() {
+    try {
+      BattleFixture::InitLibrary();
+      return true;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+
+  BattleSpec RandomSpec(uint32_t seed) {
+    auto rng = std::mt19937(seed);
+    auto spec = BattleSpec::Random(
+      std::uniform_int_distribution<int>(1, 7)(rng),
+      std::uniform_int_distribution<int>(0, 2)(rng),
+      seed
+    );
+    spec.obstacles = std::uniform_int_distribution<int>(0, 5)(rng);
+    spec.siege = std::bernoulli_distribution(0.3)(rng);
+    spec.sides.at(0).warMachines = std::bernoulli_distribution(0.3)(rng);
+    spec.sides.at(1).warMachines = std::bernoulli_distribution(0.3)(rng);
+    return spec;
+  }
+
+  std::string DescribeSpec(const BattleSpec &spec) {
+    auto res = boost::str(boost::format("seed=%d obstacles=%d siege=%d") % spec.seed % spec.obstacles % spec.siege);
+    for (int i = 0; i < 2; ++i) {
+      res += boost::str(boost::format(" side%d(warMachines=%d):") % i % spec.sides.at(i).warMachines);
+      for (auto &s : spec.sides.at(i).stacks)
+        res += boost::str(boost::format(" %d%s x%d") % s.creature.getNum() % (s.summoned ? "(s)" : "") % s.count);
+    }
+    return res;
+  }
+
+  std::vector<BattleSpec> SimplifySpec(const BattleSpec &spec) {
+    auto res = std::vector<BattleSpec>{};
+
+    if (spec.siege) {
+      res.push_back(spec);
+      res.back().siege = false;
+    }
+
+    if (spec.obstacles > 0) {
+      res.push_back(spec);
+      res.back().obstacles /= 2;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+      auto &side = spec.sides.at(i);
+
+      if (side.warMachines) {
+        res.push_back(spec);
+        res.back().sides.at(i).warMachines = false;
+      }
+
+      // At least one stack per side must remain
+      for (size_t j = 0; j < side.stacks.size() && side.stacks.size() > 1; ++j) {
+        res.push_back(spec);
+        auto &stacks = res.back().sides.at(i).stacks;
+        stacks.erase(stacks.begin() + j);
+      }
+
+      for (size_t j = 0; j < side.stacks.size(); ++j) {
+        if (side.stacks.at(j).count > 1) {
+          res.push_back(spec);
+          res.back().sides.at(i).stacks.at(j).count = 1;
+        }
+      }
+    }
+
+    return res;
+  }
+
+  template <typename Battlefield>
+  Fields BattlefieldFields(const Battlefield &bf) {
+    auto fields = Fields{};
+    for (int y = 0; y < BF_YMAX; ++y) {
+      for (int x = 0; x < BF_XMAX; ++x)
+        AddField(fields, boost::str(boost::format("hex[%d][%d]") % y % x), bf.hexes->at(y).at(x)->getAttrs());
+    }
+
+    for (size_t i = 0; i < bf.stacks.size(); ++i)
+      AddField(fields, "stack[" + std::to_string(i) + "]", bf.stacks.at(i)->getAttrs());
+
+    for (auto &[type, links] : bf.allLinks) {
+      auto name = "links[" + std::to_string(EI(type)) + "]";
+      AddField(fields, name + ".src", links->getSrcIndex());
+      AddField(fields, name + ".dst", links->getDstIndex());
+      AddField(fields, name + ".attrs", links->getAttributes());
+    }
+
+    return fields;
+  }
+
+  // Battlefield of the fixture's active stack, built with the given pool
+  Fields BattlefieldFields(const BattleSpec &spec, BAI::WorkerPool* pool) {
+    auto fixture = BattleFixture(spec);
+    auto *cb = fixture.callback(BattleSide::LEFT_SIDE);
+    auto state = BAI::V13::State(13, "red", cb);
+    auto bf = BAI::V13::Battlefield::Create(
+      pool,
+      state.arenas.next(),
+      state.obstacles,
+      state.bonuses,
+      cb,
+      fixture.activeStack(),
+      state.gstats.get(),
+      state.gstats.get(),
+      state.sstats,
+      false
+    );
+    return BattlefieldFields(*bf);
+  }
+
+  // Battlefield of the fixture's active stack, built by the frozen baseline
+  Fields ReferenceBattlefieldFields(const BattleSpec &spec) {
+    auto fixture = BattleFixture(spec);
+    auto *cb = fixture.callback(BattleSide::LEFT_SIDE);
+    auto state = Reference::V13::State(13, "red", cb);
+    auto bf = Reference::V13::Battlefield::Create(
+      cb,
+      fixture.activeStack(),
+      state.gstats.get(),
+      state.gstats.get(),
+      state.sstats,
+      false
+    );
+    return BattlefieldFields(*bf);
+  }
+
+  template <typename State>
+  std::vector<uint8_t> StateBytes(const BattleSpec &spec) {
+    auto fixture = BattleFixture(spec);
+    auto state = State(13, "red", fixture.callback(BattleSide::LEFT_SIDE));
+    state.onActiveStack(fixture.activeStack());
+    auto bytes = BAI::Snapshot::Serialize(&state, 0);
+    return {bytes.begin(), bytes.end()};
+  }
+
+  template <typename State>
+  Fields StateFields(const State &state) {
+    auto fields = Fields{};
+    AddField(fields, "bfstate", state.bfstate);
+    AddField(fields, "actmask", std::vector<uint8_t>(state.actmask.begin(), state.actmask.end()));
+    for (auto &[type, links] : state.supdata->getAllLinks()) {
+      auto name = "links[" + std::to_string(EI(type)) + "]";
+      AddField(fields, name + ".src", links->getSrcIndex());
+      AddField(fields, name + ".dst", links->getDstIndex());
+      AddField(fields, name + ".attrs", links->getAttributes());
+    }
+    // The complete snapshot record (also covers side and version)
+    AddField(fields, "record", BAI::Snapshot::Serialize(&state, 0));
+    return fields;
+  }
+
+  template <typename State>
+  Fields StateFields(const BattleSpec &spec) {
+    auto fixture = BattleFixture(spec);
+    auto state = State(13, "red", fixture.callback(BattleSide::LEFT_SIDE));
+    state.onActiveStack(fixture.activeStack());
+    return StateFields(state);
+  }
+
+  // Our next turn after the same sequence of actions, as seen by a State
+  // which records transitions (as in ENABLE_ML builds) and one which
+  // does not. Returns {not recorded, recorded}.
+  std::pair<Fields, Fields> RecordingFields(const BattleSpec &spec) {
+    auto fixture = BattleFixture(spec);
+    auto *cb = fixture.callback(BattleSide::LEFT_SIDE);
+    auto ours = cb->battleGetStacks(CBattleInfoEssentials::ONLY_MINE);
+    auto enemies = cb->battleGetStacks(CBattleInfoEssentials::ONLY_ENEMY);
+    auto plain = BAI::V13::State(13, "red", cb);
+    auto recorded = BAI::V13::State(13, "red", cb);
+
+    auto attack = [&](const CStack* attacker, const CStack* defender) {
+      auto bsa = BattleStackAttacked();
+      bsa.attackerID = attacker->unitId();
+      bsa.stackAttacked = defender->unitId();
+      bsa.damageAmount = 1 + defender->getFirstHPleft() / 2;
+      bsa.killedAmount = 1;
+      plain.onBattleStacksAttacked({bsa});
+      recorded.onBattleStacksAttacked({bsa});
+    };
+
+    // Only the recording State is told about started actions
+    // (see BAI::actionStarted)
+    plain.onActiveStack(ours.front());
+    recorded.onActiveStack(ours.front());
+    recorded.onActionStarted(BattleAction::makeDefend(ours.front()));
+    attack(ours.front(), enemies.front());
+
+    for (auto *enemy : {enemies.front(), enemies.back()}) {
+      recorded.onActionStarted(BattleAction::makeDefend(enemy));
+      attack(enemy, ours.front());
+    }
+
+    plain.onActiveStack(ours.back());
+    recorded.onActiveStack(ours.back());
+    return {StateFields(plain), StateFields(recorded)};
+  }
+}
+
+TEST(Equivalence, BuildNBR) {
+  auto rng = std::mt19937(0);
+  auto hexdist = std::uniform_int_distribution<int>(0, 164);
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto dst = std::vector<int64_t>(std::uniform_int_distribution<int>(0, 2000)(rng));
+    for (auto &d : dst)
+      d = hexdist(rng);
+
+    ASSERT_EQ(Reference::buildNBR_unpadded(dst), ModelUtil::buildNBR_unpadded(dst)) << "case " << i;
+  }
+}
+
+TEST(Equivalence, BuildFlattened) {
+  auto rng = std::mt19937(0);
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto containers = RandomContainers(rng);
+    auto buckets = RandomBuckets(rng);
+    auto bucket = std::uniform_int_distribution<int>(-1, buckets.size() - 1)(rng);
+
+    auto diff = [&buckets, bucket](const Containers &c) {
+      return FirstDiff(
+        BuildFields(Reference::build_flattened, c, buckets, bucket),
+        BuildFields(ModelUtil::build_flattened, c, buckets, bucket)
+      );
+    };
+
+    if (diff(containers).empty())
+      continue;
+
+    auto minimal = Shrink<Containers>(containers, SimplifyGraph, [&diff](const Containers &c) { return !diff(c).empty(); });
+    FAIL() << "case " << i << ": " << diff(minimal) << "\n  minimal input: " << DescribeGraph(minimal, bucket);
+  }
+}
+
+TEST(Equivalence, BattlefieldReference) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto spec = RandomSpec(i);
+
+    auto diff = [](const BattleSpec &s) {
+      return FirstDiff(ReferenceBattlefieldFields(s), BattlefieldFields(s, nullptr));
+    };
+
+    if (diff(spec).empty())
+      continue;
+
+    auto minimal = Shrink<BattleSpec>(spec, SimplifySpec, [&diff](const BattleSpec &s) { return !diff(s).empty(); });
+    FAIL() << "case " << i << ": " << diff(minimal) << "\n  minimal battle: " << DescribeSpec(minimal);
+  }
+}
+
+TEST(Equivalence, BattlefieldParallel) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  auto pool = BAI::WorkerPool(4);
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto spec = RandomSpec(i);
+
+    auto diff = [&pool](const BattleSpec &s) {
+      return FirstDiff(BattlefieldFields(s, nullptr), BattlefieldFields(s, &pool));
+    };
+
+    if (diff(spec).empty())
+      continue;
+
+    auto minimal = Shrink<BattleSpec>(spec, SimplifySpec, [&diff](const BattleSpec &s) { return !diff(s).empty(); });
+    FAIL() << "case " << i << ": " << diff(minimal) << "\n  minimal battle: " << DescribeSpec(minimal);
+  }
+}
+
+TEST(Equivalence, StateReference) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto spec = RandomSpec(i);
+
+    auto diff = [](const BattleSpec &s) {
+      return FirstDiff(StateFields<Reference::V13::State>(s), StateFields<BAI::V13::State>(s));
+    };
+
+    if (diff(spec).empty())
+      continue;
+
+    auto minimal = Shrink<BattleSpec>(spec, SimplifySpec, [&diff](const BattleSpec &s) { return !diff(s).empty(); });
+    FAIL() << "case " << i << ": " << diff(minimal) << "\n  minimal battle: " << DescribeSpec(minimal);
+  }
+}
+
+TEST(Equivalence, StateRecording) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto spec = RandomSpec(i);
+
+    auto diff = [](const BattleSpec &s) {
+      auto [plain, recorded] = RecordingFields(s);
+      return FirstDiff(plain, recorded);
+    };
+
+    if (diff(spec).empty())
+      continue;
+
+    auto minimal = Shrink<BattleSpec>(spec, SimplifySpec, [&diff](const BattleSpec &s) { return !diff(s).empty(); });
+    FAIL() << "case " << i << ": " << diff(minimal) << "\n  minimal battle: " << DescribeSpec(minimal);
+  }
+}
+
+TEST(Equivalence, StateGolden) {
+  auto *golden = std::getenv("MMAI_EQUIV_GOLDEN");
+  if (!golden)
+    GTEST_SKIP() << "MMAI_EQUIV_GOLDEN is not set";
+
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  if (std::getenv("MMAI_EQUIV_RECORD")) {
+    std::remove(golden);
+    auto recorder = BAI::Snapshot::Recorder(golden);
+    for (int i = 0; i < RANDOM_CASES; ++i) {
+      auto spec = RandomSpec(i);
+      auto fixture = BattleFixture(spec);
+      auto state = Reference::V13::State(13, "red", fixture.callback(BattleSide::LEFT_SIDE));
+      state.onActiveStack(fixture.activeStack());
+      recorder.record(&state, 0);
+    }
+    return;
+  }
+
+  auto reader = BAI::Snapshot::Reader(golden);
+  ASSERT_EQ(reader.size(), RANDOM_CASES);
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto want = BAI::Snapshot::Serialize(reader.at(i).get(), 0);
+    auto have = StateBytes<BAI::V13::State>(RandomSpec(i));
+    if (std::vector<uint8_t>(want.begin(), want.end()) == have)
+      continue;
+
+    // A golden file holds outputs only => shrinking is not possible here
+    // (StateReference may help narrowing it down)
+    auto mm = std::mismatch(want.begin(), want.end(), have.begin(), have.end());
+    FAIL() << "case " << i << ": state differs at record byte " << (mm.first - want.begin())
+           << "\n  battle: " << DescribeSpec(RandomSpec(i));
+  }
+}
+
+namespace {
+  using PackedActionMask = Schema::V13::PackedActionMask;
+
+  Schema::ActionMask RandomActionMask(std::mt19937 &rng) {
+    auto density = std::uniform_real_distribution<double>(0, 0.1)(rng);
+    auto dist = std::bernoulli_distribution(density);
+    auto res = Schema::ActionMask(PackedActionMask::N_ACTIONS);
+    for (size_t i = 0; i < res.size(); ++i)
+      res[i] = dist(rng);
+    return res;
+  }
+
+  // act0 => 0: WAIT, 1: MOVE (hex1), 2: AMOVE (hex1, hex2), 3: SHOOT (hex1)
+  std::vector<int32_t> ActionTable() {
+    auto res = std::vector<int32_t>(4*165*165, -1);
+    auto hexaction = [](int hex, int ha) { return PackedActionMask::N_GLOBAL + hex*PackedActionMask::N_HEX + ha; };
+    for (int h1 = 0; h1 < 165; ++h1) {
+      for (int h2 = 0; h2 < 165; ++h2) {
+        res.at((0*165 + h1)*165 + h2) = Schema::V13::ACTION_WAIT;
+        res.at((1*165 + h1)*165 + h2) = hexaction(h1, EI(Schema::V13::HexAction::MOVE));
+        res.at((3*165 + h1)*165 + h2) = hexaction(h1, EI(Schema::V13::HexAction::SHOOT));
+        if (h2 > h1 && h2 - h1 <= EI(Schema::V13::HexAction::AMOVE_2TL) + 1)
+          res.at((2*165 + h1)*165 + h2) = hexaction(h1, h2 - h1 - 1);
+      }
+    }
+    return res;
+  }
+}
+
+TEST(Equivalence, PackedActionMask) {
+  auto rng = std::mt19937(0);
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto actmask = RandomActionMask(rng);
+    auto packed = PackedActionMask{};
+    packed.assign(actmask);
+
+    for (int a = 0; a < PackedActionMask::N_ACTIONS; ++a)
+      ASSERT_EQ(packed.test(a), actmask[a]) << "case " << i << ", action " << a;
+  }
+}
+
+TEST(Equivalence, SampleTripletPackedMask) {
+  auto rng = std::mt19937(0);
+  auto logit = std::uniform_real_distribution<float>(-5, 5);
+  auto table = ActionTable();
+
+  for (int i = 0; i < RANDOM_CASES; ++i) {
+    auto actmask = RandomActionMask(rng);
+    actmask[Schema::V13::ACTION_WAIT] = true;  // act0 must not be empty
+
+    auto packed = PackedActionMask{};
+    packed.assign(actmask);
+
+    auto m0 = std::vector<int32_t>(4);
+    auto m1 = std::vector<int32_t>(4*165);
+    auto m2 = std::vector<int32_t>(4*165*165);
+    for (size_t j = 0; j < m2.size(); ++j) {
+      auto action = table.at(j);
+      m2.at(j) = action >= 0 && actmask[action];
+      m1.at(j / 165) |= m2.at(j);
+      m0.at(j / (165*165)) |= m2.at(j);
+    }
+
+    auto a0 = std::vector<float>(4);
+    auto h1 = std::vector<float>(165);
+    auto h2 = std::vector<float>(165);
+    for (auto *v : {&a0, &h1, &h2})
+      for (auto &x : *v)
+        x = logit(rng);
+
+    for (auto temperature : {0.0f, 1.0f, 1e9f}) {
+      auto rng1 = std::mt19937(i);
+      auto rng2 = std::mt19937(i);
+      auto want = ModelUtil::sample_triplet(a0.data(), h1.data(), h2.data(), m0.data(), m1.data(), m2.data(), temperature, rng1);
+      auto have = ModelUtil::sample_triplet(a0.data(), h1.data(), h2.data(), packed, table.data(), temperature, rng2);
+
+      ASSERT_EQ(want.act0, have.act0) << "case " << i << ", temperature " << temperature;
+      ASSERT_EQ(want.hex1, have.hex1) << "case " << i << ", temperature " << temperature;
+      ASSERT_EQ(want.hex2, have.hex2) << "case " << i << ", temperature " << temperature;
+      ASSERT_EQ(want.confidence, have.confidence) << "case " << i << ", temperature " << temperature;
+    }
+  }
+}
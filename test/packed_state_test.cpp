@@ -0,0 +1,83 @@
+#include "BAI/v13/encoder.h"
+#include "BAI/v13/packed_state.h"
+#include "schema/v13/constants.h"
+#include "test/googletest/googletest/include/gtest/gtest.h"
+#include <random>
+#include <stdexcept>
+
+using Encoder = MMAI::BAI::V13::Encoder;
+using namespace MMAI::Schema::V13;
+namespace Packing = MMAI::BAI::V13::Packing;
+
+namespace {
+  // Random values (incl. NULL where the encoding permits it) for each attribute
+  template <typename T>
+  void EncodeRandom(const T &encoding, std::mt19937 &rng, std::vector<float> &vec) {
+    for (auto &[a, e, n, vmax, p] : encoding) {
+      auto v = std::uniform_int_distribution<int>(0, vmax)(rng);
+      if (rng() % 4 == 0) {
+        try {
+          auto tmp = std::vector<float>{};
+          Encoder::Encode(a, -1, tmp);
+          v = -1;
+        } catch (const std::exception &) {
+          // strict null
+        }
+      }
+      Encoder::Encode(a, v, vec);
+    }
+  }
+
+  std::vector<float> RandomState(uint32_t seed) {
+    auto rng = std::mt19937(seed);
+    auto res = std::vector<float>{};
+    res.reserve(BATTLEFIELD_STATE_SIZE);
+    EncodeRandom(GLOBAL_ENCODING, rng, res);
+    EncodeRandom(PLAYER_ENCODING, rng, res);
+    EncodeRandom(PLAYER_ENCODING, rng, res);
+    for (int i = 0; i < 165; ++i)
+      EncodeRandom(HEX_ENCODING, rng, res);
+    return res;
+  }
+}
+
+TEST(PackedState, Kinds) {
+  static_assert(Packing::KindOf(Encoding::CATEGORICAL_STRICT_NULL) == Packing::Kind::BIT);
+  static_assert(Packing::KindOf(Encoding::ACCUMULATING_EXPBIN_ZERO_NULL) == Packing::Kind::BIT);
+  static_assert(Packing::KindOf(Encoding::BINARY_MASKING_NULL) == Packing::Kind::TERNARY);
+  static_assert(Packing::KindOf(Encoding::EXPNORM_EXPLICIT_NULL) == Packing::Kind::FLOAT);
+  static_assert(Packing::KindOf(Encoding::RAW) == Packing::Kind::FLOAT);
+
+  // The point of packing
+  static_assert(Packing::PACKED_SIZE * 4 < BATTLEFIELD_STATE_SIZE * sizeof(float));
+}
+
+TEST(PackedState, RoundTrip) {
+  for (uint32_t seed = 0; seed < 20; ++seed) {
+    auto state = RandomState(seed);
+    ASSERT_EQ(state.size(), BATTLEFIELD_STATE_SIZE);
+
+    auto packed = std::vector<char>(Packing::PACKED_SIZE);
+    ASSERT_TRUE(Packing::Pack(state.data(), packed.data())) << "seed " << seed;
+
+    auto unpacked = std::vector<float>(BATTLEFIELD_STATE_SIZE);
+    Packing::Unpack(packed.data(), unpacked.data());
+    ASSERT_EQ(state, unpacked) << "seed " << seed;
+  }
+}
+
+TEST(PackedState, RejectsInexact) {
+  auto state = RandomState(0);
+  auto packed = std::vector<char>(Packing::PACKED_SIZE);
+
+  // The first global attribute is binary-packed
+  static_assert(Packing::GLOBAL_RUNS.at(0).kind == Packing::Kind::BIT, "test needs to be updated");
+  state.at(0) = 0.5;
+  ASSERT_FALSE(Packing::Pack(state.data(), packed.data()));
+
+  state.at(0) = -1;
+  ASSERT_FALSE(Packing::Pack(state.data(), packed.data()));
+
+  state.at(0) = 1;
+  ASSERT_TRUE(Packing::Pack(state.data(), packed.data()));
+}
@@ -0,0 +1,171 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+
+#pragma once
+
+#include <boost/format.hpp>
+
+#include "BAI/model/ModelUtil.h"
+
+// Frozen copies of the ModelUtil graph input builders, used as the
+// reference implementation by test/equivalence_test.cpp.
+// Do not optimise these: behaviour changes go to ModelUtil first and
+// are copied here only once the equivalence tests are updated for them.
+namespace MMAI::Test::Reference {
+    using MMAI::BAI::ModelUtil::LT_COUNT;
+    using MMAI::BAI::ModelUtil::IndexContainer;
+    using MMAI::BAI::ModelUtil::BuildOutputs;
+
+    template<class... Args>
+    [[noreturn]] inline void throwf(const std::string& fmt, Args&&... args) {
+        boost::format f("Reference: " + fmt);
+        (void)std::initializer_list<int>{ ( (f % std::forward<Args>(args)), 0 )... };
+        throw std::runtime_error(f.str());
+    }
+
+    inline std::array<std::vector<int32_t>, 165> buildNBR_unpadded(const std::vector<int64_t>& dst) {
+        // Pass 1: validate and count degrees per node
+        std::array<int, 165> deg{};
+        for (size_t e = 0; e < dst.size(); ++e) {
+            int v = static_cast<int>(dst[e]);
+            if (v < 0 || v >= 165)
+                throwf("dst contains node id out of range: ", v);
+            ++deg[v];
+        }
+
+        std::array<std::vector<int32_t>, 165> nbr{};
+        for (int v = 0; v < 165; ++v) nbr[v].reserve(deg[v]);
+        for (size_t e = 0; e < dst.size(); ++e) {
+            int v = static_cast<int>(dst[e]);
+            nbr[v].push_back(static_cast<int32_t>(e));
+        }
+
+        return nbr;
+    }
+
+    // all_sizes: S x LT_COUNT x 2, where [s][l] = {emax, kmax}
+    inline BuildOutputs build_flattened(
+        const std::array<IndexContainer, LT_COUNT>& containers,
+        const std::vector<std::vector<std::vector<int32_t>>>& all_sizes,
+        int bucket
+    ) {
+        BuildOutputs out{};
+
+        // Required per-linktype capacities from data
+        std::array<size_t, LT_COUNT> e_req{};
+        std::array<size_t, LT_COUNT> k_req{};
+        for (int l = 0; l < LT_COUNT; ++l) {
+            e_req[l] = containers[l].ea.size();
+            size_t km = 0;
+            for (int v = 0; v < 165; ++v)
+                km = std::max(km, containers[l].nbrs[v].size());
+            k_req[l] = km;
+        }
+
+        // 1) Find smallest valid size index
+        int chosen = -1;
+        std::array<int32_t, LT_COUNT> emax{}, kmax{};
+        for (int s = 0; s < static_cast<int>(all_sizes.size()); ++s) {
+            const auto& sz = all_sizes[s];
+            if (sz.size() != LT_COUNT) continue;  // skip malformed
+            bool ok = true;
+            for (int l = 0; l < LT_COUNT && ok; ++l) {
+                if (sz[l].size() != 2) { ok = false; break; }
+                int32_t emax_l = sz[l][0];
+                int32_t kmax_l = sz[l][1];
+                if (emax_l < static_cast<int32_t>(e_req[l]) ||
+                    kmax_l < static_cast<int32_t>(k_req[l])) {
+                    ok = false;
+                }
+            }
+            ok = ok && (bucket == -1 || s == bucket);
+            if (ok) {
+                chosen = s;
+                for (int l = 0; l < LT_COUNT; ++l) {
+                    emax[l] = sz[l][0];
+                    kmax[l] = sz[l][1];
+                }
+                break;
+            }
+        }
+
+        // TODO: emit a warning and truncate edges instead (not straightforward)
+        if (chosen < 0) {
+            throw std::runtime_error("No size option in all_sizes satisfies the data requirements.");
+        }
+
+        out.size_index = chosen;
+        out.emax = emax;
+        out.kmax = kmax;
+
+        // Precompute sums
+        const size_t sum_emax = std::accumulate(emax.begin(), emax.end(), 0);
+        const size_t sum_kmax = std::accumulate(kmax.begin(), kmax.end(), 0);
+
+        // 2) Build ei_flat and ea_flat (concat each layer's ei/ea, zero-padded to emax[l])
+        out.ei_flat.at(0).clear();
+        out.ei_flat.at(1).clear();
+        out.ea_flat.clear();
+
+        out.ei_flat.at(0).reserve(sum_emax);
+        out.ei_flat.at(1).reserve(sum_emax);
+        out.ea_flat.reserve(sum_emax);
+        for (int l = 0; l < LT_COUNT; ++l) {
+            const auto& ei = containers[l].ei;
+            const auto& ea = containers[l].ea;
+
+            out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), ei.at(0).begin(), ei.at(0).end());
+            out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), ei.at(1).begin(), ei.at(1).end());
+            out.ea_flat.insert(out.ea_flat.end(), ea.begin(), ea.end());
+
+            size_t need = static_cast<size_t>(emax[l]) - ei.at(0).size();
+            if (need > 0) out.ei_flat.at(0).insert(out.ei_flat.at(0).end(), need, 0);
+
+            need = static_cast<size_t>(emax[l]) - ei.at(1).size();
+            if (need > 0) out.ei_flat.at(1).insert(out.ei_flat.at(1).end(), need, 0);
+
+            need = static_cast<size_t>(emax[l]) - ea.size();
+            if (need > 0) out.ea_flat.insert(out.ea_flat.end(), need, 0.0f);
+        }
+        // Sanity
+        if (out.ei_flat.at(0).size() != sum_emax)
+            throwf("ei_flat.at(0) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(0).size());
+        if (out.ei_flat.at(1).size() != sum_emax)
+            throwf("ei_flat.at(1) size mismatch: want: %d, have: %zu", sum_emax, out.ei_flat.at(1).size());
+        if (out.ea_flat.size() != sum_emax)
+            throwf("ea_flat size mismatch: want: %d, have: %zu", sum_emax, out.ea_flat.size());
+
+        // 3) Build nbrs_flat per node: concat layer l, pad to kmax[l] with -1
+        for (int v = 0; v < 165; ++v) {
+            auto& dst = out.nbrs_flat[v];
+            dst.clear();
+            dst.reserve(sum_kmax);
+            for (int l = 0; l < LT_COUNT; ++l) {
+                const auto& src = containers[l].nbrs[v];
+                dst.insert(dst.end(), src.begin(), src.end());
+                const size_t need = static_cast<size_t>(kmax[l]) - src.size();
+                if (need > 0) dst.insert(dst.end(), need, static_cast<int32_t>(-1));
+            }
+            // Optional sanity:
+            if (dst.size() != sum_kmax) {
+                throw std::runtime_error("nbrs_flat row size mismatch.");
+            }
+        }
+
+        return out;
+    }
+}
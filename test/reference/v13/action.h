@@ -0,0 +1,44 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#pragma once
+
+#include "test/reference/v13/battlefield.h"
+#include "test/reference/v13/hex.h"
+#include "test/reference/v13/hexaction.h"
+
+// Frozen copy of BAI/v13/action.h at 2a8b485 (before the optimisations),
+// used as the reference by test/equivalence_test.cpp. Do not optimise.
+namespace MMAI::Test::Reference::V13 {
+    /**
+     * Wrapper around Schema::Action
+     */
+    struct Action {
+        static std::unique_ptr<Hex> initHex(const Schema::Action &a, const Battlefield * bf);
+        static std::unique_ptr<Hex> initAMoveTargetHex(const Schema::Action &a, const Battlefield * bf);
+        static HexAction initHexAction(const Schema::Action &a, const Battlefield * bf);
+
+        Action(const Schema::Action action_, const Battlefield * bf, const std::string color);
+
+        const std::string color;
+        const Schema::Action action;
+        const std::unique_ptr<Hex> hex;
+        const std::unique_ptr<Hex> aMoveTargetHex;
+        const HexAction hexaction; // XXX: must come after action
+
+        std::string name() const;
+    };
+}
@@ -0,0 +1,40 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+#pragma once
+
+#include "schema/v13/types.h"
+
+// Frozen copy of BAI/v13/links.h at 2a8b485 (before the optimisations),
+// used as the reference by test/equivalence_test.cpp. Do not optimise.
+namespace MMAI::Test::Reference::V13 {
+    class Links : public Schema::V13::ILinks {
+    public:
+        std::vector<int64_t> srcIndex = {};       // [src1, src2, ...]
+        std::vector<int64_t> dstIndex = {};       // [dst1, dst2, ...]
+        std::vector<float> attributes = {};   // [attr1, attr2, ...]
+
+        const std::vector<int64_t> getSrcIndex() const override { return srcIndex; }
+        const std::vector<int64_t> getDstIndex() const override { return dstIndex; }
+        const std::vector<float> getAttributes() const override { return attributes; }
+
+        void add(int src, int dst, float attr) {
+            srcIndex.push_back(src);
+            dstIndex.push_back(dst);
+            attributes.push_back(attr);
+        }
+    };
+}
@@ -0,0 +1,92 @@
+// The BAI skips BattleAI's spell evaluation while the battle state is the
+// same as when it last decided not to cast (see Util::SpellStateFingerprint).
+// BattleAI compares spells against the active stack's own best action, so
+// a different active stack must never be mistaken for an unchanged state.
+// Needs the VCMI game data.
+
+#include "BAI/v13/util.h"
+#include "test/battle_fixture.h"
+#include "test/googletest/googletest/include/gtest/gtest.h"
+#include <optional>
+
+using namespace MMAI::Test;
+namespace Util = MMAI::BAI::V13::Util;
+
+namespace {
+  bool HaveLibrary() {
+    try {
+      BattleFixture::InitLibrary();
+      return true;
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+
+  // Another alive stack on the active stack's side
+  const CStack* Teammate(const BattleFixture &fixture) {
+    auto *astack = fixture.activeStack();
+    for (const auto *cstack : fixture.callback(astack->unitSide())->battleGetAllStacks(true))
+      if (cstack->unitSide() == astack->unitSide() && cstack->unitId() != astack->unitId())
+        return cstack;
+    return nullptr;
+  }
+}
+
+TEST(SpellFingerprint, SameStateSameStack) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  auto fixture = BattleFixture(BattleSpec::Random(2, 0, 0));
+  auto *astack = fixture.activeStack();
+  auto *battle = fixture.callback(astack->unitSide());
+  ASSERT_EQ(Util::SpellStateFingerprint(battle, astack), Util::SpellStateFingerprint(battle, astack));
+}
+
+// Mirrors BAI::canCastSpell / BAI::maybeCastSpell: the evaluation is
+// skipped only if the fingerprint matches the last "no cast" decision.
+TEST(SpellFingerprint, EachActiveStackIsEvaluated) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  for (uint32_t seed = 0; seed < 10; ++seed) {
+    auto fixture = BattleFixture(BattleSpec::Random(2, 0, seed));
+    auto *first = fixture.activeStack();
+    auto *second = Teammate(fixture);
+    ASSERT_NE(second, nullptr) << "seed " << seed;
+
+    auto *battle = fixture.callback(first->unitSide());
+    auto noCastFingerprint = std::optional<uint64_t>{};
+    auto evaluated = std::vector<uint32_t>{};
+
+    // Nothing changes in between, as if neither stack found a spell
+    // better than its own best action.
+    for (const auto *astack : {first, second}) {
+      auto fingerprint = Util::SpellStateFingerprint(battle, astack);
+      if (noCastFingerprint == fingerprint)
+        continue;
+      evaluated.push_back(astack->unitId());
+      noCastFingerprint = fingerprint;
+    }
+
+    ASSERT_EQ(evaluated, (std::vector<uint32_t>{first->unitId(), second->unitId()})) << "seed " << seed;
+  }
+}
+
+TEST(SpellFingerprint, WaitingChangesFingerprint) {
+  if (!HaveLibrary())
+    GTEST_SKIP() << "VCMI game data is not available";
+
+  auto fixture = BattleFixture(BattleSpec::Random(2, 0, 0));
+  auto *astack = fixture.activeStack();
+  auto *battle = fixture.callback(astack->unitSide());
+  auto *mutableStack = fixture.battleInfo()->getStack(astack->unitId());
+  ASSERT_NE(mutableStack, nullptr);
+
+  auto before = Util::SpellStateFingerprint(battle, astack);
+  mutableStack->waitedThisTurn = !mutableStack->waitedThisTurn;
+  auto after = Util::SpellStateFingerprint(battle, astack);
+  mutableStack->waitedThisTurn = !mutableStack->waitedThisTurn;
+
+  ASSERT_NE(before, after);
+  ASSERT_EQ(before, Util::SpellStateFingerprint(battle, astack));
+}
@@ -0,0 +1,300 @@
+// =============================================================================
+// Copyright 2024 Simeon Manolov <s.manolloff@gmail.com>.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// =============================================================================
+
+// mmai-replay: feeds recorded state snapshots (see BAI/snapshot.h) through
+// the compiled TorchModel backend and reports throughput, latency and
+// action agreement.
+//
+// Examples:
+//
+//   # throughput and latency, 4 threads (one model instance each)
+//   mmai-replay --model model.pt --threads 4 snapshots.bin
+//
+//   # agreement between two model versions
+//   mmai-replay --model new.pt --model2 old.pt snapshots.bin
+//
+//   # agreement between backends (i.e. two builds of mmai-replay)
+//   mmai-replay-lt   --model model.pt  --actions-out lt.txt snapshots.bin
+//   mmai-replay-onnx --model model.onnx --actions-in lt.txt snapshots.bin
+//
+// All models run greedily (temperature=0), so any disagreement is due to
+// differences in the models or backends (or numerical noise near ties).
+
+#include "StdInc.h"
+
+#include <boost/program_options.hpp>
+
+#include "BAI/alloc_stats.h"
+#include "BAI/model/TorchModel.h"
+#include "BAI/perf_stats.h"
+#include "BAI/snapshot.h"
+#include "common.h"
+
+using namespace MMAI;
+namespace po = boost::program_options;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        std::vector<std::string> snapshots;
+        std::string model;
+        std::string model2;
+        std::string actionsIn;
+        std::string actionsOut;
+        int threads = 1;        // model instances, each on its own thread
+        int batch = 1;          // states claimed by a thread at a time
+        int modelThreads = 1;   // backend intra-op threads per instance
+        int repeat = 1;         // passes over the snapshots
+    };
+
+    struct Entry {
+        std::unique_ptr<BAI::Snapshot::State> state;
+        int sizeClass;  // log2 of the total number of links
+    };
+
+    struct Result {
+        std::vector<int> actions;                    // [entry]
+        std::vector<double> latencies;               // [pass * entries + entry], ms
+        std::vector<double> batchLatencies;          // ms
+        double wallSeconds = 0;
+    };
+
+    int SizeClass(const BAI::Snapshot::State &state) {
+        auto any = state.getSupplementaryData();
+        auto *sup = std::any_cast<const Schema::V13::ISupplementaryData*>(any);
+        size_t n = 0;
+        for (const auto &[_, links] : sup->getAllLinks())
+            n += links->getSrcIndex().size();
+
+        int res = 0;
+        while ((size_t(1) << res) < n)
+            ++res;
+        return res;
+    }
+
+    double Percentile(std::vector<double> values, double p) {
+        if (values.empty())
+            return 0;
+        auto k = static_cast<size_t>(p * (values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + k, values.end());
+        return values.at(k);
+    }
+
+    std::string Stats(const std::vector<double> &values) {
+        return boost::str(boost::format("p50=%.3f p90=%.3f p99=%.3f max=%.3f ms")
+            % Percentile(values, 0.5) % Percentile(values, 0.9)
+            % Percentile(values, 0.99) % Percentile(values, 1.0));
+    }
+
+    std::unique_ptr<BAI::TorchModel> LoadModel(std::string path, int threads) {
+        return std::make_unique<BAI::TorchModel>(path, 0.0, 0, threads);
+    }
+
+    Result Run(const Options &opts, const std::vector<Entry> &entries) {
+        auto res = Result{};
+        res.actions.resize(entries.size());
+        res.latencies.resize(entries.size() * opts.repeat);
+
+        // Models are loaded before timing starts
+        auto models = std::vector<std::unique_ptr<BAI::TorchModel>>{};
+        for (int i=0; i<opts.threads; ++i)
+            models.push_back(LoadModel(opts.model, opts.modelThreads));
+
+        auto batchMutex = std::mutex{};
+        auto t0 = Clock::now();
+
+        for (int pass = 0; pass < opts.repeat; ++pass) {
+            auto next = std::atomic<size_t>(0);
+            auto *latencies = res.latencies.data() + pass * entries.size();
+
+            auto work = [&](BAI::TorchModel* model) {
+                auto batchLatencies = std::vector<double>{};
+
+                while (true) {
+                    auto begin = next.fetch_add(opts.batch);
+                    if (begin >= entries.size())
+                        break;
+
+                    auto end = std::min(begin + opts.batch, entries.size());
+                    auto tb = Clock::now();
+
+                    for (auto i = begin; i < end; ++i) {
+                        auto ts = Clock::now();
+                        res.actions.at(i) = model->getAction(entries.at(i).state.get());
+                        latencies[i] = std::chrono::duration<double, std::milli>(Clock::now() - ts).count();
+                    }
+
+                    batchLatencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - tb).count());
+                }
+
+                auto lock = std::lock_guard(batchMutex);
+                res.batchLatencies.insert(res.batchLatencies.end(), batchLatencies.begin(), batchLatencies.end());
+            };
+
+            if (opts.threads == 1) {
+                work(models.at(0).get());
+            } else {
+                auto threads = std::vector<std::thread>{};
+                for (auto &model : models)
+                    threads.emplace_back(work, model.get());
+                for (auto &t : threads)
+                    t.join();
+            }
+        }
+
+        res.wallSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+        return res;
+    }
+
+    void ReportAgreement(const std::string &name, const std::vector<int> &want, const std::vector<int> &have) {
+        if (want.size() != have.size())
+            THROW_FORMAT("%s: action count mismatch: %d vs %d", name % want.size() % have.size());
+
+        size_t same = 0;
+        for (size_t i = 0; i < want.size(); ++i)
+            same += (want.at(i) == have.at(i));
+
+        std::cout << boost::format("agreement (%s): %d/%d (%.2f%%)\n")
+            % name % same % want.size() % (want.empty() ? 100.0 : 100.0 * same / want.size());
+    }
+
+    std::vector<int> ReadActions(const std::string &path) {
+        auto in = std::ifstream(path);
+        if (!in)
+            THROW_FORMAT("Failed to open %s", path);
+
+        auto res = std::vector<int>{};
+        int a;
+        while (in >> a)
+            res.push_back(a);
+        return res;
+    }
+
+    void WriteActions(const std::string &path, const std::vector<int> &actions) {
+        auto out = std::ofstream(path);
+        if (!out)
+            THROW_FORMAT("Failed to open %s", path);
+
+        for (auto a : actions)
+            out << a << "\n";
+    }
+
+    Options ParseOptions(int argc, char* argv[]) {
+        auto opts = Options{};
+        auto desc = po::options_description("Usage: mmai-replay [options] SNAPSHOT...\n\nOptions");
+        desc.add_options()
+            ("help,h", "show this help")
+            ("model", po::value(&opts.model)->required(), "model file")
+            ("model2", po::value(&opts.model2), "second model file (reports agreement with --model)")
+            ("actions-in", po::value(&opts.actionsIn), "actions file from another run (reports agreement)")
+            ("actions-out", po::value(&opts.actionsOut), "write the chosen actions to this file")
+            ("threads", po::value(&opts.threads)->default_value(1), "model instances, one thread each")
+            ("batch", po::value(&opts.batch)->default_value(1), "states claimed by a thread at a time")
+            ("model-threads", po::value(&opts.modelThreads)->default_value(1), "backend threads per model instance")
+            ("repeat", po::value(&opts.repeat)->default_value(1), "passes over the snapshots (latencies cover all of them)")
+            ("snapshot", po::value(&opts.snapshots)->required(), "snapshot file(s)");
+
+        auto pos = po::positional_options_description();
+        pos.add("snapshot", -1);
+
+        auto vm = po::variables_map();
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(pos).run(), vm);
+
+        if (vm.count("help")) {
+            std::cout << desc << "\n";
+            std::exit(0);
+        }
+
+        po::notify(vm);
+
+        if (opts.threads < 1 || opts.batch < 1 || opts.modelThreads < 1 || opts.repeat < 1)
+            throw std::runtime_error("--threads, --batch, --model-threads and --repeat must be positive");
+
+        return opts;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        auto opts = ParseOptions(argc, argv);
+
+        auto readers = std::vector<std::unique_ptr<BAI::Snapshot::Reader>>{};
+        auto entries = std::vector<Entry>{};
+        for (auto &path : opts.snapshots) {
+            auto &reader = readers.emplace_back(std::make_unique<BAI::Snapshot::Reader>(path));
+            for (size_t i = 0; i < reader->size(); ++i) {
+                auto state = reader->at(i);
+                auto sc = SizeClass(*state);
+                entries.push_back({std::move(state), sc});
+            }
+        }
+
+        if (entries.empty())
+            throw std::runtime_error("No snapshots to replay");
+
+        std::cout << boost::format("states: %d, threads: %d, batch: %d, model-threads: %d, repeat: %d\n")
+            % entries.size() % opts.threads % opts.batch % opts.modelThreads % opts.repeat;
+
+        auto res = Run(opts, entries);
+        auto total = entries.size() * opts.repeat;
+
+        std::cout << boost::format("throughput: %.1f states/sec (%.3f s)\n") % (total / res.wallSeconds) % res.wallSeconds;
+        std::cout << "latency (all): " << Stats(res.latencies) << "\n";
+
+        if (opts.batch > 1)
+            std::cout << "latency (batch): " << Stats(res.batchLatencies) << "\n";
+
+        auto bySizeClass = std::map<int, std::vector<double>>{};
+        for (size_t i = 0; i < res.latencies.size(); ++i)
+            bySizeClass[entries.at(i % entries.size()).sizeClass].push_back(res.latencies.at(i));
+
+        for (auto &[sc, latencies] : bySizeClass) {
+            std::cout << boost::format("latency (links <= %d, n=%d): %s\n")
+                % (size_t(1) << sc) % latencies.size() % Stats(latencies);
+        }
+
+        if (BAI::AllocStats::ENABLED)
+            std::cout << BAI::AllocStats::Report() << "\n";
+
+        if (BAI::PerfStats::ENABLED)
+            std::cout << BAI::PerfStats::Report() << "\n";
+
+        auto recorded = std::vector<int>{};
+        for (auto &e : entries)
+            recorded.push_back(e.state->action());
+        ReportAgreement("recorded", recorded, res.actions);
+
+        if (!opts.model2.empty()) {
+            auto model2 = LoadModel(opts.model2, opts.modelThreads);
+            auto actions2 = std::vector<int>{};
+            for (auto &e : entries)
+                actions2.push_back(model2->getAction(e.state.get()));
+            ReportAgreement("model2", actions2, res.actions);
+        }
+
+        if (!opts.actionsIn.empty())
+            ReportAgreement(opts.actionsIn, ReadActions(opts.actionsIn), res.actions);
+
+        if (!opts.actionsOut.empty())
+            WriteActions(opts.actionsOut, res.actions);
+    } catch (const std::exception &e) {
+        std::cerr << "mmai-replay: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}